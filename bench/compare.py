@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""Compare two bench/runner reports and fail on hot-path regressions.
+
+    python3 bench/compare.py baseline.json current.json [--tolerance 10]
+
+Checks max/avg cycles of every probe, the worst loop pass of every
+TimerState and the time to resume a countdown after a watchdog reset.
+Anything more than --tolerance percent (default 10) above the baseline is
+a regression; exit status 1 if there is one.
+"""
+import argparse
+import json
+import sys
+
+
+def rows(report):
+    for name, p in report["probes"].items():
+        yield "probe %s max" % name, p["max"]
+        yield "probe %s avg" % name, p["avg"]
+    for name, s in report["states"].items():
+        yield "state %s max" % name, s["max_cycles"]
+    if "recovery" in report:
+        yield "recovery cycles", report["recovery"]["cycles"]
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("baseline")
+    ap.add_argument("current")
+    ap.add_argument("--tolerance", type=float, default=10.0, help="percent")
+    args = ap.parse_args()
+
+    with open(args.baseline) as f:
+        base = dict(rows(json.load(f)))
+    with open(args.current) as f:
+        cur_report = json.load(f)
+    cur = dict(rows(cur_report))
+
+    failed = 0
+    for key, now in cur.items():
+        was = base.get(key)
+        if was is None:
+            print("%-32s %10d   (new)" % (key, now))
+            continue
+        limit = was * (1 + args.tolerance / 100.0)
+        bad = now > limit and now > was
+        failed += bad
+        delta = (now - was) * 100.0 / was if was else 0.0
+        print("%-32s %10d %10d %+7.1f%%%s" % (key, was, now, delta, "  REGRESSION" if bad else ""))
+
+    if cur_report.get("unmatched_markers"):
+        print("unmatched probe markers: %d" % cur_report["unmatched_markers"])
+        failed += 1
+
+    print("%d regression(s)" % failed if failed else "OK")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,165 @@
+// Pin access micro-benchmark (env:bench_pins): the two hot pin paths,
+// old against new, each between bench.h probes. Run it through the simavr
+// runner for a cycle comparison:
+//
+//   pio run -e bench_pins -e bench_runner
+//   .pio/build/bench_runner/program .pio/build/bench_pins/firmware.elf -t 200
+//
+// and compare the BENCH_PINS_* probes (avg cycles per call) in the report.
+// TM1637: the baseline driver's read-modify-write macros and byte loop
+// (its _delay_us() calls left out) against the io_map.h accessors in the
+// same loop. Buttons: the baseline buttons_read(), as it was, against
+// today's src/buttons.c (linked in, see platformio.ini), same port levels.
+#include <avr/io.h>
+#include <stdint.h>
+
+#include "../src/io_map.h"
+#include "../src/bench.h"
+#include "../src/buttons.h"
+#include "../src/timer.h"
+
+// --- TM1637 ---
+// Baseline src/tm1637.c macros, on the pins of its io_map.h
+#define OLD_PORT      PORTB
+#define OLD_DDR       DDRB
+#define OLD_CLK_PIN   0
+#define OLD_DIO_PIN   1
+
+#define CLK_HIGH()    (OLD_PORT |=  (1 << OLD_CLK_PIN))
+#define CLK_LOW()     (OLD_PORT &= ~(1 << OLD_CLK_PIN))
+#define DIO_HIGH()    (OLD_PORT |=  (1 << OLD_DIO_PIN))
+#define DIO_LOW()     (OLD_PORT &= ~(1 << OLD_DIO_PIN))
+#define DIO_OUTPUT()  (OLD_DDR |= (1 << OLD_DIO_PIN))
+#define DIO_INPUT()   (OLD_DDR &= ~(1 << OLD_DIO_PIN))
+
+// One byte, LSB first, then the ACK clock (the ISR spreads these over
+// Timer2 edges; here they run back to back). The baseline never looked
+// at the ACK level, so neither side reads it.
+__attribute__((noinline)) static void tm_byte_old(uint8_t b) {
+    for (uint8_t i = 0; i < 8; i++) {
+        CLK_LOW();
+        if (b & 0x01) DIO_HIGH();
+        else          DIO_LOW();
+        CLK_HIGH();
+        b >>= 1;
+    }
+
+    // ACK Check
+    CLK_LOW();
+    DIO_INPUT();
+    DIO_LOW();
+    CLK_HIGH();
+    CLK_LOW();
+    DIO_OUTPUT();
+}
+
+__attribute__((noinline)) static void tm_byte_new(uint8_t b) {
+    for (uint8_t i = 0; i < 8; i++) {
+        disp_clk_low();
+        if (b & 0x01) disp_dio_high();
+        else          disp_dio_low();
+        disp_clk_high();
+        b >>= 1;
+    }
+
+    disp_clk_low();
+    disp_dio_input();
+    disp_dio_low();
+    disp_clk_high();
+    disp_clk_low();
+    disp_dio_output();
+}
+
+// --- BUTTONS ---
+// Baseline src/buttons.c and io_map.h, only renamed so they link next to
+// the real buttons.c
+#define OLD_BTN_PIN_REG    PIND
+#define OLD_DEBOUNCE_DELAY 50
+
+static uint8_t last_port_state = 0xFF;
+static uint32_t last_debounce_time = 0;
+
+// millis() for both: far enough apart that neither debounce swallows an edge
+static volatile uint32_t fake_ms;
+
+uint32_t millis(void) {
+    return fake_ms += 100;
+}
+
+void timer_set_deadline(uint8_t slot, uint32_t when) {
+    (void)slot;
+    (void)when;
+}
+
+void timer_clear_deadline(uint8_t slot) {
+    (void)slot;
+}
+
+__attribute__((noinline)) static ButtonID old_buttons_read(void) {
+    uint32_t now = millis();
+    if (now - last_debounce_time < OLD_DEBOUNCE_DELAY) return BTN_NONE;
+
+    // Read Logic: Active LOW (0 = Pressed)
+    uint8_t mask = (1 << PIN_BTN_L) | (1 << PIN_BTN_M) | (1 << PIN_BTN_R);
+    uint8_t current_state = OLD_BTN_PIN_REG & mask;
+
+    ButtonID detected = BTN_NONE;
+
+    // Detect Falling Edge (Transition from 1 to 0)
+    // Check Left
+    if ((last_port_state & (1 << PIN_BTN_L)) && !(current_state & (1 << PIN_BTN_L))) {
+        detected = BTN_L;
+    }
+    // Check Middle
+    else if ((last_port_state & (1 << PIN_BTN_M)) && !(current_state & (1 << PIN_BTN_M))) {
+        detected = BTN_M;
+    }
+    // Check Right
+    else if ((last_port_state & (1 << PIN_BTN_R)) && !(current_state & (1 << PIN_BTN_R))) {
+        detected = BTN_R;
+    }
+
+    if (current_state != last_port_state) {
+        last_debounce_time = now;
+        last_port_state = current_state;
+    }
+
+    return detected;
+}
+
+static volatile ButtonID pressed;
+
+int main(void) {
+    disp_clk_output();
+    disp_dio_output();
+    buttons_init();
+    // The buttons' pins driven as outputs, so PIND reads back the levels
+    // written to PORTD (interrupts stay off: only the polled path runs)
+    DDRD |= BTN_MASK;
+
+    // Same work for both: every byte value, every button combination
+    for (;;) {
+        for (uint16_t b = 0; b < 256; b++) {
+            BENCH_ENTER(BENCH_PINS_TM_OLD);
+            tm_byte_old((uint8_t)b);
+            BENCH_EXIT(BENCH_PINS_TM_OLD);
+
+            BENCH_ENTER(BENCH_PINS_TM_NEW);
+            tm_byte_new((uint8_t)b);
+            BENCH_EXIT(BENCH_PINS_TM_NEW);
+        }
+        for (uint8_t m = 0; m < 8; m++) {
+            uint8_t down = (uint8_t)(((m & 1) << PIN_BTN_L) | ((m >> 1 & 1) << PIN_BTN_M) |
+                                     ((m >> 2 & 1) << PIN_BTN_R));
+            PORTD = (uint8_t)((PORTD | BTN_MASK) & ~down);
+
+            BENCH_ENTER(BENCH_PINS_BTN_OLD);
+            pressed = old_buttons_read();
+            BENCH_EXIT(BENCH_PINS_BTN_OLD);
+
+            BENCH_ENTER(BENCH_PINS_BTN_NEW);
+            pressed = buttons_read();
+            BENCH_EXIT(BENCH_PINS_BTN_NEW);
+        }
+    }
+}
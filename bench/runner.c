@@ -0,0 +1,332 @@
+// Cycle-accurate benchmark runner: boots the real firmware image (built
+// with -DDAMKA_BENCH, env:bench) in simavr, plays a fixed button script
+// through every TimerState and times the probes from src/bench.h.
+//
+//   pio run -e bench && pio run -e bench_runner
+//   .pio/build/bench_runner/program .pio/build/bench/firmware.elf -o bench.json
+//   python3 bench/compare.py known_good.json bench.json
+//
+// -t limits the run (ms); bench/pins.c, a micro-benchmark, needs far less.
+//
+// The report is JSON: per probe call count, min/avg/max cycles and share
+// of all cycles (tm1637_isr: the display's interrupt load), and per
+// TimerState the number of loop passes, their rate and the worst pass
+// (time from the top of app_poll() until it goes back to sleep). At the
+// end a running countdown goes through a watchdog reset (SRAM kept, as on
+// the chip) and "recovery" gives the time until it was running again.
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_uart.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/bench.h"
+
+#define F_CPU_HZ   8000000UL
+#define CYCLES_MS  (F_CPU_HZ / 1000)
+#define RUN_MS     28000UL
+
+// Data-space addresses (I/O address + 0x20)
+#define ADDR_GPIOR0 0x3E
+#define ADDR_GPIOR1 0x4A
+#define ADDR_MCUSR  0x54
+#define SRAM_START  0x100
+
+#define WDRF_BIT      3
+#define STATE_RUNNING 4 // TimerState (main.c)
+
+// --- BUTTON SCRIPT ---
+// PD2 = L, PD3 = M, PD4 = R, active low
+#define B_L (1 << 2)
+#define B_M (1 << 3)
+#define B_R (1 << 4)
+
+typedef struct {
+    uint32_t at_ms;
+    uint8_t  buttons; // Pressed together
+    uint16_t hold_ms;
+} Press;
+
+// Walks IDLE -> SET_MIN (hold-repeat, chord clear) -> SET_SEC -> IDLE ->
+// RUNNING -> PAUSED -> RUNNING -> ALARM -> IDLE -> SET_HR -> IDLE ->
+// STOPWATCH -> SW_RUNNING -> STOPWATCH -> IDLE. The simulated EEPROM is
+// blank and there is no crystal, so boot spends ~1 s looking for one
+// (calib.c), then the DFPlayer queue waits out its 3 s boot time.
+static const Press script[] = {
+    {  4500, B_L,        60 }, // SET_MIN
+    {  4800, B_R,      1500 }, // Hold-repeat minutes up
+    {  6700, B_L | B_R,  100 }, // Chord: clear minutes
+    {  7100, B_M,        60 }, // SET_SEC
+    {  7400, B_R,        60 },
+    {  7600, B_R,        60 },
+    {  7800, B_R,        60 },
+    {  8000, B_R,        60 }, // 00:04
+    {  8300, B_M,        60 }, // IDLE
+    {  8600, B_M,        60 }, // RUNNING
+    { 10700, B_M,        60 }, // PAUSED
+    { 12200, B_M,        60 }, // RUNNING, alarm a few seconds later
+    { 18000, B_M,        60 }, // Dismiss -> IDLE
+    { 18400, B_L,       900 }, // Long press: SET_HR
+    { 19500, B_M,        60 }, // SET_MIN
+    { 19800, B_M,        60 }, // SET_SEC
+    { 20100, B_M,        60 }, // IDLE
+    { 20500, B_M,       900 }, // Long press: STOPWATCH
+    { 21600, B_M,        60 }, // SW_RUNNING (SS.cc, 100 frames/s)
+    { 24000, B_M,        60 }, // STOPWATCH
+    { 24400, B_R,        60 }, // IDLE
+    { 25000, B_M,        60 }, // RUNNING (00:04 again), reset 1.5 s in
+};
+
+#define RESET_MS 26500
+
+#define SCRIPT_LEN (sizeof(script) / sizeof(script[0]))
+
+// --- MEASUREMENTS ---
+#define MAX_PROBES 12
+#define MAX_STATES 12
+
+typedef struct {
+    const char *name;
+    uint64_t start;
+    uint8_t  open;
+    uint32_t calls;
+    uint64_t total, min, max;
+} Probe;
+
+typedef struct {
+    uint32_t passes;
+    uint64_t total, max;
+    uint64_t time_in; // Cycles spent in this state
+} StateStats;
+
+static Probe probes[MAX_PROBES] = {
+    [BENCH_LOOP]       = { .name = "loop" },
+    [BENCH_DISPLAY]    = { .name = "refresh_display" },
+    [BENCH_BUTTONS]    = { .name = "buttons_get_event" },
+    [BENCH_SEND_STACK] = { .name = "send_stack" },
+    [BENCH_DISP_ISR]   = { .name = "tm1637_isr" },
+    [BENCH_PINS_TM_OLD]  = { .name = "pins_tm1637_byte_macros" },
+    [BENCH_PINS_TM_NEW]  = { .name = "pins_tm1637_byte_io_map" },
+    [BENCH_PINS_BTN_OLD] = { .name = "pins_buttons_read_baseline" },
+    [BENCH_PINS_BTN_NEW] = { .name = "pins_buttons_read" },
+};
+
+static const char *state_names[] = {
+    "IDLE", "SET_HR", "SET_MIN", "SET_SEC", "RUNNING", "PAUSED", "ALARM",
+    "STOPWATCH", "SW_RUNNING"
+};
+#define NUM_STATES (sizeof(state_names) / sizeof(state_names[0]))
+
+static StateStats states[MAX_STATES];
+static uint8_t  cur_state = 0;
+static uint64_t state_since = 0;
+static uint32_t unmatched = 0; // Exit without entry, or entry while open
+
+// Watchdog reset mid-countdown: cycles until the loop reports RUNNING again
+static uint64_t reset_cycle = 0;
+static uint64_t recovered_cycle = 0;
+
+static void gpior0_write(avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param) {
+    (void)param;
+    avr->data[addr] = v;
+
+    uint8_t id = v & 0x7F;
+    if (id >= MAX_PROBES || !probes[id].name) {
+        unmatched++;
+        return;
+    }
+
+    Probe *p = &probes[id];
+    if (v & 0x80) {
+        if (p->open) unmatched++;
+        p->open = 1;
+        p->start = avr->cycle;
+        return;
+    }
+
+    if (!p->open) {
+        unmatched++;
+        return;
+    }
+    p->open = 0;
+
+    uint64_t c = avr->cycle - p->start;
+    if (p->calls == 0 || c < p->min) p->min = c;
+    if (c > p->max) p->max = c;
+    p->total += c;
+    p->calls++;
+
+    if (id == BENCH_LOOP && cur_state < MAX_STATES) {
+        StateStats *s = &states[cur_state];
+        s->passes++;
+        s->total += c;
+        if (c > s->max) s->max = c;
+    }
+}
+
+static void gpior1_write(avr_t *avr, avr_io_addr_t addr, uint8_t v, void *param) {
+    (void)param;
+    avr->data[addr] = v;
+    if (reset_cycle && !recovered_cycle && v == STATE_RUNNING) recovered_cycle = avr->cycle;
+    if (v == cur_state || v >= MAX_STATES) return;
+
+    states[cur_state].time_in += avr->cycle - state_since;
+    state_since = avr->cycle;
+    cur_state = v;
+}
+
+// --- REPORT ---
+static void report(FILE *out, const char *elf, uint64_t cycles) {
+    states[cur_state].time_in += cycles - state_since;
+    state_since = cycles;
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"firmware\": \"%s\",\n", elf);
+    fprintf(out, "  \"f_cpu\": %lu,\n", F_CPU_HZ);
+    fprintf(out, "  \"cycles\": %llu,\n", (unsigned long long)cycles);
+    fprintf(out, "  \"unmatched_markers\": %u,\n", unmatched);
+
+    fprintf(out, "  \"probes\": {");
+    const char *sep = "\n";
+    for (int i = 0; i < MAX_PROBES; i++) {
+        Probe *p = &probes[i];
+        if (!p->name) continue;
+        fprintf(out, "%s    \"%s\": { \"calls\": %u, \"min\": %llu, \"avg\": %llu, \"max\": %llu, "
+                     "\"cpu_share\": %.5f }",
+                sep, p->name, p->calls,
+                (unsigned long long)p->min,
+                (unsigned long long)(p->calls ? p->total / p->calls : 0),
+                (unsigned long long)p->max,
+                cycles ? (double)p->total / cycles : 0.0);
+        sep = ",\n";
+    }
+    fprintf(out, "\n  },\n");
+
+    fprintf(out, "  \"states\": {");
+    sep = "\n";
+    for (unsigned i = 0; i < NUM_STATES; i++) {
+        StateStats *s = &states[i];
+        double secs = (double)s->time_in / F_CPU_HZ;
+        fprintf(out, "%s    \"%s\": { \"passes\": %u, \"time_s\": %.3f, \"passes_per_s\": %.1f, "
+                     "\"avg_cycles\": %llu, \"max_cycles\": %llu, \"max_us\": %.1f }",
+                sep, state_names[i], s->passes, secs,
+                secs > 0 ? s->passes / secs : 0.0,
+                (unsigned long long)(s->passes ? s->total / s->passes : 0),
+                (unsigned long long)s->max,
+                s->max * 1e6 / F_CPU_HZ);
+        sep = ",\n";
+    }
+    fprintf(out, "\n  },\n");
+
+    uint64_t rc = recovered_cycle ? recovered_cycle - reset_cycle : 0;
+    fprintf(out, "  \"recovery\": { \"resumed\": %s, \"cycles\": %llu, \"us\": %.1f }\n}\n",
+            recovered_cycle ? "true" : "false", (unsigned long long)rc, rc * 1e6 / F_CPU_HZ);
+}
+
+// What a watchdog reset does to the chip: registers back to their reset
+// values, SRAM left as it was, WDRF set in MCUSR
+static void watchdog_reset(avr_t *avr) {
+    size_t len = avr->ramend + 1 - SRAM_START;
+    uint8_t *sram = malloc(len);
+    memcpy(sram, avr->data + SRAM_START, len);
+    avr_reset(avr);
+    memcpy(avr->data + SRAM_START, sram, len);
+    free(sram);
+    avr->data[ADDR_MCUSR] = 1 << WDRF_BIT;
+
+    for (int i = 0; i < MAX_PROBES; i++) probes[i].open = 0; // Cut short
+    reset_cycle = avr->cycle;
+}
+
+int main(int argc, char **argv) {
+    const char *elf = NULL;
+    const char *out_path = NULL;
+    unsigned long run_ms = RUN_MS;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-o") && i + 1 < argc) out_path = argv[++i];
+        else if (!strcmp(argv[i], "-t") && i + 1 < argc) run_ms = strtoul(argv[++i], NULL, 0);
+        else elf = argv[i];
+    }
+    if (!elf) {
+        fprintf(stderr, "usage: %s firmware.elf [-o report.json] [-t run_ms]\n", argv[0]);
+        return 2;
+    }
+
+    elf_firmware_t fw;
+    memset(&fw, 0, sizeof(fw));
+    if (elf_read_firmware(elf, &fw) != 0) {
+        fprintf(stderr, "cannot load %s\n", elf);
+        return 2;
+    }
+
+    avr_t *avr = avr_make_mcu_by_name("atmega328p");
+    if (!avr) {
+        fprintf(stderr, "simavr has no atmega328p core\n");
+        return 2;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &fw);
+    avr->frequency = F_CPU_HZ;
+
+    avr_register_io_write(avr, ADDR_GPIOR0, gpior0_write, NULL);
+    avr_register_io_write(avr, ADDR_GPIOR1, gpior1_write, NULL);
+
+    // Keep DFPlayer frames off stdout, the report may go there
+    uint32_t uart_flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &uart_flags);
+    uart_flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &uart_flags);
+
+    avr_irq_t *pin[8];
+    for (int i = 2; i <= 4; i++) {
+        pin[i] = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), i);
+        avr_raise_irq(pin[i], 1); // Released
+    }
+
+    // Expand the script into press/release edges as we go
+    unsigned next = 0;
+    uint8_t held = 0;
+    uint64_t release_at = 0;
+    uint64_t end = (uint64_t)run_ms * CYCLES_MS;
+
+    while (avr->cycle < end) {
+        if (held && avr->cycle >= release_at) {
+            for (int i = 2; i <= 4; i++) {
+                if (held & (1 << i)) avr_raise_irq(pin[i], 1);
+            }
+            held = 0;
+        }
+        if (!held && next < SCRIPT_LEN && avr->cycle >= (uint64_t)script[next].at_ms * CYCLES_MS) {
+            held = script[next].buttons;
+            release_at = avr->cycle + (uint64_t)script[next].hold_ms * CYCLES_MS;
+            for (int i = 2; i <= 4; i++) {
+                if (held & (1 << i)) avr_raise_irq(pin[i], 0);
+            }
+            next++;
+        }
+        if (!reset_cycle && avr->cycle >= (uint64_t)RESET_MS * CYCLES_MS) watchdog_reset(avr);
+
+        int st = avr_run(avr);
+        if (st == cpu_Done || st == cpu_Crashed) {
+            fprintf(stderr, "firmware stopped at cycle %llu (state %d)\n",
+                    (unsigned long long)avr->cycle, st);
+            return 1;
+        }
+    }
+
+    FILE *out = stdout;
+    if (out_path && !(out = fopen(out_path, "w"))) {
+        perror(out_path);
+        return 2;
+    }
+    report(out, elf, avr->cycle);
+    if (out != stdout) fclose(out);
+
+    // A short run (-t, e.g. bench/pins.c) ends before the reset
+    return (unmatched || (reset_cycle && !recovered_cycle)) ? 1 : 0;
+}
@@ -0,0 +1,16 @@
+#ifndef SIM_AVR_EEPROM_H
+#define SIM_AVR_EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// EEPROM contents live in sim_avr.c (1 KB, erased = 0xFF)
+#define EEMEM
+
+uint8_t  eeprom_read_byte(const uint8_t *addr);
+void     eeprom_read_block(void *dst, const void *src, size_t n);
+void     eeprom_update_byte(uint8_t *addr, uint8_t value);
+void     eeprom_update_block(const void *src, void *dst, size_t n);
+#define  eeprom_busy_wait() do { } while (0)
+
+#endif
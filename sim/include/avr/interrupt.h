@@ -0,0 +1,15 @@
+#ifndef SIM_AVR_INTERRUPT_H
+#define SIM_AVR_INTERRUPT_H
+
+#include "avr/io.h"
+
+// ISRs become ordinary functions named after their vector; the simulator
+// calls them when it injects the matching hardware event.
+#define ISR(vector) void vector(void); void vector(void)
+
+void sim_sei(void);
+void sim_cli(void);
+#define sei() sim_sei()
+#define cli() sim_cli()
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+// Host stand-in for <avr/io.h>: every I/O register is a plain variable
+// (defined in sim_avr.c) so the firmware compiles and runs on Linux.
+
+#include <stdint.h>
+
+#define SIM_REG8(name)  extern volatile uint8_t name;
+#define SIM_REG16(name) extern volatile uint16_t name;
+
+// GPIO
+SIM_REG8(PORTB) SIM_REG8(DDRB) SIM_REG8(PINB)
+SIM_REG8(PORTC) SIM_REG8(DDRC) SIM_REG8(PINC)
+SIM_REG8(PORTD) SIM_REG8(DDRD) SIM_REG8(PIND)
+
+// Timers
+SIM_REG8(TCCR0A) SIM_REG8(TCCR0B) SIM_REG8(TCNT0) SIM_REG8(OCR0A) SIM_REG8(TIMSK0) SIM_REG8(TIFR0)
+SIM_REG8(TCCR1A) SIM_REG8(TCCR1B) SIM_REG8(TCCR1C) SIM_REG16(TCNT1) SIM_REG16(OCR1A) SIM_REG16(OCR1B)
+SIM_REG8(TIMSK1) SIM_REG8(TIFR1)
+SIM_REG8(TCCR2A) SIM_REG8(TCCR2B) SIM_REG8(TCNT2) SIM_REG8(OCR2A) SIM_REG8(TIMSK2) SIM_REG8(TIFR2) SIM_REG8(ASSR)
+
+// USART0
+SIM_REG8(UBRR0H) SIM_REG8(UBRR0L) SIM_REG8(UCSR0A) SIM_REG8(UCSR0B) SIM_REG8(UCSR0C) SIM_REG8(UDR0)
+
+// External / pin change interrupts
+SIM_REG8(EICRA) SIM_REG8(EIMSK) SIM_REG8(EIFR)
+SIM_REG8(PCICR) SIM_REG8(PCIFR) SIM_REG8(PCMSK0) SIM_REG8(PCMSK1) SIM_REG8(PCMSK2)
+
+// System
+SIM_REG8(SREG) SIM_REG8(MCUSR) SIM_REG8(WDTCSR) SIM_REG8(SMCR) SIM_REG8(PRR) SIM_REG8(OSCCAL)
+SIM_REG8(GPIOR0) SIM_REG8(GPIOR1) SIM_REG8(GPIOR2)
+
+// EEPROM
+SIM_REG16(EEAR) SIM_REG8(EEDR) SIM_REG8(EECR)
+
+#define _BV(bit) (1 << (bit))
+
+#define RAMEND 0x08FF
+#define E2END  0x03FF
+
+// --- Bit names (ATmega328P) ---
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+
+#define WGM01 1
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define OCIE0A 1
+
+#define WGM12 3
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+
+#define WGM21 1
+#define CS20 0
+#define CS21 1
+#define CS22 2
+#define TOIE2 0
+#define OCIE2A 1
+#define TOV2 0
+#define OCF2A 1
+#define TCR2BUB 0
+#define TCR2AUB 1
+#define OCR2AUB 3
+#define TCN2UB 4
+#define AS2 5
+
+#define MPCM0 0
+#define U2X0 1
+#define UPE0 2
+#define DOR0 3
+#define FE0 4
+#define UDRE0 5
+#define TXC0 6
+#define RXC0 7
+#define TXB80 0
+#define TXEN0 3
+#define RXEN0 4
+#define UDRIE0 5
+#define TXCIE0 6
+#define RXCIE0 7
+#define UCSZ00 1
+#define UCSZ01 2
+
+#define ISC00 0
+#define ISC01 1
+#define ISC10 2
+#define ISC11 3
+#define INT0 0
+#define INT1 1
+#define INTF0 0
+#define INTF1 1
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCIF2 2
+#define PCINT16 0
+#define PCINT17 1
+#define PCINT18 2
+#define PCINT19 3
+#define PCINT20 4
+
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+#define WDP0 0
+#define WDP1 1
+#define WDP2 2
+#define WDE 3
+#define WDCE 4
+#define WDP3 5
+#define WDIE 6
+#define WDIF 7
+
+#define EERE 0
+#define EEPE 1
+#define EEMPE 2
+#define EERIE 3
+
+#endif
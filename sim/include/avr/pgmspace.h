@@ -0,0 +1,18 @@
+#ifndef SIM_AVR_PGMSPACE_H
+#define SIM_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// One address space on the host: flash reads are plain loads
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr)  (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_ptr(addr)   (*(void * const *)(addr))
+#define memcpy_P             memcpy
+#define strlen_P             strlen
+
+#endif
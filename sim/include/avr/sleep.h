@@ -0,0 +1,19 @@
+#ifndef SIM_AVR_SLEEP_H
+#define SIM_AVR_SLEEP_H
+
+// Sleeping hands control to the simulator, which fast-forwards the virtual
+// clock to the next deadline or scripted input.
+
+#define SLEEP_MODE_IDLE     0
+#define SLEEP_MODE_PWR_DOWN 2
+
+void sim_set_sleep_mode(uint8_t mode);
+void sim_sleep_cpu(void);
+
+#define set_sleep_mode(mode) sim_set_sleep_mode(mode)
+#define sleep_enable()       do { } while (0)
+#define sleep_disable()      do { } while (0)
+#define sleep_bod_disable()  do { } while (0)
+#define sleep_cpu()          sim_sleep_cpu()
+
+#endif
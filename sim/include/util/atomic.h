@@ -0,0 +1,12 @@
+#ifndef SIM_UTIL_ATOMIC_H
+#define SIM_UTIL_ATOMIC_H
+
+#include <stdint.h>
+
+// The simulator only runs ISRs at well-defined points (never in the
+// middle of foreground code), so a critical section is just a block.
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON      1
+#define ATOMIC_BLOCK(type)  for (uint8_t sim_atomic_once = 1; sim_atomic_once; sim_atomic_once = 0)
+
+#endif
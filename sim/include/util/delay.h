@@ -0,0 +1,8 @@
+#ifndef SIM_UTIL_DELAY_H
+#define SIM_UTIL_DELAY_H
+
+// Busy-waits cost no virtual time in the simulator
+#define _delay_ms(ms) ((void)(ms))
+#define _delay_us(us) ((void)(us))
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+// Host simulator for the firmware (env:native).
+//
+// The firmware runs unmodified on its own stack (app_init() then
+// app_poll() forever). Whenever it goes to sleep the simulator jumps the
+// virtual clock straight to the next timer deadline or scripted input, so
+// a 99:59 countdown takes milliseconds of real time.
+
+// --- VIRTUAL CLOCK ---
+uint64_t sim_time_us(void);
+uint32_t sim_time_ms(void);
+
+// Boot the firmware (calls app_init()). Call once per process.
+void sim_boot(void);
+
+// Let the firmware run until the virtual clock reaches 'until_ms'
+void sim_run_until(uint32_t until_ms);
+
+// Reset cause the firmware finds in MCUSR at boot (default 0: cold).
+// Set before sim_boot().
+void sim_reset_cause(uint8_t mcusr);
+
+// --- INPUTS ---
+// Schedule a button level change (id = ButtonID) at virtual time 'at_ms'
+void sim_button(uint8_t id, uint32_t at_ms, uint8_t pressed);
+
+// Press at 'at_ms' and release 'hold_ms' later
+void sim_press(uint8_t id, uint32_t at_ms, uint16_t hold_ms);
+
+// --- FAKE TM1637 (on the real driver's pins) ---
+const char *sim_display_text(void); // Decoded, e.g. "12:34", "    "
+uint32_t sim_display_frames(void);  // Frames that reached the display
+uint8_t sim_display_on(void);
+uint8_t sim_display_brightness(void); // 0-7
+uint32_t sim_display_bytes(void);   // Bytes clocked in off the bus
+void sim_display_nak(uint16_t n);   // Don't acknowledge the next 'n' bytes
+uint32_t sim_display_steps(void);   // Timer2 interrupts the transfers took
+
+// --- EEPROM ---
+// The 1 KB array behind the fake EEPROM (fill it before sim_boot() to
+// carry it over from an earlier run)
+uint8_t *sim_eeprom(void);
+
+// --- FAKE DFPLAYER ---
+typedef struct {
+    uint32_t time_ms;
+    uint8_t  cmd;
+    uint16_t param;
+} SimDfCommand;
+
+uint16_t sim_df_count(void);
+const SimDfCommand *sim_df_get(uint16_t i);
+uint16_t sim_df_bad_frames(void); // Frames that failed start/len/checksum/end checks
+
+// Plain text sent on the DFPlayer line (the trace dump), NUL-terminated
+const char *sim_uart_text(void);
+
+// Have the module send a status frame at 'at_ms' (e.g. DF_EVT_ONLINE)
+void sim_df_reply(uint32_t at_ms, uint8_t cmd, uint16_t param);
+
+// Have the module swallow the ACKs of the next 'n' commands
+void sim_df_drop_acks(uint16_t n);
+
+// Put an SD card in the module: 'files' in all, 'folders' folders with
+// counts[i] files in folder i + 1. It then answers the media queries and
+// fails folder files that aren't there. Without one queries are only ACKed.
+void sim_df_card(uint16_t files, uint8_t folders, const uint8_t *counts);
+
+// --- HOST LINK (host.h) ---
+// Bytes from a host, fed through the RX interrupt path right away (the
+// firmware runs them on its next loop pass)
+void sim_uart_host_rx(const uint8_t *data, uint16_t len);
+// Reply bytes the firmware has sent since the last call
+uint16_t sim_uart_host_tx(uint8_t *buf, uint16_t max);
+
+// --- TIMEBASE ---
+// The first deadline armed at or after 'at_ms' takes 'us' to program, as
+// if the firmware had been slow between reading millis() and arming
+// Timer1 (timer.c arm_compare())
+void sim_timer_slip(uint32_t at_ms, uint16_t us);
+uint32_t sim_timer_slipped(void); // When it happened (0: not yet)
+
+// --- HOOKS (sim internals) ---
+uint8_t sim_timer_next_deadline(uint32_t *when_ms); // Earliest future deadline
+void sim_timer_set_us(uint64_t now_us);
+void sim_advance_us(uint32_t us); // Time passes while the firmware runs
+void sim_uart_rx_frame(uint8_t cmd, uint16_t param); // Module -> firmware
+void sim_tm1637_idle(void); // Display transfer over (Timer2 interrupt off)
+
+// Print display frames and DFPlayer commands as they happen
+extern int sim_trace;
+
+#endif
@@ -0,0 +1,319 @@
+#include "sim.h"
+#include "app.h"
+#include "buttons.h"
+#include "io_map.h"
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <ucontext.h>
+
+// --- REGISTERS ---
+#define SIM_DEF8(name)  volatile uint8_t name;
+#define SIM_DEF16(name) volatile uint16_t name;
+
+SIM_DEF8(PORTB) SIM_DEF8(DDRB) SIM_DEF8(PINB)
+SIM_DEF8(PORTC) SIM_DEF8(DDRC) SIM_DEF8(PINC)
+SIM_DEF8(PORTD) SIM_DEF8(DDRD)
+volatile uint8_t PIND = 0xFF; // Buttons idle high (pull-ups)
+SIM_DEF8(TCCR0A) SIM_DEF8(TCCR0B) SIM_DEF8(TCNT0) SIM_DEF8(OCR0A) SIM_DEF8(TIMSK0) SIM_DEF8(TIFR0)
+SIM_DEF8(TCCR1A) SIM_DEF8(TCCR1B) SIM_DEF8(TCCR1C) SIM_DEF16(TCNT1) SIM_DEF16(OCR1A) SIM_DEF16(OCR1B)
+SIM_DEF8(TIMSK1) SIM_DEF8(TIFR1)
+SIM_DEF8(TCCR2A) SIM_DEF8(TCCR2B) SIM_DEF8(TCNT2) SIM_DEF8(OCR2A) SIM_DEF8(TIMSK2) SIM_DEF8(TIFR2) SIM_DEF8(ASSR)
+SIM_DEF8(UBRR0H) SIM_DEF8(UBRR0L) SIM_DEF8(UCSR0A) SIM_DEF8(UCSR0B) SIM_DEF8(UCSR0C) SIM_DEF8(UDR0)
+SIM_DEF8(EICRA) SIM_DEF8(EIMSK) SIM_DEF8(EIFR)
+SIM_DEF8(PCICR) SIM_DEF8(PCIFR) SIM_DEF8(PCMSK0) SIM_DEF8(PCMSK1) SIM_DEF8(PCMSK2)
+SIM_DEF8(SREG) SIM_DEF8(MCUSR) SIM_DEF8(WDTCSR) SIM_DEF8(SMCR) SIM_DEF8(PRR) SIM_DEF8(OSCCAL)
+SIM_DEF8(GPIOR0) SIM_DEF8(GPIOR1) SIM_DEF8(GPIOR2)
+SIM_DEF16(EEAR) SIM_DEF8(EEDR) SIM_DEF8(EECR)
+
+// Vectors the simulator can raise
+void INT0_vect(void);
+void INT1_vect(void);
+void PCINT2_vect(void);
+void WDT_vect(void);
+void EE_READY_vect(void);
+void TIMER2_COMPA_vect(void);
+
+// --- CPU STATE ---
+static uint8_t int_enabled = 0;
+static uint8_t sleep_mode = SLEEP_MODE_IDLE;
+static uint64_t now_us = 0;
+
+void sim_sei(void) { int_enabled = 1; }
+void sim_cli(void) { int_enabled = 0; }
+void sim_set_sleep_mode(uint8_t mode) { sleep_mode = mode; }
+
+uint64_t sim_time_us(void) { return now_us; }
+uint32_t sim_time_ms(void) { return (uint32_t)(now_us / 1000); }
+
+void sim_advance_us(uint32_t us) {
+    now_us += us;
+    sim_timer_set_us(now_us);
+}
+
+static void set_time_ms(uint32_t ms) {
+    now_us = (uint64_t)ms * 1000;
+    sim_timer_set_us(now_us);
+}
+
+// --- EEPROM (1 KB, erased) ---
+static uint8_t eeprom[E2END + 1];
+static uint8_t eeprom_ready = 0;
+
+static void eeprom_init(void) {
+    if (eeprom_ready) return;
+    for (int i = 0; i <= E2END; i++) eeprom[i] = 0xFF;
+    eeprom_ready = 1;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr) {
+    eeprom_init();
+    return eeprom[(uintptr_t)addr & E2END];
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        ((uint8_t *)dst)[i] = eeprom_read_byte((const uint8_t *)src + i);
+    }
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value) {
+    eeprom_init();
+    eeprom[(uintptr_t)addr & E2END] = value;
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        eeprom_update_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+    }
+}
+
+void sim_reset_cause(uint8_t mcusr) {
+    MCUSR = mcusr;
+}
+
+uint8_t *sim_eeprom(void) {
+    eeprom_init();
+    return eeprom;
+}
+
+// Interrupt-driven writes: EEPE set by the firmware starts a byte
+// (EEAR/EEDR), which lands EE_WRITE_MS later; EE_READY fires whenever
+// EERIE is set and no write is running.
+#define EE_WRITE_MS 4 // 3.4 ms, rounded up to the clock's resolution
+
+static uint8_t ee_busy = 0;
+static uint32_t ee_done_ms = 0;
+
+static void eeprom_track(uint32_t now) {
+    if ((EECR & (1 << EEPE)) && !ee_busy) {
+        ee_busy = 1;
+        ee_done_ms = now + EE_WRITE_MS;
+    }
+}
+
+// Earliest EEPROM event: 1 = write completes, 2 = EE_READY due now
+static uint8_t eeprom_next(uint32_t now, uint32_t *when) {
+    eeprom_track(now);
+    if (ee_busy) { *when = ee_done_ms; return 1; }
+    if (EECR & (1 << EERIE)) { *when = now; return 2; }
+    return 0;
+}
+
+static void eeprom_service(void) {
+    if (ee_busy) {
+        eeprom[EEAR & E2END] = EEDR;
+        EECR &= ~(1 << EEPE);
+        ee_busy = 0;
+    }
+    if ((EECR & (1 << EERIE)) && !(EECR & (1 << EEPE))) EE_READY_vect();
+}
+
+// --- SCRIPTED INPUTS ---
+// Button edges and DFPlayer status frames, in time order
+#define SIM_IN_BUTTON 0
+#define SIM_IN_DF     1
+
+typedef struct {
+    uint32_t at_ms;
+    uint8_t  kind;
+    uint8_t  id;      // ButtonID, or DFPlayer command
+    uint8_t  pressed;
+    uint16_t param;
+} SimInput;
+
+#define SIM_MAX_INPUTS 256
+static SimInput inputs[SIM_MAX_INPUTS];
+static uint16_t input_count = 0;
+
+// Port bit for each ButtonID (index 0 unused)
+static const uint8_t input_pin[4] = { 0, PIN_BTN_L, PIN_BTN_M, PIN_BTN_R };
+
+static void add_input(const SimInput *in) {
+    if (input_count >= SIM_MAX_INPUTS) {
+        fprintf(stderr, "sim: input script full\n");
+        exit(2);
+    }
+    // Keep the script sorted by time (stable for equal times)
+    uint16_t i = input_count++;
+    while (i > 0 && inputs[i - 1].at_ms > in->at_ms) {
+        inputs[i] = inputs[i - 1];
+        i--;
+    }
+    inputs[i] = *in;
+}
+
+void sim_button(uint8_t id, uint32_t at_ms, uint8_t pressed) {
+    SimInput in = { at_ms, SIM_IN_BUTTON, id, pressed, 0 };
+    add_input(&in);
+}
+
+void sim_df_reply(uint32_t at_ms, uint8_t cmd, uint16_t param) {
+    SimInput in = { at_ms, SIM_IN_DF, cmd, 0, param };
+    add_input(&in);
+}
+
+void sim_press(uint8_t id, uint32_t at_ms, uint16_t hold_ms) {
+    sim_button(id, at_ms, 1);
+    sim_button(id, at_ms + hold_ms, 0);
+}
+
+// Drive the pin and raise whichever interrupts the firmware has enabled.
+// INT0/INT1 edges need the I/O clock, so they don't fire in power-down.
+static void apply_input(const SimInput *in) {
+    if (in->kind == SIM_IN_DF) {
+        sim_uart_rx_frame(in->id, in->param); // RX interrupt wakes the CPU
+        return;
+    }
+
+    uint8_t bit = (1 << input_pin[in->id]);
+    if (in->pressed) PIND &= ~bit; // Active LOW
+    else             PIND |= bit;
+
+    uint8_t clocked = (sleep_mode != SLEEP_MODE_PWR_DOWN);
+    if (in->id == BTN_L && clocked && (EIMSK & (1 << INT0))) INT0_vect();
+    if (in->id == BTN_M && clocked && (EIMSK & (1 << INT1))) INT1_vect();
+    if ((PCICR & (1 << PCIE2)) && (PCMSK2 & bit)) PCINT2_vect();
+}
+
+// --- FIRMWARE COROUTINE ---
+static ucontext_t harness_ctx;
+static ucontext_t firmware_ctx;
+static uint8_t firmware_stack[64 * 1024];
+static uint32_t horizon_ms = 0;
+static uint8_t booted = 0;
+
+static void firmware_entry(void) {
+    // As main() does; the harness sets MCUSR to fake the reset cause
+    uint8_t cause = MCUSR;
+    MCUSR = 0;
+    app_init(cause);
+    for (;;) {
+        app_poll();
+    }
+}
+
+// --- DISPLAY TRANSFERS ---
+// On the chip every Timer2 compare match of a transfer wakes the CPU for
+// one bus step; here the whole transfer goes out at once, in no virtual
+// time, and the fake TM1637 sees each pin write of it.
+static uint32_t display_steps = 0;
+
+static void display_transfer(void) {
+    for (uint16_t n = 0; TIMSK2 & (1 << OCIE2A); n++) {
+        if (n > 10000) {
+            fprintf(stderr, "sim: display transfer never ends\n");
+            exit(2);
+        }
+        TIMER2_COMPA_vect();
+        display_steps++;
+    }
+    sim_tm1637_idle();
+}
+
+uint32_t sim_display_steps(void) {
+    return display_steps;
+}
+
+// The CPU sleeps: advance the clock to whatever wakes it next. If that is
+// past the horizon, hand control back to the harness until it asks for more.
+void sim_sleep_cpu(void) {
+    if (sleep_mode != SLEEP_MODE_PWR_DOWN && (TIMSK2 & (1 << OCIE2A))) {
+        display_transfer();
+        return;
+    }
+
+    for (;;) {
+        uint32_t now = sim_time_ms();
+        uint32_t wake = 0;
+        uint8_t have = 0;
+
+        // Timers are stopped in power-down; only the watchdog keeps time
+        if (sleep_mode != SLEEP_MODE_PWR_DOWN) {
+            have = sim_timer_next_deadline(&wake);
+        } else if (WDTCSR & (1 << WDIE)) {
+            wake = now + 1000;
+            have = 1;
+        }
+
+        uint32_t ee_at;
+        if (sleep_mode != SLEEP_MODE_PWR_DOWN && eeprom_next(now, &ee_at) && (!have || ee_at < wake)) {
+            wake = ee_at;
+            have = 3;
+        }
+
+        if (input_count > 0 && (!have || inputs[0].at_ms < wake)) {
+            wake = (inputs[0].at_ms > now) ? inputs[0].at_ms : now;
+            have = 2;
+        }
+
+        if (!have || wake > horizon_ms) {
+            set_time_ms(horizon_ms > now ? horizon_ms : now);
+            swapcontext(&firmware_ctx, &harness_ctx);
+            // Wake once on resume: the harness may have called into the
+            // firmware (queued commands etc.) while it was parked
+            return;
+        }
+
+        set_time_ms(wake);
+        if (have == 2) {
+            SimInput in = inputs[0];
+            input_count--;
+            for (uint16_t i = 0; i < input_count; i++) inputs[i] = inputs[i + 1];
+            apply_input(&in);
+        }
+        else if (have == 3) {
+            eeprom_service();
+        }
+        else if (sleep_mode == SLEEP_MODE_PWR_DOWN) {
+            WDT_vect();
+        }
+        return;
+    }
+}
+
+void sim_boot(void) {
+    if (booted) return;
+    booted = 1;
+    eeprom_init();
+
+    getcontext(&firmware_ctx);
+    firmware_ctx.uc_stack.ss_sp = firmware_stack;
+    firmware_ctx.uc_stack.ss_size = sizeof(firmware_stack);
+    firmware_ctx.uc_link = NULL;
+    makecontext(&firmware_ctx, firmware_entry, 0);
+
+    horizon_ms = 0;
+    swapcontext(&harness_ctx, &firmware_ctx);
+}
+
+void sim_run_until(uint32_t until_ms) {
+    if (!booted) sim_boot();
+    horizon_ms = until_ms;
+    while (sim_time_ms() < until_ms) {
+        swapcontext(&harness_ctx, &firmware_ctx);
+    }
+}
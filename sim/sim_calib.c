@@ -0,0 +1,23 @@
+// Oscillator calibration for the host simulator: the virtual clock runs
+// at exactly 8 MHz, so there is nothing to measure.
+#include "calib.h"
+#include "uart.h"
+
+uint8_t calib_init(void) {
+    return 0;
+}
+
+CalibSource calib_source(void) {
+    return CALIB_DEFAULT;
+}
+
+uint16_t calib_ticks_per_ms(void) {
+    return 125U << 8;
+}
+
+uint8_t calib_ubrr(void) {
+    return UART_CALIBRATED_UBRR;
+}
+
+void calib_invalidate(void) {
+}
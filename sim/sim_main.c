@@ -0,0 +1,1306 @@
+// Host simulator entry point (env:native)
+//
+//   program run MM:SS   set the time through the buttons, start it and
+//                       trace display frames / DFPlayer commands to the alarm
+//                       (minutes past 59 are entered as hours)
+//   program sweep       run every value 00:01 .. 99:59 and check that the
+//                       display counts down and the alarm fires on time
+//   program stopwatch   run the stopwatch and check its 10 ms display
+//   program channels    run overlapping timers on several channels
+//   program presets     check that times survive a power cycle (EEPROM log)
+//   program recover     check that a watchdog reset resumes a running timer
+//   program trace       dump the field trace with the service chord
+//   program glyphs      check the text and animations (SEt, PAUS, End)
+//   program display     check what the TM1637 driver puts on the bus
+//   program host        check the host control protocol (batches, CRC, repeats)
+//   program media       check the SD card catalogue across power cycles
+//   program serve       run in real time behind a pty for a host client
+//                       (tools/host_client.py); prints "PTY <path>" first
+#define _GNU_SOURCE // posix_openpt(), ptsname(), cfmakeraw()
+
+#include "sim.h"
+#include "app.h"
+#include "buttons.h"
+#include "dfplayer.h"
+#include "alarm.h"
+#include "media.h"
+#include "countdown.h"
+#include "presets.h"
+#include "recovery.h"
+#include "trace.h"
+#include "anim.h"
+#include "host.h"
+#include "tm1637.h"
+#include "power.h"
+#include "gestures.h"
+#include "sched.h"
+#include "eeprom_map.h"
+
+#include <avr/io.h>
+#include <util/crc16.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+int sim_trace = 0;
+
+// The fake DFPlayer reports its SD card online this long after power-on;
+// scripts start once it is up
+#define DF_ONLINE_MS    1200
+#define SCRIPT_START_MS (DF_ONLINE_MS + 100)
+
+#define TAP_HOLD_MS  40
+#define TAP_GAP_MS   80
+#define LONG_HOLD_MS 800 // Past GESTURE_LONG_MS
+#define E2END_SIM    0x03FF
+#define LABEL_WAIT_MS 900 // Past the "Ch n" label (main.c LABEL_MS)
+
+// Channel 1's alarm by root index (no SD card in the fake module unless
+// a test puts one in, media.h)
+#define ROOT_ALARM_TRACK 1
+
+// TimerState values (see main.c)
+#define ST_IDLE       0
+#define ST_SET_HR     1
+#define ST_SET_MIN    2
+#define ST_SET_SEC    3
+#define ST_RUNNING    4
+#define ST_PAUSED     5
+#define ST_ALARM      6
+#define ST_STOPWATCH  7
+#define ST_SW_RUNNING 8
+
+static uint32_t t_ms = 0; // Script cursor
+
+static void tap(uint8_t id) {
+    sim_press(id, t_ms, TAP_HOLD_MS);
+    t_ms += TAP_GAP_MS;
+    sim_run_until(t_ms);
+}
+
+static void chord(uint8_t a, uint8_t b) {
+    sim_press(a, t_ms, TAP_HOLD_MS);
+    sim_press(b, t_ms, TAP_HOLD_MS);
+    t_ms += TAP_GAP_MS;
+    sim_run_until(t_ms);
+}
+
+static void long_press(uint8_t id) {
+    sim_press(id, t_ms, LONG_HOLD_MS);
+    t_ms += LONG_HOLD_MS + TAP_GAP_MS;
+    sim_run_until(t_ms);
+}
+
+// Step a wrapping value from 'from' to 'to' the short way round
+static void step_to(uint8_t from, uint8_t to, uint8_t range) {
+    uint8_t up = (uint8_t)((to + range - from) % range);
+    uint8_t down = (uint8_t)(range - up) % range;
+    uint8_t id = (up <= down) ? BTN_R : BTN_L;
+    uint8_t n = (up <= down) ? up : down;
+    while (n--) tap(id);
+}
+
+static int fail(uint8_t m, uint8_t s, const char *why) {
+    fprintf(stderr, "FAIL %02u:%02u  %s (t=%lu ms, display [%s])\n",
+            m, s, why, (unsigned long)sim_time_ms(), sim_display_text());
+    return 1;
+}
+
+// What a countdown with 'ms' left shows: HH:MM above an hour, MM:SS down
+// to a minute, then SS.cc, always rounded up
+static void countdown_text(char *buf, size_t len, uint32_t ms) {
+    uint32_t secs = (ms + 999) / 1000;
+    if (secs > 3600) {
+        uint32_t mins = (ms + 59999) / 60000;
+        snprintf(buf, len, "%02u:%02u", (unsigned)(mins / 60), (unsigned)(mins % 60));
+    } else if (secs >= 60) {
+        snprintf(buf, len, "%02u:%02u", (unsigned)(secs / 60), (unsigned)(secs % 60));
+    } else {
+        uint32_t cs = (ms + 9) / 10;
+        snprintf(buf, len, "%02u:%02u", (unsigned)(cs / 100 % 100), (unsigned)(cs % 100));
+    }
+}
+
+// Boot and wait for the DFPlayer; returns 0 on success
+static int boot(void) {
+    t_ms = SCRIPT_START_MS;
+    sim_df_reply(DF_ONLINE_MS, DF_EVT_ONLINE, 0x02);
+    sim_boot();
+    sim_run_until(t_ms);
+
+    if (sim_display_frames() == 0) return 1;
+    if (DF_BootStatus() != DF_READY_ONLINE) return 1;
+    if (sim_trace) {
+        printf("boot: audio ready %u ms after DF_Init()\n", DF_ReadyTime());
+    }
+    return 0;
+}
+
+// Returns 0 on success
+static int run_case(uint8_t m, uint8_t s) {
+    char want[16];
+    uint32_t total = (uint32_t)m * 60 + s;
+    uint8_t hr = (uint8_t)(total / 3600);
+    uint8_t min = (uint8_t)(total / 60 % 60);
+
+    if (boot()) return fail(m, s, "boot failed");
+
+    if (hr) {
+        long_press(BTN_L);    // IDLE -> SET_HR
+        if (app_state() != ST_SET_HR) return fail(m, s, "not in SET_HR");
+        step_to(0, hr, 100);
+        tap(BTN_M);           // -> SET_MIN
+    } else {
+        tap(BTN_L);           // IDLE -> SET_MIN
+    }
+    if (app_state() != ST_SET_MIN) return fail(m, s, "not in SET_MIN");
+    step_to(0, min, 60);
+    tap(BTN_M);           // -> SET_SEC
+    if (app_state() != ST_SET_SEC) return fail(m, s, "not in SET_SEC");
+    step_to(0, s, 60);
+    tap(BTN_M);           // -> IDLE
+    if (app_state() != ST_IDLE) return fail(m, s, "not back in IDLE");
+
+    // Start: the gesture fires on release
+    uint32_t start = t_ms + TAP_HOLD_MS;
+    tap(BTN_M);
+    if (app_state() != ST_RUNNING) return fail(m, s, "did not start");
+
+    countdown_text(want, sizeof(want), total * 1000 - (t_ms - start));
+    if (strcmp(sim_display_text(), want)) return fail(m, s, "wrong start display");
+
+    // The last second counts down in 10 ms steps, one frame per step
+    uint32_t end = start + total * 1000;
+    sim_run_until(end - 900);
+    uint32_t frames = sim_display_frames();
+    sim_run_until(end - 500);
+    if (strcmp(sim_display_text(), "00:50")) return fail(m, s, "wrong SS.cc display");
+    sim_run_until(end - 5);
+    if (strcmp(sim_display_text(), "00:01")) return fail(m, s, "did not reach 00.01");
+    if (app_state() != ST_RUNNING) return fail(m, s, "alarm too early");
+    frames = sim_display_frames() - frames;
+    if (frames != 89) return fail(m, s, "last second not at 100 frames/s");
+
+    // The alarm goes out right at the end: soft volume first, then the looped track
+    uint32_t alarm_at = end;
+    uint16_t first = sim_df_count();
+    sim_run_until(alarm_at + 100);
+    if (app_state() != ST_ALARM) return fail(m, s, "no alarm");
+
+    const SimDfCommand *vol = sim_df_get(first);
+    const SimDfCommand *loop = sim_df_get(first + 1);
+    if (!vol || vol->cmd != DF_CMD_SET_VOL || vol->time_ms != alarm_at) return fail(m, s, "alarm sent late");
+    if (!loop || loop->cmd != DF_CMD_LOOP_TRACK || loop->param != ROOT_ALARM_TRACK) return fail(m, s, "alarm track not sent");
+    if (sim_df_bad_frames()) return fail(m, s, "malformed DFPlayer frame");
+
+    DF_Stats st;
+    DF_GetStats(&st);
+    if (st.failed || st.timeouts || st.rx_bad) return fail(m, s, "DFPlayer protocol errors");
+
+    // Any button silences it
+    t_ms = alarm_at + 200;
+    tap(BTN_M);
+    if (app_state() != ST_IDLE) return fail(m, s, "alarm not dismissed");
+    const SimDfCommand *last = sim_df_get(sim_df_count() - 1);
+    if (last->cmd != DF_CMD_PAUSE) return fail(m, s, "sound not stopped");
+
+    if (sim_trace) {
+        DF_GetStats(&st);
+        printf("dfplayer: %u acks (last %u ms, worst %u ms), %u retries, %u failed, %u errors\n",
+               st.acks, st.ack_last_ms, st.ack_max_ms, st.retries, st.failed, st.errors);
+    }
+
+    return 0;
+}
+
+// Each case needs a freshly booted firmware, so run it in a child process
+static int run_isolated(uint8_t m, uint8_t s) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(2);
+    }
+    if (pid == 0) _exit(run_case(m, s));
+
+    int status;
+    waitpid(pid, &status, 0);
+    return !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+static int sweep(void) {
+    struct timespec t0, t1;
+    unsigned failures = 0, cases = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint8_t m = 0; m <= 99; m++) {
+        for (uint8_t s = 0; s <= 59; s++) {
+            if (m == 0 && s == 0) continue; // Start is refused at 00:00
+            failures += run_isolated(m, s);
+            cases++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("sweep: %u cases, %u failed, %.2f s\n", cases, failures, secs);
+    return failures ? 1 : 0;
+}
+
+// Stopwatch: SS.cc for the first minute (a frame every 10 ms), MM:SS
+// after that, buttons still handled at full frame rate
+static int stopwatch(void) {
+    if (boot()) return fail(0, 0, "boot failed");
+
+    long_press(BTN_M);        // IDLE -> STOPWATCH
+    if (app_state() != ST_STOPWATCH) return fail(0, 0, "not in STOPWATCH");
+    if (strcmp(sim_display_text(), "00:00")) return fail(0, 0, "not cleared");
+
+    uint32_t start = t_ms + TAP_HOLD_MS;
+    tap(BTN_M);               // -> SW_RUNNING
+    if (app_state() != ST_SW_RUNNING) return fail(0, 0, "did not start");
+
+    uint32_t frames = sim_display_frames();
+    sim_run_until(start + 12345);
+    if (strcmp(sim_display_text(), "12:34")) return fail(0, 0, "wrong SS.cc display");
+    frames = sim_display_frames() - frames;
+    if (frames < 1230 || frames > 1235) return fail(0, 0, "not at 100 frames/s");
+
+    // Arming the next frame takes 15 ms, so its deadline has passed by the
+    // time the compare would be set: the loop has to go round, not sleep
+    uint32_t slip_at = start + 13000;
+    sim_timer_slip(slip_at, 15000);
+    sim_run_until(slip_at - 5);
+    frames = sim_display_frames();
+    sim_run_until(slip_at + 40);
+    if (!sim_timer_slipped()) return fail(0, 0, "no slow arm");
+    if (sim_display_frames() - frames < 3) return fail(0, 0, "frames stopped after a slow arm");
+
+    // Stop lands on the release edge; the display freezes there
+    t_ms = start + 20000;
+    uint32_t stop = t_ms + TAP_HOLD_MS;
+    tap(BTN_M);
+    if (app_state() != ST_STOPWATCH) return fail(0, 0, "did not stop");
+    char want[16];
+    snprintf(want, sizeof(want), "%02u:%02u", (unsigned)((stop - start) / 1000),
+             (unsigned)((stop - start) % 1000 / 10));
+    if (strcmp(sim_display_text(), want)) return fail(0, 0, "stopped at the wrong time");
+    frames = sim_display_frames();
+    sim_run_until(t_ms + 5000);
+    if (sim_display_frames() != frames) return fail(0, 0, "display still moving");
+
+    // Resume past the minute: MM:SS, one frame a second
+    t_ms = stop + 5000;
+    tap(BTN_M);
+    sim_run_until(start + 5000 + 65500);
+    if (strcmp(sim_display_text(), "01:05")) return fail(0, 0, "wrong MM:SS display");
+
+    t_ms = sim_time_ms();
+    tap(BTN_M);               // Stop
+    tap(BTN_L);               // Clear
+    if (strcmp(sim_display_text(), "00:00")) return fail(0, 0, "not cleared");
+
+    // A tap shorter than the debounce window: its release is dropped as
+    // a bounce and picked up when the window ends, not at the next wake
+    sim_press(BTN_M, t_ms, 10);
+    sim_run_until(t_ms + 35);
+    if (app_state() != ST_SW_RUNNING) return fail(0, 0, "short tap not seen at the window end");
+    t_ms += TAP_GAP_MS;
+    sim_run_until(t_ms);
+    tap(BTN_M);               // Stop
+    tap(BTN_L);               // Clear
+    tap(BTN_R);               // -> IDLE
+    if (app_state() != ST_IDLE) return fail(0, 0, "did not leave");
+
+    printf("stopwatch: OK, %lu frames\n", (unsigned long)sim_display_frames());
+    return 0;
+}
+
+// Track of the last DF_CMD_LOOP_TRACK sent, 0 if none
+static uint16_t last_loop_track(void) {
+    for (uint16_t i = sim_df_count(); i-- > 0;) {
+        const SimDfCommand *c = sim_df_get(i);
+        if (c->cmd == DF_CMD_LOOP_TRACK) return c->param;
+    }
+    return 0;
+}
+
+// From IDLE on the selected channel: set SS seconds (starting from 'from')
+// and start it. Returns the start time.
+static uint32_t start_secs(uint8_t from, uint8_t secs) {
+    tap(BTN_L);               // SET_MIN
+    tap(BTN_M);               // SET_SEC
+    step_to(from, secs, 60);
+    tap(BTN_M);               // IDLE
+    uint32_t start = t_ms + TAP_HOLD_MS;
+    tap(BTN_M);               // RUNNING
+    return start;
+}
+
+static int expect_alarm(uint8_t ch, uint16_t track) {
+    if (app_state() != ST_ALARM) return fail(0, ch, "no alarm");
+    if (app_channel() != ch) return fail(0, ch, "alarm on the wrong channel");
+    if (last_loop_track() != track) return fail(0, ch, "wrong alarm track");
+    return 0;
+}
+
+// Channels: two overlapping timers, each alarms with its own track; two
+// expiring together queue up behind each other
+static int channels(void) {
+    if (boot()) return fail(0, 0, "boot failed");
+
+    uint32_t start1 = start_secs(0, 30);  // Channel 1: 30 s
+    if (app_state() != ST_RUNNING || app_channel() != 0) return fail(0, 0, "channel 1 not running");
+
+    chord(BTN_M, BTN_R);                  // -> channel 2
+    if (app_state() != ST_IDLE || app_channel() != 1) return fail(0, 1, "no channel switch");
+    if (strcmp(sim_display_text(), "Ch  2")) return fail(0, 1, "no channel label");
+
+    uint32_t start2 = start_secs(0, 10);  // Channel 2: 10 s, ends first
+    chord(BTN_M, BTN_R);                  // -> channel 3, idle: shows the soonest
+    if (app_state() != ST_IDLE || app_channel() != 2) return fail(0, 2, "no channel switch");
+    sim_run_until(t_ms + 2 * LABEL_WAIT_MS);
+    char want[16];
+    countdown_text(want, sizeof(want), start2 + 10000 - t_ms - 2 * LABEL_WAIT_MS);
+    if (strcmp(sim_display_text(), want)) return fail(0, 2, "not showing the soonest timer");
+
+    sim_run_until(start2 + 10000 + 100);
+    if (expect_alarm(1, 3)) return 1;
+    t_ms = sim_time_ms();
+    tap(BTN_M);                           // Dismiss: channel 1 still running
+    if (app_state() != ST_IDLE) return fail(0, 1, "alarm not dismissed");
+
+    sim_run_until(start1 + 30000 + 100);
+    if (expect_alarm(0, ROOT_ALARM_TRACK)) return 1;
+    t_ms = sim_time_ms();
+    tap(BTN_M);
+    if (app_state() != ST_IDLE || app_channel() != 0) return fail(0, 0, "alarm not dismissed");
+
+    // Both run out while nobody looks: the second alarm waits for the first
+    start1 = start_secs(30, 5);           // Channel 1: 5 s
+    chord(BTN_M, BTN_R);
+    tap(BTN_M);                           // Channel 2: its stored 10 s
+    if (app_state() != ST_RUNNING || app_channel() != 1) return fail(0, 1, "channel 2 not running");
+    sim_run_until(t_ms + LABEL_WAIT_MS);
+    if (strcmp(sim_display_text(), "Ch  1")) return fail(0, 0, "soonest channel not labelled");
+    sim_run_until(t_ms + 2 * LABEL_WAIT_MS);
+    countdown_text(want, sizeof(want), start1 + 5000 - t_ms - 2 * LABEL_WAIT_MS);
+    if (strcmp(sim_display_text(), want)) return fail(0, 0, "running: not showing the soonest timer");
+    sim_run_until(start1 + 12000);
+    if (expect_alarm(0, ROOT_ALARM_TRACK)) return 1;
+    t_ms = sim_time_ms();
+    tap(BTN_M);
+    t_ms += 300;              // Pause, volume, track through the ACK pacing
+    sim_run_until(t_ms);
+    if (expect_alarm(1, 3)) return 1;
+    tap(BTN_M);
+    if (app_state() != ST_IDLE) return fail(0, 1, "alarm not dismissed");
+
+    DF_Stats st;
+    DF_GetStats(&st);
+    if (st.failed || st.timeouts || st.rx_bad || sim_df_bad_frames()) return fail(0, 0, "DFPlayer protocol errors");
+
+    printf("channels: OK, %u channels x %u bytes SRAM\n", CD_CHANNELS, app_channel_bytes());
+    return 0;
+}
+
+// --- PRESETS ---
+// Each power cycle is a child process; the EEPROM goes from one to the
+// next through a pipe, and so does the .noinit snapshot (recovery.c), which
+// is only meant to be trusted after a reset that kept the RAM powered.
+static uint8_t ee_image[E2END_SIM + 1];
+static RecoverySnapshot ram_image;
+static uint8_t ee_valid = 0;
+
+static int power_cycle(int (*phase)(void)) {
+    int fd[2];
+    if (pipe(fd)) {
+        perror("pipe");
+        exit(2);
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(2);
+    }
+    if (pid == 0) {
+        close(fd[0]);
+        if (ee_valid) {
+            memcpy(sim_eeprom(), ee_image, sizeof(ee_image));
+            *recovery_snapshot() = ram_image;
+        }
+        int r = phase();
+        if (write(fd[1], sim_eeprom(), sizeof(ee_image)) != (ssize_t)sizeof(ee_image)) r = 1;
+        if (write(fd[1], recovery_snapshot(), sizeof(ram_image)) != (ssize_t)sizeof(ram_image)) r = 1;
+        fflush(stdout);
+        _exit(r);
+    }
+    close(fd[1]);
+    size_t got = 0;
+    while (got < sizeof(ee_image)) {
+        ssize_t n = read(fd[0], ee_image + got, sizeof(ee_image) - got);
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    while (got < sizeof(ee_image) + sizeof(ram_image)) {
+        ssize_t n = read(fd[0], (uint8_t *)&ram_image + got - sizeof(ee_image),
+                         sizeof(ee_image) + sizeof(ram_image) - got);
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fd[0]);
+    ee_valid = (got == sizeof(ee_image) + sizeof(ram_image));
+
+    int status;
+    waitpid(pid, &status, 0);
+    return !(WIFEXITED(status) && WEXITSTATUS(status) == 0 && ee_valid);
+}
+
+static int ee_erased(void) {
+    for (uint16_t i = EE_PRESET_ADDR; i < EE_PRESET_ADDR + EE_PRESET_SIZE; i++) {
+        if (sim_eeprom()[i] != 0xFF) return 0;
+    }
+    return 1;
+}
+
+// First power-up: use 00:07 on channel 1, store 12:34 as favourite 1
+static int presets_first(void) {
+    if (boot()) return fail(0, 0, "boot failed");
+    if (strcmp(sim_display_text(), "00:00")) return fail(0, 0, "blank EEPROM not 00:00");
+
+    uint32_t start = start_secs(0, 7);
+    sim_run_until(start + PRESET_SETTLE_MS - 200);
+    if (!ee_erased()) return fail(0, 0, "written before settling");
+    sim_run_until(start + PRESET_SETTLE_MS + 500);
+    if (ee_erased()) return fail(0, 0, "not written");
+
+    t_ms = start + 7000 + 100;                 // Alarm, dismiss
+    sim_run_until(t_ms);
+    tap(BTN_M);
+
+    tap(BTN_L);                                // SET_MIN
+    step_to(0, 12, 60);
+    tap(BTN_M);                                // SET_SEC
+    step_to(7, 34, 60);
+    tap(BTN_M);                                // IDLE
+    chord(BTN_L, BTN_M);                       // Save as P1
+    if (strcmp(sim_display_text(), "P   1")) return fail(0, 0, "no favourite label");
+    t_ms += PRESET_SETTLE_MS + 500;
+    sim_run_until(t_ms);
+
+    PresetStats st;
+    presets_get_stats(&st);
+    if (st.saves != 2 || st.seq != 2 || st.head != 1) return fail(0, 0, "wrong log position");
+    return 0;
+}
+
+// Next power-up: both are back
+static int presets_second(void) {
+    if (boot()) return fail(0, 0, "boot failed");
+    if (strcmp(sim_display_text(), "00:07")) return fail(0, 0, "last-used time not restored");
+
+    long_press(BTN_R);                         // Recall P1
+    sim_run_until(t_ms + LABEL_WAIT_MS);
+    t_ms = sim_time_ms();
+    if (strcmp(sim_display_text(), "12:34")) return fail(0, 0, "favourite not restored");
+    return 0;
+}
+
+// Many saves: they walk the whole ring
+#define WEAR_SAVES 40
+
+static int presets_wear(void) {
+    if (boot()) return fail(0, 0, "boot failed");
+    PresetStats st;
+    presets_get_stats(&st);
+    uint16_t seq0 = st.seq;
+
+    for (uint8_t i = 0; i < WEAR_SAVES; i++) {
+        tap(BTN_R);                            // SET_SEC
+        tap(BTN_R);                            // +1 s
+        tap(BTN_M);                            // IDLE
+        tap(BTN_M);                            // Start (saves)
+        chord(BTN_L, BTN_R);                   // Cancel
+        t_ms += PRESET_SETTLE_MS + 500;
+        sim_run_until(t_ms);
+    }
+
+    presets_get_stats(&st);
+    uint8_t records = EE_PRESET_SIZE / PRESET_RECORD_SIZE;
+    if (st.saves != WEAR_SAVES || st.seq != seq0 + WEAR_SAVES) return fail(0, 0, "saves lost");
+    if (st.head != (seq0 + WEAR_SAVES - 1) % records) return fail(0, 0, "ring not advancing");
+    printf("presets: %u saves, newest seq %u in record %u/%u, %u bytes written, %u skipped\n",
+           st.saves, st.seq, st.head, records, st.bytes.written, st.bytes.skipped);
+
+    // Pull the plug halfway through the newest record: its CRC no longer matches
+    sim_eeprom()[EE_PRESET_ADDR + st.head * PRESET_RECORD_SIZE + 5] ^= 0x5A;
+    return 0;
+}
+
+static int presets_torn(void) {
+    if (boot()) return fail(0, 0, "boot failed");
+    PresetStats st;
+    presets_get_stats(&st);
+    if (!st.restored || st.seq != 2 + WEAR_SAVES - 1) return fail(0, 0, "did not fall back to the previous record");
+    printf("presets: boot scan %u bytes read\n", st.scan_reads);
+    return 0;
+}
+
+static int presets(void) {
+    if (power_cycle(presets_first)) return 1;
+    if (power_cycle(presets_second)) return 1;
+    if (power_cycle(presets_wear)) return 1;
+    if (power_cycle(presets_torn)) return 1;
+    printf("presets: OK\n");
+    return 0;
+}
+
+// --- RESET RECOVERY ---
+#define RECOVER_SECS 120
+#define RECOVER_CRASH_MS 40000
+
+// recovery_init()'s estimate for a watchdog reset
+#define RECOVER_LOST_MS (RECOVERY_WDT_MS + RECOVERY_STARTUP_MS)
+
+static uint32_t recover_left = 0;
+
+// Start 02:00, then hang 40 s in: the watchdog resets us one period
+// after the last loop pass
+static int recover_run(void) {
+    if (boot()) return fail(0, 0, "boot failed");
+    tap(BTN_L);                                // SET_MIN
+    step_to(0, RECOVER_SECS / 60, 60);
+    tap(BTN_M);                                // SET_SEC
+    tap(BTN_M);                                // IDLE
+    tap(BTN_M);                                // RUNNING
+    sim_run_until(t_ms + RECOVER_CRASH_MS);
+    if (app_state() != ST_RUNNING) return fail(0, 0, "not running");
+    // Reset-only: a hang with interrupts off must still reset
+    if ((WDTCSR & ((1 << WDE) | (1 << WDIE))) != (1 << WDE)) return fail(0, 0, "watchdog not in reset mode");
+    return 0;
+}
+
+// Watchdog reset: the countdown carries on, short by the reset time
+static int recover_warm(void) {
+    const RecoverySnapshot *snap = recovery_snapshot();
+    if (snap->status[0] != CD_RUNNING) return fail(0, 0, "no snapshot of the running timer");
+    recover_left = snap->left[0];
+
+    sim_reset_cause(1 << WDRF);
+    sim_boot();                                // The DFPlayer kept running: no ONLINE
+    uint32_t back = sim_time_ms();
+    if (app_state() != ST_RUNNING) return fail(0, 0, "not resumed");
+    if (recovery_reset_cause() != (1 << WDRF)) return fail(0, 0, "wrong reset cause");
+
+    uint32_t end = recover_left - RECOVER_LOST_MS;
+    char want[16];
+    sim_run_until(100);
+    countdown_text(want, sizeof(want), end - sim_time_ms());
+    if (strcmp(sim_display_text(), want)) return fail(0, 0, "wrong time after the reset");
+    if (DF_BootStatus() != DF_READY_WARM) return fail(0, 0, "DFPlayer not picked up warm");
+
+    sim_run_until(end - 5);
+    if (app_state() != ST_RUNNING) return fail(0, 0, "alarm early");
+    sim_run_until(end + 5);
+    if (app_state() != ST_ALARM) return fail(0, 0, "alarm late");
+
+    printf("recover: running again %lu ms after boot, %lu ms lost to the reset, audio back in %u ms\n",
+           (unsigned long)back, (unsigned long)RECOVER_LOST_MS, DF_ReadyTime());
+    return 0;
+}
+
+// Reset button with a timer running: a deliberate restart, not resumed
+static int recover_button(void) {
+    if (recovery_snapshot()->status[0] != CD_RUNNING) return fail(0, 0, "no snapshot of the running timer");
+    sim_reset_cause(1 << EXTRF);
+    if (boot()) return fail(0, 0, "boot failed");
+    if (app_state() != ST_IDLE) return fail(0, 0, "resumed after the reset button");
+    return 0;
+}
+
+// Power-on: whatever the RAM holds is not a snapshot
+static int recover_cold(void) {
+    sim_reset_cause(1 << PORF);
+    if (boot()) return fail(0, 0, "boot failed");
+    if (app_state() != ST_IDLE) return fail(0, 0, "resumed after power-on");
+    return 0;
+}
+
+static int recover(void) {
+    if (power_cycle(recover_run)) return 1;
+    if (power_cycle(recover_warm)) return 1;
+    if (power_cycle(recover_run)) return 1;
+    if (power_cycle(recover_button)) return 1;
+    if (power_cycle(recover_cold)) return 1;
+    printf("recover: OK\n");
+    return 0;
+}
+
+// --- TRACE ---
+// Run a timer to its alarm, go to the stopwatch and ask for the dump
+static int trace_check(void) {
+    if (boot()) return fail(0, 0, "boot failed");
+    uint32_t start = start_secs(0, 3);
+    t_ms = start + 3000 + 100;
+    sim_run_until(t_ms);
+    if (app_state() != ST_ALARM) return fail(0, 0, "no alarm");
+    tap(BTN_M);
+    long_press(BTN_M);                         // STOPWATCH
+    chord(BTN_L, BTN_M);                       // Dump
+    t_ms += 1000;
+    sim_run_until(t_ms);
+    if (app_state() != ST_STOPWATCH) return fail(0, 0, "chord left the stopwatch");
+    if (trace_dumping()) return fail(0, 0, "dump did not finish");
+
+    const char *text = sim_uart_text();
+    unsigned count, now, ms, type, arg;
+    if (sscanf(text, "TRACE %4x %8x\n", &count, &now) != 2) return fail(0, 0, "no trace header");
+
+    // Events: oldest first, in time order, ending with what led here
+    uint8_t seen_alarm = 0, seen_loop = 0, events = 0;
+    unsigned last_ms = 0, last_type = 0, last_arg = 0;
+    const char *p = strchr(text, '\n') + 1;
+    while (sscanf(p, "%4x %2x %2x\n", &ms, &type, &arg) == 3 && p[4] == ' ') {
+        if (ms < last_ms) return fail(0, 0, "trace out of order");
+        if (type == TR_STATE && arg == ST_ALARM) seen_alarm = 1;
+        if (type == TR_DF_TX && arg == DF_CMD_LOOP_TRACK) seen_loop = 1;
+        last_ms = ms;
+        last_type = type;
+        last_arg = arg;
+        events++;
+        p = strchr(p, '\n') + 1;
+    }
+    if (events != (count < TRACE_SIZE ? count : TRACE_SIZE)) return fail(0, 0, "wrong number of events");
+    if (!seen_alarm || !seen_loop) return fail(0, 0, "alarm missing from the trace");
+    if (last_type != TR_GESTURE || last_arg != (GESTURE_CHORD << 4 | GESTURE_CHORD_LM)) {
+        return fail(0, 0, "trace does not end with the chord");
+    }
+
+    unsigned tasks = 0;
+    while (*p == 'P' || *p == 'S') {
+        tasks += (*p == 'S');
+        p = strchr(p, '\n') + 1;
+    }
+    if (tasks != sched_task_count()) return fail(0, 0, "task counters missing");
+    if (sched_task_count() == SCHED_MAX_TASKS && sched_add(0, 0, 0) != SCHED_NONE) {
+        return fail(0, 0, "task table overrun");
+    }
+    if (strcmp(p, "END\n")) return fail(0, 0, "no end marker");
+    if (sim_df_bad_frames()) return fail(0, 0, "dump garbled the DFPlayer frames");
+
+    // Recording carries on afterwards
+    tap(BTN_R);
+    if (trace_count != count + 2) return fail(0, 0, "not recording after the dump");
+
+    printf("%s", text);
+    printf("trace: OK, %u events recorded, %u bytes dumped\n", count, (unsigned)strlen(text));
+    return 0;
+}
+
+// --- GLYPHS ---
+// Text and animations as the display shows them: the decoder turns 'S'
+// into '5' and puts the colon position between digits 1 and 2, so
+// "SEt " reads "5E t " and " End" reads " E nd"
+static int glyphs(void) {
+    if (boot()) return fail(0, 0, "boot failed");
+
+    tap(BTN_L);                                // SET_MIN
+    if (strcmp(sim_display_text(), "5E t ")) return fail(0, 0, "no SEt on entering the settings");
+    tap(BTN_R);                                // Cuts it short
+    if (strcmp(sim_display_text(), "01:00")) return fail(0, 0, "SEt not cut short by a button");
+    tap(BTN_L);
+    tap(BTN_M);                                // SET_SEC
+    step_to(0, 2, 60);
+    tap(BTN_M);                                // IDLE
+    uint32_t start = t_ms + TAP_HOLD_MS;
+    tap(BTN_M);                                // RUNNING
+    uint32_t ran = t_ms + TAP_HOLD_MS - start;
+    tap(BTN_M);                                // PAUSED
+    if (app_state() != ST_PAUSED) return fail(0, 0, "not paused");
+    t_ms += 500;                               // Blink phase off
+    sim_run_until(t_ms);
+    if (strcmp(sim_display_text(), "PA U5")) return fail(0, 0, "no PAUS while paused");
+    t_ms += 500;
+    sim_run_until(t_ms);
+    if (sim_display_text()[2] != ':') return fail(0, 0, "time not back after PAUS");
+
+    // Alarm: "End" scrolls in, then fades; dismissing puts the brightness back
+    uint8_t bright = sim_display_brightness();
+    start = t_ms + TAP_HOLD_MS;
+    tap(BTN_M);                                // RUNNING
+    uint32_t alarm_at = start + 2000 - ran;
+    sim_run_until(alarm_at + 180);
+    if (app_state() != ST_ALARM) return fail(0, 0, "no alarm");
+    if (strcmp(sim_display_text(), "    E")) return fail(0, 0, "End not scrolling in");
+    sim_run_until(alarm_at + 400);
+    if (strcmp(sim_display_text(), " E nd")) return fail(0, 0, "End not in place");
+    if (sim_display_brightness() != 7) return fail(0, 0, "End not at full brightness");
+    sim_run_until(alarm_at + 780);
+    if (sim_display_brightness() != 1) return fail(0, 0, "End not fading");
+    sim_run_until(alarm_at + 1420);           // Once round the loop (640 ms)
+    if (sim_display_brightness() != 1) return fail(0, 0, "fade not looping");
+    t_ms = alarm_at + 1800;
+    tap(BTN_M);
+    if (app_state() != ST_IDLE) return fail(0, 0, "alarm not dismissed");
+    if (anim_active()) return fail(0, 0, "animation still playing");
+    if (sim_display_brightness() != bright) return fail(0, 0, "brightness not restored");
+    if (strcmp(sim_display_text(), "00:02")) return fail(0, 0, "time not back after the alarm");
+
+    // Spinner while the trace dump goes out, gone once it is done (the
+    // fake UART takes the whole dump at once, so only the end is seen)
+    long_press(BTN_M);                         // STOPWATCH
+    chord(BTN_L, BTN_M);                       // Dump
+    if (trace_dumping()) return fail(0, 0, "dump did not finish");
+    if (anim_active()) return fail(0, 0, "spinner left on");
+    if (strcmp(sim_display_text(), "00:00")) return fail(0, 0, "stopwatch not back");
+
+    printf("glyphs: OK, %lu frames\n", (unsigned long)sim_display_frames());
+    return 0;
+}
+
+// --- DISPLAY DRIVER ---
+// The real tm1637.c on the fake chip's pins, driven from the harness
+// while the UI sits in IDLE with nothing to redraw
+
+// Submit 'n' frames back to back and let the transfer go out. Returns
+// the bytes that reached the chip, -1 if the driver counted otherwise.
+static int disp_send(const uint8_t (*f)[4], uint8_t n) {
+    TM1637_Stats a, b;
+    uint32_t bus = sim_display_bytes();
+    tm1637_get_stats(&a);
+    for (uint8_t i = 0; i < n; i++) tm1637_display_segments(f[i][0], f[i][1], f[i][2], f[i][3]);
+    t_ms += 10;
+    sim_run_until(t_ms);
+    tm1637_get_stats(&b);
+    bus = sim_display_bytes() - bus;
+    if (b.bytes_requested - a.bytes_requested != 6u * n || b.bytes_sent - a.bytes_sent != bus) return -1;
+    return (int)bus;
+}
+
+static int display(void) {
+    if (boot()) return fail(0, 0, "boot failed");
+    uint32_t frames = sim_display_frames();
+    t_ms += 2000;
+    sim_run_until(t_ms);
+    if (sim_display_frames() != frames) return fail(0, 0, "display not quiet in IDLE");
+
+    uint8_t d[10];
+    for (uint8_t i = 0; i < 10; i++) d[i] = tm1637_digit(i);
+    TM1637_Stats st, was;
+    tm1637_get_stats(&was);
+
+    // Full write (data command, address, 4 digits) when more than two
+    // digits change, one fixed-address write per digit otherwise. Timer2
+    // clocks a bit per interrupt: 3 per transaction and 9 per byte.
+    static const struct {
+        uint8_t digits[4];
+        uint8_t bytes, irqs;
+        const char *text;
+    } steps[] = {
+        { { 1, 2, 3, 4 }, 6, 60, "12 34" }, // All four
+        { { 1, 2, 3, 4 }, 0,  0, "12 34" }, // Same frame: skipped
+        { { 1, 2, 3, 5 }, 3, 33, "12 35" }, // One: data command + address + digit
+        { { 1, 2, 6, 7 }, 5, 54, "12 67" }, // Two
+        { { 9, 2, 8, 8 }, 6, 60, "92 88" }, // Three: full write again
+    };
+    for (uint8_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        uint8_t f[1][4];
+        for (uint8_t k = 0; k < 4; k++) f[0][k] = d[steps[i].digits[k]];
+        uint32_t irqs = sim_display_steps();
+        int n = disp_send(f, 1);
+        if (n != steps[i].bytes) return fail(0, i, "wrong bytes on the bus");
+        if (sim_display_steps() - irqs != steps[i].irqs) return fail(0, i, "wrong number of bus interrupts");
+        if (strcmp(sim_display_text(), steps[i].text)) return fail(0, i, "wrong digits on the display");
+    }
+    tm1637_get_stats(&st);
+    if (st.frames_skipped != was.frames_skipped + 1) return fail(0, 0, "same frame not skipped");
+
+    // While the first goes out the second waits and the third replaces it;
+    // only the difference between the first and the third is sent after
+    const uint8_t burst[3][4] = {
+        { d[1], d[2], d[8], d[8] },
+        { d[3], d[3], d[3], d[3] },
+        { d[1], d[2], d[8], d[0] },
+    };
+    if (disp_send(burst, 3) != 3 + 3) return fail(0, 0, "burst not coalesced");
+    if (strcmp(sim_display_text(), "12 80")) return fail(0, 0, "burst did not end on the latest frame");
+    tm1637_get_stats(&was);
+    if (was.frames_replaced != st.frames_replaced + 1) return fail(0, 0, "replaced frame not counted");
+
+    // Brightness is one byte; a byte the chip does not acknowledge is
+    // counted, and the frame still lands
+    uint8_t bright = sim_display_brightness();
+    uint32_t bus = sim_display_bytes();
+    tm1637_set_brightness(5);
+    t_ms += 10;
+    sim_run_until(t_ms);
+    if (sim_display_brightness() != 5 || sim_display_bytes() - bus != 1) return fail(0, 0, "brightness not sent");
+    tm1637_set_brightness(bright);
+    t_ms += 10;
+    sim_run_until(t_ms);
+
+    sim_display_nak(3);
+    const uint8_t nak[1][4] = { { d[1], d[2], d[8], d[1] } };
+    if (disp_send(nak, 1) != 3) return fail(0, 0, "frame not sent without ACKs");
+    tm1637_get_stats(&st);
+    if (st.ack_failures != was.ack_failures + 3) return fail(0, 0, "missing ACKs not counted");
+    if (strcmp(sim_display_text(), "12 81")) return fail(0, 0, "frame lost without ACKs");
+
+    printf("display: OK, %lu of %lu bytes sent\n", (unsigned long)st.bytes_sent, (unsigned long)st.bytes_requested);
+    return 0;
+}
+
+// --- HOST LINK ---
+// Packets built and checked the way tools/host_client.py does it
+static void host_send(uint8_t seq, const uint8_t *payload, uint8_t len) {
+    uint8_t pkt[HOST_OVERHEAD + HOST_MAX_PAYLOAD];
+    uint16_t crc = 0xFFFF;
+    pkt[0] = HOST_START_BYTE;
+    pkt[1] = len;
+    pkt[2] = seq;
+    memcpy(&pkt[3], payload, len);
+    for (uint8_t i = 1; i < 3 + len; i++) crc = _crc_xmodem_update(crc, pkt[i]);
+    pkt[3 + len] = (uint8_t)crc;
+    pkt[4 + len] = (uint8_t)(crc >> 8);
+    sim_uart_host_rx(pkt, (uint16_t)(HOST_OVERHEAD + len));
+}
+
+// Reply to 'seq' into 'payload' (HOST_MAX_REPLY bytes); returns its length,
+// -1 if none came or it is malformed
+static int host_reply(uint8_t seq, uint8_t *payload) {
+    uint8_t pkt[HOST_OVERHEAD + HOST_MAX_REPLY + 1];
+    uint16_t n = sim_uart_host_tx(pkt, sizeof(pkt));
+    if (n < HOST_OVERHEAD || pkt[0] != HOST_START_BYTE || n != pkt[1] + HOST_OVERHEAD || pkt[2] != seq) return -1;
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 1; i < n - 2; i++) crc = _crc_xmodem_update(crc, pkt[i]);
+    if (pkt[n - 2] != (uint8_t)crc || pkt[n - 1] != (uint8_t)(crc >> 8)) return -1;
+    memcpy(payload, &pkt[3], pkt[1]);
+    return pkt[1];
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t get16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+// Send a batch and give the firmware a loop pass or two for it
+static int host_batch(uint8_t seq, const uint8_t *payload, uint8_t len, uint8_t *reply) {
+    host_send(seq, payload, len);
+    t_ms += 10;
+    sim_run_until(t_ms);
+    return host_reply(seq, reply);
+}
+
+// One packet sets and starts two channels and reads the state back; a
+// repeat only resends the reply; errors end the batch; bad CRCs, torn
+// packets and the module's frames (with the start byte inside) are kept
+// apart; stopping a ringing channel takes the UI out of the alarm.
+static int host_check(void) {
+    uint8_t reply[HOST_MAX_REPLY];
+    if (boot()) return fail(0, 0, "boot failed");
+
+    static const uint8_t setup[] = {
+        HOST_OP_SET, 0, 0, 0, 3,
+        HOST_OP_SET, 1, 0, 1, 5,
+        HOST_OP_START, 0,
+        HOST_OP_START, 1,
+        HOST_OP_STATE,
+    };
+    uint32_t start = t_ms;
+    int n = host_batch(1, setup, sizeof(setup), reply);
+    if (n != 4 * 2 + 2 + 3 + 5 * CD_CHANNELS) return fail(0, 0, "no reply to the setup batch");
+    for (uint8_t i = 0; i < 5; i++) {
+        if (reply[i * 2] != setup[i < 2 ? i * 5 : 10 + (i - 2) * 2] || reply[i * 2 + 1] != HOST_OK) {
+            return fail(0, i, "setup command failed");
+        }
+    }
+    const uint8_t *st = &reply[10];
+    if (st[0] != ST_RUNNING || st[1] != 0 || st[2] != CD_CHANNELS) return fail(0, 0, "UI not following channel 1");
+    if (st[3] != CD_RUNNING || st[8] != CD_RUNNING || st[13] != CD_IDLE) return fail(0, 0, "wrong channel status");
+    uint32_t left0 = get32(&st[4]), left1 = get32(&st[9]);
+    if (left0 > 3000 || left0 < 3000 - (t_ms - start) || left1 != left0 + 62000) return fail(0, 0, "wrong time left");
+
+    // Same seq again: same reply, nothing started twice
+    t_ms += 500;
+    uint8_t again[HOST_MAX_REPLY];
+    if (host_batch(1, setup, sizeof(setup), again) != n || memcmp(again, reply, (size_t)n)) {
+        return fail(0, 0, "repeat not answered with the same reply");
+    }
+    if (countdown_remaining(0, sim_time_ms()) > left0 - 500) return fail(0, 0, "repeat ran the batch again");
+
+    // Refused command carries on, unknown op ends the batch
+    static const uint8_t mixed[] = { HOST_OP_PAUSE, 1, HOST_OP_START, 2, 0x55, HOST_OP_STATE };
+    n = host_batch(2, mixed, sizeof(mixed), reply);
+    if (n != 6 || reply[1] != HOST_OK || reply[3] != HOST_ERR_STATE || reply[4] != 0x55 || reply[5] != HOST_ERR_OP) {
+        return fail(0, 0, "wrong statuses in the mixed batch");
+    }
+    if (countdown_status(1) != CD_PAUSED) return fail(0, 1, "channel 2 not paused");
+
+    // Bad CRC: no reply, counted
+    uint8_t bad[] = { HOST_START_BYTE, 1, 3, HOST_OP_STATE, 0x00, 0x00 };
+    sim_uart_host_rx(bad, sizeof(bad));
+    t_ms += 10;
+    sim_run_until(t_ms);
+    if (host_reply(3, reply) != -1) return fail(0, 0, "reply to a bad CRC");
+
+    // Torn packet, then a module frame with the start byte in its data
+    sim_uart_host_rx(bad, 3);
+    t_ms += 100;
+    sim_run_until(t_ms);
+    uint8_t df[DF_FRAME_SIZE] = { DF_START_BYTE, 0xFF, 0x06, DF_QUERY_VOLUME, 0x00, 0x00, HOST_START_BYTE, 0, 0, 0xEF };
+    uint16_t sum = 0;
+    for (uint8_t i = 1; i <= 6; i++) sum += df[i];
+    sum = (uint16_t)(0 - sum);
+    df[7] = (uint8_t)(sum >> 8);
+    df[8] = (uint8_t)sum;
+    sim_uart_host_rx(df, sizeof(df));
+    t_ms += 10;
+    sim_run_until(t_ms);
+
+    // Channel 1 rings; stopping it from the host ends the alarm
+    sim_run_until(start + 3000 + 100);
+    if (app_state() != ST_ALARM) return fail(0, 0, "no alarm");
+    t_ms = sim_time_ms();
+    static const uint8_t stop[] = { HOST_OP_STOP, 0, HOST_OP_COUNTERS };
+    n = host_batch(4, stop, sizeof(stop), reply);
+    if (n != 4 + HOST_COUNTER_BYTES || reply[1] != HOST_OK || reply[3] != HOST_OK) return fail(0, 0, "stop failed");
+    if (app_state() != ST_IDLE) return fail(0, 0, "UI still in the alarm");
+    const SimDfCommand *last = sim_df_get(sim_df_count() - 1);
+    if (last->cmd != DF_CMD_PAUSE) return fail(0, 0, "sound not stopped");
+
+    // packets, errors, dropped, repeats, timeouts, rx overruns, DF failed,
+    // timeouts, rx_bad, queue high water, queue dropped
+    const uint8_t *c = &reply[4];
+    if (get16(&c[0]) != 3 || get16(&c[2]) != 1 || get16(&c[4]) != 0 || get16(&c[6]) != 1 || get16(&c[8]) != 1) {
+        return fail(0, 0, "wrong host counters");
+    }
+    if (get16(&c[15]) != 0) return fail(0, 0, "module frame garbled by the host parser");
+    // Volume and the card query wait in the queue while the module boots
+    if (c[17] < 2 || c[17] >= DF_QUEUE_SIZE || c[18] != 0) return fail(0, 0, "wrong DFPlayer queue counters");
+    uint16_t packets = get16(&c[0]), errors = get16(&c[2]), repeats = get16(&c[6]), torn = get16(&c[8]);
+    uint8_t queue_high = c[17];
+
+    // Power accounting for the ~3 s the UI spent in RUNNING: all of it in
+    // one bucket, and asleep (sim time only moves while the CPU sleeps)
+    static const uint8_t power[] = { HOST_OP_POWER, ST_RUNNING, HOST_OP_POWER, POWER_MAX_TAGS, HOST_OP_DISPLAY };
+    n = host_batch(5, power, sizeof(power), reply);
+    if (n != 2 + HOST_POWER_BYTES + 2 + 2 + HOST_DISPLAY_BYTES || reply[1] != HOST_OK ||
+        reply[3 + HOST_POWER_BYTES] != HOST_ERR_ARG || reply[5 + HOST_POWER_BYTES] != HOST_OK) {
+        return fail(0, 0, "power/display query failed");
+    }
+    const uint8_t *p = &reply[2];
+    uint32_t awake_ms = get32(&p[0]) * 1024 / 1000, asleep_ms = get32(&p[4]) * 1024 / 1000;
+    uint32_t running_ms = 3000; // Channel 1's time, then ALARM
+    if (awake_ms + asleep_ms + 30 < running_ms || awake_ms + asleep_ms > running_ms + 30 || awake_ms > 5) {
+        return fail(0, 0, "running time not accounted for");
+    }
+    if (get32(&p[8]) != 0 || get16(&p[12]) < running_ms / 1000) return fail(0, 0, "wrong sleep counters");
+
+    // Display traffic as the chip saw it, less than full frames would be
+    const uint8_t *dp = &reply[6 + HOST_POWER_BYTES];
+    if (get32(&dp[4]) != sim_display_bytes() || get32(&dp[4]) >= get32(&dp[0]) || get16(&dp[16]) != 0) {
+        return fail(0, 0, "wrong display counters");
+    }
+
+    // Channel 1's time being edited on the buttons: not overwritten
+    tap(BTN_L);                           // SET_MIN
+    static const uint8_t edit[] = { HOST_OP_SET, 0, 0, 0, 9, HOST_OP_SET, 1, 0, 0, 7, HOST_OP_FAV_LOAD, 0, 0 };
+    n = host_batch(6, edit, sizeof(edit), reply);
+    if (n != 6 || reply[1] != HOST_ERR_BUSY || reply[3] != HOST_OK || reply[5] != HOST_ERR_BUSY) {
+        return fail(0, 0, "edited channel not refused");
+    }
+    tap(BTN_M);                           // SET_SEC
+    tap(BTN_M);                           // IDLE
+    if (app_state() != ST_IDLE || strcmp(sim_display_text(), "00:03")) return fail(0, 0, "edit overwritten");
+
+    printf("host: OK, %u packets, %u CRC errors, %u repeats, %u torn, queue %u deep,"
+           " running %lu ms asleep in %u sleeps\n",
+           packets, errors, repeats, torn, queue_high, (unsigned long)asleep_ms, get16(&p[12]));
+    return 0;
+}
+
+// --- MEDIA CATALOGUE ---
+// Power cycles with an SD card in the module: counted once, then known by
+// its fingerprint, not asked at all after a watchdog reset, counted again
+// when it turns out to be another card
+// Commands of that kind sent from index 'from' on
+static uint16_t df_sent(uint16_t from, uint8_t cmd) {
+    uint16_t n = 0;
+    for (uint16_t i = from; i < sim_df_count(); i++) n += (sim_df_get(i)->cmd == cmd);
+    return n;
+}
+
+static int media_queries(uint16_t files, uint16_t folders, uint16_t counts) {
+    if (df_sent(0, DF_QUERY_SD_FILES) != files || df_sent(0, DF_QUERY_FOLDERS) != folders ||
+        df_sent(0, DF_QUERY_FOLDER_FILES) != counts) {
+        return fail(0, 0, "wrong media queries");
+    }
+    return 0;
+}
+
+// Channel 1 for 'secs'; returns when the alarm is due
+static uint32_t media_alarm(uint8_t secs) {
+    PresetTime t;
+    presets_get(PRESET_LAST(0), &t);
+    uint32_t start = start_secs(t.sec, secs);
+    t_ms = start + secs * 1000UL + 100;
+    sim_run_until(t_ms);
+    return start + secs * 1000UL;
+}
+
+// Index of the first such command from 'from' on, 0xFFFF if none
+static uint16_t df_find(uint16_t from, uint8_t cmd, uint16_t param) {
+    for (uint16_t i = from; i < sim_df_count(); i++) {
+        const SimDfCommand *c = sim_df_get(i);
+        if (c->cmd == cmd && c->param == param) return i;
+    }
+    return 0xFFFF;
+}
+
+// Folder file of the last DF_CMD_FOLDER (0 if none), checked to be repeated
+static uint16_t last_folder_file(void) {
+    for (uint16_t i = sim_df_count(); i-- > 0;) {
+        const SimDfCommand *c = sim_df_get(i);
+        if (c->cmd != DF_CMD_FOLDER) continue;
+        const SimDfCommand *r = sim_df_get(i + 1);
+        return (r && r->cmd == DF_CMD_REPEAT && r->param == 0) ? c->param : 0;
+    }
+    return 0;
+}
+
+static const uint8_t card_a[] = { 4 };    // 01: alarms, no 02
+static const uint8_t card_b[] = { 0 };    // Same file count, all in the root
+static const uint8_t card_c[] = { 4, 3 }; // 01: alarms, 02: escalation etc.
+
+// First boot: counted, cached; escalation isn't on the card (root index)
+static int media_first(void) {
+    sim_df_card(12, 1, card_a);
+    if (boot()) return fail(0, 0, "boot failed");
+    t_ms += 300;
+    sim_run_until(t_ms);
+    if (media_status() != MEDIA_SCANNED) return fail(0, 0, "card not counted");
+    if (media_queries(1, 1, 1)) return 1;
+
+    media_alarm(5);
+    if (app_state() != ST_ALARM || last_folder_file() != 0x0101) return fail(0, 0, "alarm not played from 01/001");
+    t_ms += ALARM_ESCALATE_MS;
+    sim_run_until(t_ms);
+    if (last_loop_track() != 2) return fail(0, 0, "escalation not on its root index");
+    tap(BTN_M);
+    if (sim_eeprom()[EE_MEDIA_ADDR + 2] == 0xFF) return fail(0, 0, "catalogue not cached");
+    return 0;
+}
+
+// Same card: the fingerprint (total, then folders 01-02) is all that is
+// asked. A file it promised turning out missing rings from the root and
+// has the card counted again.
+static int media_known(void) {
+    sim_df_card(12, 1, card_a);
+    if (boot()) return fail(0, 0, "boot failed");
+    t_ms += 300;
+    sim_run_until(t_ms);
+    if (media_status() != MEDIA_CACHED) return fail(0, 0, "catalogue not taken from EEPROM");
+    if (media_queries(1, 0, 2)) return 1;
+
+    media_alarm(5);
+    if (app_state() != ST_ALARM || last_folder_file() != 0x0101) return fail(0, 0, "alarm not played from 01/001");
+    sim_df_reply(t_ms, DF_EVT_ERROR, DF_ERR_NOT_FOUND);
+    t_ms += 300;
+    sim_run_until(t_ms);
+    if (app_state() != ST_ALARM || last_loop_track() != 1) return fail(0, 0, "alarm not on its root index");
+    if (media_status() != MEDIA_SCANNED || media_queries(2, 1, 3)) return fail(0, 0, "card not counted again");
+    tap(BTN_M);
+    return 0;
+}
+
+// Watchdog reset: the module kept its card, nothing is asked
+static int media_warm(void) {
+    sim_df_card(12, 1, card_a);
+    sim_reset_cause(1 << WDRF);
+    sim_boot();
+    sim_run_until(300);
+    if (DF_BootStatus() != DF_READY_WARM) return fail(0, 0, "DFPlayer not picked up warm");
+    if (media_status() != MEDIA_CACHED) return fail(0, 0, "catalogue not taken from EEPROM");
+    return media_queries(0, 0, 0);
+}
+
+// Another card with as many files: folder 01 gives it away at boot, it
+// is counted again and the alarm rings from the root
+static int media_swapped(void) {
+    sim_df_card(12, 1, card_b);
+    if (boot()) return fail(0, 0, "boot failed");
+    t_ms += 300;
+    sim_run_until(t_ms);
+    if (media_status() != MEDIA_SCANNED) return fail(0, 0, "swapped card not counted");
+    if (media_queries(1, 1, 2)) return 1;
+
+    media_alarm(5);
+    if (app_state() != ST_ALARM || last_loop_track() != 1) return fail(0, 0, "alarm not on its root index");
+    tap(BTN_M);
+    return 0;
+}
+
+// The cues before 'end': warning 10 s out, ticks on the last 3 seconds,
+// each played once
+static int media_cues(uint16_t from, uint32_t end, uint8_t warning) {
+    uint16_t i = df_find(from, DF_CMD_FOLDER, 0x0202);
+    if (warning != (i != 0xFFFF)) return fail(0, 0, "warning cue wrong");
+    if (warning && (sim_df_get(i)->time_ms + 100 < end - 10000 || sim_df_get(i)->time_ms > end - 10000 + 100)) {
+        return fail(0, 0, "warning cue off time");
+    }
+    i = from;
+    for (uint32_t s = 3; s >= 1; s--) {
+        i = df_find(i, DF_CMD_FOLDER, 0x0203);
+        if (i == 0xFFFF) return fail(0, 0, "tick cue missing");
+        uint32_t at = sim_df_get(i)->time_ms;
+        if (at + 100 < end - s * 1000 || at > end - s * 1000 + 100) return fail(0, 0, "tick cue off time");
+        i++;
+    }
+    if (df_find(i, DF_CMD_FOLDER, 0x0203) != 0xFFFF) return fail(0, 0, "extra tick cue");
+    return 0;
+}
+
+// New card: counted; escalation now comes from 02/001 and the timer's
+// last seconds are cued from 02/002 and 02/003
+static int media_new(void) {
+    sim_df_card(20, 2, card_c);
+    if (boot()) return fail(0, 0, "boot failed");
+    t_ms += 300;
+    sim_run_until(t_ms);
+    if (media_status() != MEDIA_SCANNED) return fail(0, 0, "new card not counted");
+    if (media_queries(1, 1, 2)) return 1;
+
+    uint16_t from = sim_df_count();
+    uint32_t end = media_alarm(12);
+    if (media_cues(from, end, 1)) return 1;
+    if (df_sent(from, DF_CMD_REPEAT) != 1) return fail(0, 0, "cues not sent as one-shots");
+    t_ms += ALARM_ESCALATE_MS;
+    sim_run_until(t_ms);
+    if (app_state() != ST_ALARM || last_folder_file() != 0x0201) return fail(0, 0, "escalation not played from 02/001");
+    tap(BTN_M);
+
+    // Too short for the warning; the first tick after the alarm's loop
+    // turns the repeat off first, once
+    from = sim_df_count();
+    end = media_alarm(5);
+    if (media_cues(from, end, 0)) return 1;
+    uint16_t tick = df_find(from, DF_CMD_FOLDER, 0x0203);
+    const SimDfCommand *off = sim_df_get(tick - 1);
+    if (tick == from || off->cmd != DF_CMD_REPEAT || off->param != 1 || df_find(from, DF_CMD_REPEAT, 1) != tick - 1) {
+        return fail(0, 0, "repeat not turned off before a one-shot");
+    }
+    tap(BTN_M);
+
+    DF_Stats st;
+    DF_GetStats(&st);
+    if (st.failed || st.timeouts || st.rx_bad || sim_df_bad_frames()) return fail(0, 0, "DFPlayer protocol errors");
+    return 0;
+}
+
+static int media(void) {
+    if (power_cycle(media_first)) return 1;
+    if (power_cycle(media_known)) return 1;
+    if (power_cycle(media_warm)) return 1;
+    if (power_cycle(media_swapped)) return 1;
+    if (power_cycle(media_new)) return 1;
+    printf("media: OK, %u byte catalogue at 0x%03X\n", EE_MEDIA_SIZE, EE_MEDIA_ADDR);
+    return 0;
+}
+
+// Real time behind a pseudo-terminal: bytes written to the pty reach the
+// firmware's RX, replies come back out. Stops when stdin closes.
+static int serve(void) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master)) {
+        perror("pty");
+        return 2;
+    }
+    const char *name = ptsname(master);
+
+    // Raw line (the protocol is binary); holding the slave open keeps the
+    // master readable between clients
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    if (slave < 0 || tcgetattr(slave, &tio)) {
+        perror(name);
+        return 2;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    if (boot()) return fail(0, 0, "boot failed");
+    printf("PTY %s\n", name);
+    fflush(stdout);
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    uint32_t base = sim_time_ms();
+    uint8_t buf[256];
+    for (;;) {
+        struct pollfd pfd[2] = { { master, POLLIN, 0 }, { STDIN_FILENO, POLLIN, 0 } };
+        poll(pfd, 2, 5);
+        if (pfd[0].revents & POLLIN) {
+            ssize_t n = read(master, buf, sizeof(buf));
+            if (n > 0) sim_uart_host_rx(buf, (uint16_t)n);
+        }
+        if (pfd[1].revents & (POLLIN | POLLHUP)) {
+            if (read(STDIN_FILENO, buf, sizeof(buf)) <= 0) break;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        uint32_t ms = (uint32_t)((t1.tv_sec - t0.tv_sec) * 1000 + (t1.tv_nsec - t0.tv_nsec) / 1000000);
+        sim_run_until(base + ms);
+
+        uint16_t out = sim_uart_host_tx(buf, sizeof(buf));
+        if (out && write(master, buf, out) != out) break;
+    }
+    close(slave);
+    close(master);
+    return 0;
+}
+
+static int run_one(const char *arg) {
+    unsigned m, s;
+    if (sscanf(arg, "%u:%u", &m, &s) != 2 || m > 99 || s > 59 || (m == 0 && s == 0)) {
+        fprintf(stderr, "time must be MM:SS between 00:01 and 99:59\n");
+        return 2;
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    sim_trace = 1;
+    int r = run_case((uint8_t)m, (uint8_t)s);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double secs = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%s: %lu ms simulated in %.3f s\n", r ? "FAIL" : "OK", (unsigned long)sim_time_ms(), secs);
+    return r;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && !strcmp(argv[1], "run")) return run_one(argv[2]);
+    if (argc == 2 && !strcmp(argv[1], "sweep")) return sweep();
+    if (argc == 2 && !strcmp(argv[1], "stopwatch")) return stopwatch();
+    if (argc == 2 && !strcmp(argv[1], "channels")) return channels();
+    if (argc == 2 && !strcmp(argv[1], "presets")) return presets();
+    if (argc == 2 && !strcmp(argv[1], "recover")) return recover();
+    if (argc == 2 && !strcmp(argv[1], "trace")) return trace_check();
+    if (argc == 2 && !strcmp(argv[1], "glyphs")) return glyphs();
+    if (argc == 2 && !strcmp(argv[1], "display")) return display();
+    if (argc == 2 && !strcmp(argv[1], "host")) return host_check();
+    if (argc == 2 && !strcmp(argv[1], "media")) return media();
+    if (argc == 2 && !strcmp(argv[1], "serve")) return serve();
+
+    fprintf(stderr, "usage: %s run MM:SS | sweep | stopwatch | channels | presets | recover | trace | glyphs | display | host | media | serve\n", argv[0]);
+    return 2;
+}
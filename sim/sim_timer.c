@@ -0,0 +1,92 @@
+// Virtual-clock implementation of timer.h for the host simulator
+#include "timer.h"
+#include "sim.h"
+
+static uint64_t now_us = 0;
+static uint32_t deadline[TIMER_SLOT_COUNT];
+static uint8_t deadline_active = 0;
+static uint8_t wake_now = 0;
+
+// sim_timer_slip(): time the next arm takes
+static uint32_t slip_at_ms = 0;
+static uint16_t slip_us = 0;
+static uint32_t slipped_ms = 0;
+
+void sim_timer_set_us(uint64_t us) {
+    now_us = us;
+}
+
+void timer_set_rate(uint16_t ticks_per_ms_q8) {
+    (void)ticks_per_ms_q8; // The virtual clock is exact
+}
+
+void timer_init(void) {
+}
+
+uint32_t millis(void) {
+    return (uint32_t)(now_us / 1000);
+}
+
+uint32_t micros(void) {
+    return (uint32_t)now_us;
+}
+
+// As arm_compare() in timer.c: a deadline due by the time it is armed
+// can't be left to the compare unit
+static void arm(void) {
+    if (slip_us && millis() >= slip_at_ms) {
+        sim_advance_us(slip_us);
+        slip_us = 0;
+        slipped_ms = millis();
+    }
+
+    uint32_t now = millis();
+    wake_now = 0;
+    for (uint8_t i = 0; i < TIMER_SLOT_COUNT; i++) {
+        if ((deadline_active & (1 << i)) && (int32_t)(deadline[i] - now) <= 0) wake_now = 1;
+    }
+}
+
+void timer_set_deadline(uint8_t slot, uint32_t when) {
+    deadline[slot] = when;
+    deadline_active |= (1 << slot);
+    arm();
+}
+
+void timer_clear_deadline(uint8_t slot) {
+    deadline_active &= ~(1 << slot);
+    arm();
+}
+
+uint8_t timer_take_wake(void) {
+    uint8_t w = wake_now;
+    wake_now = 0;
+    return w;
+}
+
+void sim_timer_slip(uint32_t at_ms, uint16_t us) {
+    slip_at_ms = at_ms;
+    slip_us = us;
+    slipped_ms = 0;
+}
+
+uint32_t sim_timer_slipped(void) {
+    return slipped_ms;
+}
+
+// Same rule as the compare unit on hardware: only future deadlines wake
+uint8_t sim_timer_next_deadline(uint32_t *when_ms) {
+    uint32_t now = millis();
+    uint8_t have = 0;
+
+    for (uint8_t i = 0; i < TIMER_SLOT_COUNT; i++) {
+        if (!(deadline_active & (1 << i))) continue;
+        int32_t delta = (int32_t)(deadline[i] - now);
+        if (delta <= 0) continue;
+        if (!have || (int32_t)(deadline[i] - *when_ms) < 0) {
+            *when_ms = deadline[i];
+            have = 1;
+        }
+    }
+    return have;
+}
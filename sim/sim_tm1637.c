@@ -0,0 +1,150 @@
+// Fake TM1637 for the host simulator. The real driver (src/tm1637.c)
+// clocks its transfers out of the Timer2 interrupt; this is the chip on
+// the other end of CLK/DIO: it follows every pin write (io_map.h), takes
+// the bytes in on rising CLK, pulls DIO low for the ACK, and keeps the
+// display RAM that is decoded back into text.
+#include "glyphs.h"
+#include "io_map.h"
+#include "sim.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static uint8_t ram[4];       // Display RAM (addresses 4 and 5 are not wired)
+static uint8_t shown[4];     // RAM when the last transfer ended
+static uint8_t shown_valid = 0;
+static uint8_t display_on = 0;
+static uint8_t brightness = 0;
+static char text[6] = "    ";
+static uint32_t frames = 0;
+static uint32_t bytes = 0;
+static uint16_t nak = 0;     // Bytes left to not acknowledge
+
+// --- BUS ---
+static uint8_t clk = 1, dio = 1; // Line levels last seen (pulled up when floating)
+static uint8_t in_xfer = 0;  // Between start and stop condition
+static uint8_t bits;         // Data bits clocked in
+static uint8_t shift;
+static uint8_t ack;          // 1: DIO held low for the ACK, 2: ninth clock high
+static uint8_t ack_low = 0;
+static uint8_t count;        // Bytes in this transaction
+static uint8_t cmd;          // Its first byte
+static uint8_t addr;
+static uint8_t auto_inc = 1;
+
+// Digits first: 'O' and 'S' come out as '0' and '5'
+static const char glyph_chars[] = "0123456789 -_=AbCcdEFGHhIJLnoPqrtUuy";
+
+static char decode(uint8_t seg) {
+    seg &= 0x7F;
+    for (const char *c = glyph_chars; *c; c++) {
+        if (GLYPH(*c) == seg) return *c;
+    }
+    return '?';
+}
+
+static uint8_t line(uint8_t bit) {
+    return !(DDRB & bit) || (PORTB & bit);
+}
+
+static void take(uint8_t b) {
+    bytes++;
+    if (count++ == 0) {
+        cmd = b;
+        switch (b & 0xC0) {
+            case 0x40: auto_inc = !(b & 0x04); break;        // Data command
+            case 0xC0: addr = b & 0x07; break;               // Address, data follows
+            case 0x80:                                       // Display control
+                display_on = (b & 0x08) != 0;
+                if (display_on) brightness = b & 0x07;
+                break;
+        }
+        return;
+    }
+    if ((cmd & 0xC0) != 0xC0) return;
+    if (addr < 4) ram[addr] = b;
+    if (auto_inc) addr++;
+}
+
+void sim_pin_written(void) {
+    uint8_t c = line(disp_clk_bit);
+    uint8_t d = line(disp_dio_bit) && !ack_low;
+
+    if (clk && c) {
+        if (dio && !d) {                 // Start
+            in_xfer = 1;
+            bits = 0;
+            count = 0;
+            ack = 0;
+        } else if (!dio && d) {          // Stop
+            in_xfer = 0;
+        }
+    } else if (!clk && c && in_xfer) {   // Rising: sample
+        if (ack == 1) {
+            ack = 2;
+        } else if (!ack && bits < 8) {
+            shift = (uint8_t)(shift >> 1 | (d ? 0x80 : 0)); // LSB first
+            bits++;
+        }
+    } else if (clk && !c && in_xfer) {   // Falling: ACK after the 8th, release after the 9th
+        if (ack == 2) {
+            ack = 0;
+            ack_low = 0;
+            bits = 0;
+        } else if (!ack && bits == 8) {
+            take(shift);
+            ack = 1;
+            if (nak) nak--;
+            else     ack_low = 1;
+        }
+    }
+
+    clk = c;
+    dio = line(disp_dio_bit) && !ack_low;
+    PINB = (uint8_t)((PINB & ~(disp_clk_bit | disp_dio_bit)) |
+                     (clk ? disp_clk_bit : 0) | (dio ? disp_dio_bit : 0));
+}
+
+// A transfer has ended (Timer2 interrupt off): one frame if the RAM changed
+void sim_tm1637_idle(void) {
+    if (shown_valid && !memcmp(shown, ram, sizeof(ram))) return;
+    memcpy(shown, ram, sizeof(ram));
+    shown_valid = 1;
+    frames++;
+
+    // "12:34", or "12 34" with the colon (segment 0x80 of digit 1) off
+    text[0] = decode(ram[0]);
+    text[1] = decode(ram[1]);
+    text[2] = (ram[1] & 0x80) ? ':' : ' ';
+    text[3] = decode(ram[2]);
+    text[4] = decode(ram[3]);
+    text[5] = 0;
+
+    if (sim_trace) {
+        printf("%10lu ms  DISP [%s]\n", (unsigned long)sim_time_ms(), text);
+    }
+}
+
+const char *sim_display_text(void) {
+    return text;
+}
+
+uint32_t sim_display_frames(void) {
+    return frames;
+}
+
+uint8_t sim_display_on(void) {
+    return display_on;
+}
+
+uint8_t sim_display_brightness(void) {
+    return brightness;
+}
+
+uint32_t sim_display_bytes(void) {
+    return bytes;
+}
+
+void sim_display_nak(uint16_t n) {
+    nak = n;
+}
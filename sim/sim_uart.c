@@ -0,0 +1,228 @@
+// UART for the host simulator: bytes go straight into a fake DFPlayer
+// that checks and decodes the 10-byte command frames. Its status frames
+// come back through a small RX buffer. Text between frames (the trace
+// dump, which the real module ignores) is kept for the harness, and so
+// are host protocol replies (host.h).
+#include "uart.h"
+#include "dfplayer.h"
+#include "host.h"
+#include "sim.h"
+
+#include <stdio.h>
+
+#define SIM_DF_LOG    256
+
+// Fake module timing
+#define SIM_DF_ACK_MS    12  // Command -> ACK
+#define SIM_DF_REBOOT_MS 800 // Reset -> online frame
+#define SIM_DF_REPLY_MS  20  // Query -> answer (after the ACK)
+
+static uint8_t frame[DF_FRAME_SIZE];
+static uint8_t frame_len = 0;
+
+static uint8_t rx_buf[64];
+static uint8_t rx_head = 0;
+static uint8_t rx_tail = 0;
+
+static SimDfCommand df_log[SIM_DF_LOG];
+static uint16_t df_count = 0;
+static uint16_t df_bad = 0;
+static uint16_t acks_to_drop = 0;
+
+// SD card (sim_df_card()); without one queries are only ACKed
+static uint8_t card = 0;
+static uint16_t card_files;
+static uint8_t card_folders;
+static uint8_t card_count[16];
+
+static char text[4096];
+static uint16_t text_len = 0;
+
+static UART_RxHook rx_hook = 0;
+static uint8_t host_out[1024];    // Replies not collected yet
+static uint16_t host_out_len = 0;
+static uint8_t host_pos = 0;      // Position in the reply going out
+static uint8_t host_total = 0;
+
+// Queries are answered, and a folder file that isn't there is an error
+static void card_answer(const SimDfCommand *c) {
+    uint32_t at = c->time_ms + SIM_DF_REPLY_MS;
+    uint8_t folder = (uint8_t)(c->param >> 8);
+    switch (c->cmd) {
+        case DF_QUERY_SD_FILES:
+            sim_df_reply(at, c->cmd, card_files);
+            break;
+        case DF_QUERY_FOLDERS:
+            sim_df_reply(at, c->cmd, card_folders);
+            break;
+        case DF_QUERY_FOLDER_FILES:
+            if (c->param >= 1 && c->param <= card_folders) sim_df_reply(at, c->cmd, card_count[c->param - 1]);
+            else sim_df_reply(at, DF_EVT_ERROR, DF_ERR_NOT_FOUND);
+            break;
+        case DF_CMD_FOLDER:
+            if (folder < 1 || folder > card_folders || (uint8_t)c->param > card_count[folder - 1]) {
+                sim_df_reply(at, DF_EVT_ERROR, DF_ERR_NOT_FOUND);
+            }
+            break;
+    }
+}
+
+void sim_df_card(uint16_t files, uint8_t folders, const uint8_t *counts) {
+    card = 1;
+    card_files = files;
+    card_folders = folders < sizeof(card_count) ? folders : sizeof(card_count);
+    for (uint8_t i = 0; i < card_folders; i++) card_count[i] = counts[i];
+}
+
+static void df_frame(void) {
+    uint16_t sum = 0;
+    for (uint8_t i = 1; i <= 6; i++) sum += frame[i];
+    uint16_t checksum = (uint16_t)((frame[7] << 8) | frame[8]);
+
+    if (frame[1] != 0xFF || frame[2] != 0x06 || frame[9] != 0xEF ||
+        (uint16_t)(sum + checksum) != 0) {
+        df_bad++;
+        return;
+    }
+
+    SimDfCommand c;
+    c.time_ms = sim_time_ms();
+    c.cmd = frame[3];
+    c.param = (uint16_t)((frame[5] << 8) | frame[6]);
+    if (df_count < SIM_DF_LOG) df_log[df_count++] = c;
+
+    if (sim_trace) {
+        printf("%10lu ms  DF  cmd=0x%02X param=%u\n", (unsigned long)c.time_ms, c.cmd, c.param);
+    }
+
+    // Answer like the module: reset reboots, everything else is ACKed if asked
+    if (c.cmd == DF_CMD_RESET) {
+        sim_df_reply(c.time_ms + SIM_DF_REBOOT_MS, DF_EVT_ONLINE, 0x02);
+    } else if (frame[4] & 0x01) {
+        if (acks_to_drop) acks_to_drop--;
+        else sim_df_reply(c.time_ms + SIM_DF_ACK_MS, DF_EVT_ACK, 0);
+    }
+    if (card) card_answer(&c);
+}
+
+void sim_df_drop_acks(uint16_t n) {
+    acks_to_drop = n;
+}
+
+// A byte of a host reply? Those never start inside a module frame
+static uint8_t host_byte(uint8_t b) {
+    if (host_pos == 0) {
+        if (frame_len || b != HOST_START_BYTE) return 0;
+        host_total = 2; // Until the length is known
+    }
+    if (host_pos == 1) host_total = (uint8_t)(b + HOST_OVERHEAD);
+    if (host_out_len < sizeof(host_out)) host_out[host_out_len++] = b;
+    if (++host_pos == host_total) host_pos = 0;
+    return 1;
+}
+
+static void df_byte(uint8_t b) {
+    if (host_byte(b)) return;
+
+    // Resync on the start byte
+    if (frame_len == 0 && b != 0x7E) {
+        if ((b == '\n' || (b >= ' ' && b < 0x7E)) && text_len < sizeof(text) - 1) {
+            text[text_len++] = (char)b;
+            return;
+        }
+        df_bad++;
+        return;
+    }
+    frame[frame_len++] = b;
+    if (frame_len == DF_FRAME_SIZE) {
+        df_frame();
+        frame_len = 0;
+    }
+}
+
+void UART_Init(uint8_t ubrr) {
+    (void)ubrr;
+}
+
+void UART_Tx(uint8_t data) {
+    df_byte(data);
+}
+
+uint8_t UART_Write(const uint8_t *data, uint8_t len) {
+    for (uint8_t i = 0; i < len; i++) df_byte(data[i]);
+    return len;
+}
+
+uint8_t UART_TxFree(void) {
+    return UART_TX_BUF_SIZE - 1;
+}
+
+uint8_t UART_TxIdle(void) {
+    return 1;
+}
+
+uint8_t UART_Read(uint8_t *data) {
+    if (rx_tail == rx_head) return 0;
+    *data = rx_buf[rx_tail];
+    rx_tail = (rx_tail + 1) % sizeof(rx_buf);
+    return 1;
+}
+
+uint8_t UART_RxOverruns(void) {
+    return 0;
+}
+
+void UART_SetRxHook(UART_RxHook hook) {
+    rx_hook = hook;
+}
+
+void sim_uart_host_rx(const uint8_t *data, uint16_t len) {
+    // As the RX interrupt would, one byte at a time
+    for (uint16_t i = 0; i < len; i++) {
+        if (rx_hook && rx_hook(data[i])) continue;
+        rx_buf[rx_head] = data[i];
+        rx_head = (rx_head + 1) % sizeof(rx_buf);
+    }
+}
+
+uint16_t sim_uart_host_tx(uint8_t *buf, uint16_t max) {
+    uint16_t n = (host_out_len < max) ? host_out_len : max;
+    for (uint16_t i = 0; i < n; i++) buf[i] = host_out[i];
+    for (uint16_t i = n; i < host_out_len; i++) host_out[i - n] = host_out[i];
+    host_out_len = (uint16_t)(host_out_len - n);
+    return n;
+}
+
+void sim_uart_rx_frame(uint8_t cmd, uint16_t param) {
+    uint8_t f[DF_FRAME_SIZE] = { 0x7E, 0xFF, 0x06, cmd, 0x00, (uint8_t)(param >> 8), (uint8_t)param, 0, 0, 0xEF };
+    uint16_t sum = 0;
+    for (uint8_t i = 1; i <= 6; i++) sum += f[i];
+    sum = 0 - sum;
+    f[7] = (uint8_t)(sum >> 8);
+    f[8] = (uint8_t)sum;
+
+    if (sim_trace) {
+        printf("%10lu ms  DF< cmd=0x%02X param=%u\n", (unsigned long)sim_time_ms(), cmd, param);
+    }
+    for (uint8_t i = 0; i < DF_FRAME_SIZE; i++) {
+        rx_buf[rx_head] = f[i];
+        rx_head = (rx_head + 1) % sizeof(rx_buf);
+    }
+}
+
+uint16_t sim_df_count(void) {
+    return df_count;
+}
+
+const SimDfCommand *sim_df_get(uint16_t i) {
+    return (i < df_count) ? &df_log[i] : 0;
+}
+
+const char *sim_uart_text(void) {
+    text[text_len] = 0;
+    return text;
+}
+
+uint16_t sim_df_bad_frames(void) {
+    return df_bad;
+}
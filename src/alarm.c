@@ -0,0 +1,76 @@
+#include "alarm.h"
+#include "dfplayer.h"
+#include "media.h"
+#include <avr/pgmspace.h>
+
+// Default ramp: soft start, full volume after 20 s
+static const AlarmStep default_curve[] PROGMEM = {
+    {     0,  8 },
+    {  3000, 12 },
+    {  6000, 16 },
+    { 10000, 20 },
+    { 15000, 25 },
+    { 20000, 30 },
+};
+
+static const AlarmStep *curve = default_curve;
+static uint8_t curve_len = sizeof(default_curve) / sizeof(default_curve[0]);
+
+static uint8_t active = 0;
+static uint8_t escalated = 0;
+static uint8_t step = 0; // Next curve point to apply
+static uint32_t start_time;
+
+void alarm_set_curve(const AlarmStep *curve_P, uint8_t len) {
+    curve = curve_P;
+    curve_len = len;
+}
+
+static uint16_t step_time(uint8_t i) {
+    return pgm_read_word(&curve[i].at_ms);
+}
+
+void alarm_start(uint32_t now, MediaSound sound) {
+    active = 1;
+    escalated = 0;
+    start_time = now;
+
+    // Volume before the sound so it never starts loud
+    DF_SetVolume(pgm_read_byte(&curve[0].volume));
+    media_loop(sound);
+    step = 1;
+}
+
+void alarm_stop(void) {
+    if (!active) return;
+    active = 0;
+    DF_Pause(); // Stop Sound Immediately
+}
+
+uint8_t alarm_active(void) {
+    return active;
+}
+
+uint8_t alarm_update(uint32_t now, uint32_t *next) {
+    if (!active || escalated) return 0;
+
+    uint32_t elapsed = now - start_time;
+
+    if (elapsed >= ALARM_ESCALATE_MS) {
+        escalated = 1;
+        DF_SetVolume(ALARM_ESCALATE_VOL);
+        media_loop(SND_ESCALATE);
+        return 0; // Loops until stopped, nothing left to schedule
+    }
+
+    // Apply every ramp point that is due (only the newest volume reaches
+    // the module, DF_SetVolume() coalesces)
+    while (step < curve_len && elapsed >= step_time(step)) {
+        DF_SetVolume(pgm_read_byte(&curve[step].volume));
+        step++;
+    }
+
+    *next = start_time + ALARM_ESCALATE_MS;
+    if (step < curve_len) *next = start_time + step_time(step);
+    return 1;
+}
@@ -0,0 +1,35 @@
+#ifndef ALARM_H
+#define ALARM_H
+
+#include <stdint.h>
+#include "media.h"
+
+// Alarm sound engine on top of the DFPlayer queue.
+// Loops the alarm sound, ramps the volume up along a curve and switches
+// to SND_ESCALATE if nobody has reacted after ALARM_ESCALATE_MS.
+// Nothing blocks: alarm_update() says when it next needs to run.
+
+// --- CONFIGURATION ---
+#define ALARM_ESCALATE_MS    30000UL // Unanswered this long -> escalation sound
+#define ALARM_ESCALATE_VOL   30      // Straight to full volume
+
+// One point of the volume ramp: from 'at_ms' after the start, 'volume'
+typedef struct {
+    uint16_t at_ms;
+    uint8_t  volume; // 0-30
+} AlarmStep;
+
+// Ramp to use from the next alarm_start() on (PROGMEM table, ascending
+// 'at_ms', first entry at 0)
+void alarm_set_curve(const AlarmStep *curve_P, uint8_t len);
+
+void alarm_start(uint32_t now, MediaSound sound); // Loops 'sound' until stopped
+void alarm_stop(void);
+uint8_t alarm_active(void);
+
+// Advance the ramp/escalation. Returns 1 with the time of the next step
+// in *next, or 0 when there is nothing more to schedule (stopped, or
+// escalated and looping until stopped).
+uint8_t alarm_update(uint32_t now, uint32_t *next);
+
+#endif
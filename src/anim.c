@@ -0,0 +1,91 @@
+#include "anim.h"
+#include "tm1637.h"
+
+// --- ANIMATIONS ---
+// Alarm: "End" scrolls in from the right, then pulses bright/dim until
+// dismissed (the loop starts at the first full " End")
+ANIM_DEFINE(anim_alarm, 3,
+    ANIM_TEXT(' ', ' ', ' ', ' ', 7, 120),
+    ANIM_TEXT(' ', ' ', ' ', 'E', 7, 120),
+    ANIM_TEXT(' ', ' ', 'E', 'n', 7, 120),
+    ANIM_TEXT(' ', 'E', 'n', 'd', 7, 200),
+    ANIM_TEXT(' ', 'E', 'n', 'd', 5, 80),
+    ANIM_TEXT(' ', 'E', 'n', 'd', 3, 80),
+    ANIM_TEXT(' ', 'E', 'n', 'd', 1, 120),
+    ANIM_TEXT(' ', 'E', 'n', 'd', 3, 80),
+    ANIM_TEXT(' ', 'E', 'n', 'd', 5, 80));
+
+ANIM_DEFINE(anim_set, ANIM_ONCE,
+    ANIM_TEXT('S', 'E', 't', ' ', ANIM_KEEP, 600));
+
+ANIM_DEFINE(anim_spinner, 0,
+    ANIM_SPIN(0, 60), ANIM_SPIN(1, 60), ANIM_SPIN(2, 60),  ANIM_SPIN(3, 60),
+    ANIM_SPIN(4, 60), ANIM_SPIN(5, 60), ANIM_SPIN(6, 60),  ANIM_SPIN(7, 60),
+    ANIM_SPIN(8, 60), ANIM_SPIN(9, 60), ANIM_SPIN(10, 60), ANIM_SPIN(11, 60));
+
+// --- PLAYER ---
+static const Anim *playing = 0;     // 0 = nothing
+static const AnimFrame *frames;
+static uint8_t count;
+static uint8_t loop;
+static uint8_t frame;
+static uint32_t frame_end;          // When the current frame is over
+static uint8_t base_bright;         // Brightness to go back to
+static uint8_t bright;              // Brightness the display is at
+
+void anim_play(const Anim *a, uint32_t now) {
+    if (!playing) {
+        base_bright = tm1637_get_brightness();
+        bright = base_bright;
+    }
+    playing = a;
+    frames = (const AnimFrame *)pgm_read_ptr(&a->frames);
+    count = pgm_read_byte(&a->count);
+    loop = pgm_read_byte(&a->loop);
+    frame = 0;
+    frame_end = now + pgm_read_word(&frames[0].ms);
+}
+
+void anim_stop(void) {
+    if (!playing) return;
+    playing = 0;
+    if (bright != base_bright) tm1637_set_brightness(base_bright);
+}
+
+uint8_t anim_active(void) {
+    return playing != 0;
+}
+
+uint8_t anim_playing(const Anim *a) {
+    return playing == a;
+}
+
+uint32_t anim_update(uint32_t now) {
+    if (!playing) return 0;
+
+    // Frames whose time is up are skipped, not replayed late
+    while ((int32_t)(now - frame_end) >= 0) {
+        if (++frame >= count) {
+            if (loop == ANIM_ONCE) {
+                anim_stop();
+                return 0;
+            }
+            frame = loop;
+        }
+        frame_end += pgm_read_word(&frames[frame].ms);
+    }
+
+    const AnimFrame *f = &frames[frame];
+    uint8_t b = pgm_read_byte(&f->bright);
+    if (b != ANIM_KEEP && b != bright) {
+        bright = b;
+        tm1637_set_brightness(b);
+    }
+    anim_text(f->seg);
+    return frame_end - now;
+}
+
+void anim_text(const uint8_t *seg) {
+    tm1637_display_segments(pgm_read_byte(&seg[0]), pgm_read_byte(&seg[1]),
+                            pgm_read_byte(&seg[2]), pgm_read_byte(&seg[3]));
+}
@@ -0,0 +1,70 @@
+#ifndef ANIM_H
+#define ANIM_H
+
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+#include "glyphs.h"
+
+// Keyframe animations for the display. Every frame is stored ready to send
+// (four segment bytes, a brightness, a duration), built by the compiler from
+// glyphs.h, so playing one is a walk down a flash table: nothing is drawn or
+// computed per frame. The display task calls anim_update() instead of
+// drawing its view while one is playing; frames only post to the TM1637
+// mailbox, so input is never held up.
+
+#define ANIM_KEEP 0xFF // Frame brightness: leave it as it is
+#define ANIM_ONCE 0xFF // Loop point: play once, then back to the view
+
+typedef struct {
+    uint8_t seg[4];
+    uint8_t bright; // 0-7, or ANIM_KEEP
+    uint16_t ms;    // How long the frame stays (> 0)
+} AnimFrame;
+
+typedef struct {
+    const AnimFrame *frames; // In flash
+    uint8_t count;
+    uint8_t loop; // Frame to go back to after the last one, or ANIM_ONCE
+} Anim;
+
+// Frame builders (all constant expressions)
+// Four characters
+#define ANIM_TEXT(a, b, c, d, bright, ms) { GLYPH4(a, b, c, d), bright, ms }
+
+// One lit segment going round the outside of the display, position 0-11:
+// along the tops left to right, down the right digit, back along the
+// bottoms, up the left digit
+#define ANIM_SPIN_SEG(k, d)                                  \
+    ((k) < 4   ? ((d) == (k)     ? 0x01 : 0) :               \
+     (k) == 4  ? ((d) == 3       ? 0x02 : 0) :               \
+     (k) == 5  ? ((d) == 3       ? 0x04 : 0) :               \
+     (k) < 10  ? ((d) == 9 - (k) ? 0x08 : 0) :               \
+     (k) == 10 ? ((d) == 0       ? 0x10 : 0) :               \
+                 ((d) == 0       ? 0x20 : 0))
+#define ANIM_SPIN(k, ms) \
+    { { ANIM_SPIN_SEG(k, 0), ANIM_SPIN_SEG(k, 1), ANIM_SPIN_SEG(k, 2), ANIM_SPIN_SEG(k, 3) }, ANIM_KEEP, ms }
+
+#define ANIM_DEFINE(name, loop, ...)                                   \
+    static const AnimFrame name##_frames[] PROGMEM = { __VA_ARGS__ };   \
+    const Anim name PROGMEM = { name##_frames, sizeof(name##_frames) / sizeof(AnimFrame), loop }
+
+// Built in (anim.c)
+extern const Anim anim_alarm PROGMEM;   // "End" scrolls in, then pulses
+extern const Anim anim_set PROGMEM;     // "SEt" on entering the settings
+extern const Anim anim_spinner PROGMEM; // Something is going on (trace dump)
+
+// Start 'a' (in flash) from its first frame, replacing whatever was playing
+void anim_play(const Anim *a, uint32_t now);
+// Stop and put the brightness back as it was before the animation
+void anim_stop(void);
+uint8_t anim_active(void);
+uint8_t anim_playing(const Anim *a);
+// Show the frame due at 'now'; returns the ms until the next one, 0 once
+// a one-shot animation has ended (or none is playing)
+uint32_t anim_update(uint32_t now);
+
+// Show four segment bytes from flash (GLYPH4() text)
+void anim_text(const uint8_t *seg);
+
+#endif
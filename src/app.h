@@ -0,0 +1,15 @@
+#ifndef APP_H
+#define APP_H
+
+#include <stdint.h>
+
+// Application entry points, split out of main() so the host simulator
+// (env:native) can drive the same loop against a virtual clock.
+
+void app_init(uint8_t reset_cause); // MCUSR as found at boot
+void app_poll(void);     // One pass of the main loop (ends in power_sleep())
+uint8_t app_state(void); // Current TimerState
+uint8_t app_channel(void);       // Selected timer channel
+uint8_t app_channel_bytes(void); // SRAM cost of one timer channel
+
+#endif
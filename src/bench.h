@@ -0,0 +1,53 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Benchmark probes for the simavr runner (env:bench, see bench/runner.c).
+// A probe is a single OUT to a general purpose I/O register, so it costs
+// one cycle plus loading the constant and leaves no trace on the bus:
+//   GPIOR0 = 0x80 | id   entry
+//   GPIOR0 = id          exit
+//   GPIOR1 = state       TimerState of the loop pass that follows
+// In the firmware proper the same probes feed the Timer1 counters of the
+// field trace (trace.h) instead; in the host simulator they compile to
+// nothing (the runner includes this file on the host for the IDs only).
+
+#define BENCH_LOOP        1 // app_poll() up to power_sleep()
+#define BENCH_DISPLAY     2 // refresh_display()
+#define BENCH_BUTTONS     3 // buttons_get_event()
+#define BENCH_SEND_STACK  4 // send_stack()
+#define BENCH_DISP_ISR    5 // TIMER2_COMPA_vect (tm1637.c), one bus step
+
+// bench/pins.c (pin access micro-benchmark) only
+#define BENCH_PINS_TM_OLD  8 // TM1637 byte + ACK, old read-modify-write macros
+#define BENCH_PINS_TM_NEW  9 // The same through the io_map.h accessors
+#define BENCH_PINS_BTN_OLD 10 // buttons_read(), baseline polled version
+#define BENCH_PINS_BTN_NEW 11 // buttons_read() of src/buttons.c
+
+#ifdef DAMKA_BENCH
+#include <avr/io.h>
+
+#define BENCH_ENTER(id) (GPIOR0 = (uint8_t)(0x80 | (id)))
+#define BENCH_EXIT(id)  (GPIOR0 = (uint8_t)(id))
+#define BENCH_STATE(s)  (GPIOR1 = (uint8_t)(s))
+#define BENCH_ISR_ENTER(id) BENCH_ENTER(id)
+#define BENCH_ISR_EXIT(id)  BENCH_EXIT(id)
+#elif defined(__AVR__)
+#include "trace.h"
+
+#define BENCH_ENTER(id) trace_prof_enter(id)
+#define BENCH_EXIT(id)  trace_prof_exit(id)
+#define BENCH_STATE(s)  ((void)0)
+#else
+#define BENCH_ENTER(id) ((void)0)
+#define BENCH_EXIT(id)  ((void)0)
+#define BENCH_STATE(s)  ((void)0)
+#endif
+
+// Probes inside interrupts only exist in the bench image: the trace's
+// 8 us Timer1 ticks are as long as the whole interrupt
+#ifndef BENCH_ISR_ENTER
+#define BENCH_ISR_ENTER(id) ((void)0)
+#define BENCH_ISR_EXIT(id)  ((void)0)
+#endif
+
+#endif
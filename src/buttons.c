@@ -1,46 +1,167 @@
 #include "buttons.h"
 #include "io_map.h"
 #include "timer.h"
+#include "bench.h"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 
-static uint8_t last_port_state = 0xFF; 
-static uint32_t last_debounce_time = 0;
-#define DEBOUNCE_DELAY 50 
+// The interrupts below are the pin map's: INT0 is PD2, INT1 is PD3, and
+// port D pin n is PCINT16 + n, bit n of PCMSK2
+#if IO_PORT_ID(BTN_PORT) != IO_PORT_ID_D
+#error "buttons.c: the buttons' pin change interrupt is PCINT2, port D only"
+#endif
+#if PIN_BTN_L != 2 || PIN_BTN_M != 3
+#error "buttons.c: L and M have to be on INT0 (PD2) and INT1 (PD3)"
+#endif
+#if PIN_BTN_R == 2 || PIN_BTN_R == 3 || PIN_BTN_R > 7
+#error "buttons.c: R has to be another port D pin"
+#endif
+
+#define DEBOUNCE_DELAY 30 // Per button, ignore further edges this long (ms)
+#define QUEUE_MASK (BTN_QUEUE_SIZE - 1)
+
+// Debounced level of each pin (1 = released, Active LOW)
+static uint8_t stable_state = BTN_MASK;
+static uint32_t last_edge_time[4];
+
+// Resample armed for the end of a debounce window (TIMER_SLOT_DEBOUNCE)
+static uint8_t recheck_armed = 0;
+static uint32_t recheck_at;
+
+// --- EVENT QUEUE ---
+// Single producer (pin ISRs) / single consumer (main loop): each side only
+// writes its own index, so no locking is needed around push/pop.
+static ButtonEvent queue[BTN_QUEUE_SIZE];
+static volatile uint8_t q_head = 0;
+static volatile uint8_t q_tail = 0;
+static volatile uint8_t q_dropped = 0;
+
+// One button of a snapshot. Inlined once per button, so 'id' and 'bit'
+// are constants and no mask is looked up or shifted at run time.
+static inline void capture_one(uint8_t id, uint8_t bit, uint8_t pins, uint8_t diff, uint32_t now) {
+    if (!(diff & bit)) return;
+    if (now - last_edge_time[id] < DEBOUNCE_DELAY) return; // Still bouncing
+
+    last_edge_time[id] = now;
+    stable_state ^= bit;
+
+    uint8_t head = q_head;
+    uint8_t next = (head + 1) & QUEUE_MASK;
+    if (next == q_tail) {
+        if (q_dropped < 0xFF) q_dropped++;
+        return;
+    }
+    queue[head].id = id;
+    queue[head].edge = (pins & bit) ? BTN_RELEASE : BTN_PRESS;
+    queue[head].time = now;
+    q_head = next;
+}
+
+// A pin still differs from its debounced level: its edge came inside
+// the window and was dropped. Wake up when the window ends to sample it
+// again, or a short tap's release would wait for the next unrelated wake.
+static inline void recheck_one(uint8_t id, uint8_t bit, uint8_t left, uint8_t *have, uint32_t *at) {
+    if (!(left & bit)) return;
+    uint32_t t = last_edge_time[id] + DEBOUNCE_DELAY;
+    if (!*have || (int32_t)(t - *at) < 0) *at = t;
+    *have = 1;
+}
+
+// Compare a snapshot of the button port against the debounced state and
+// queue every accepted edge. Must run with interrupts disabled.
+static void capture(uint8_t pins, uint32_t now) {
+    uint8_t diff = (pins ^ stable_state) & BTN_MASK;
+    if (diff) {
+        capture_one(BTN_L, BTN_BIT(PIN_BTN_L), pins, diff, now);
+        capture_one(BTN_M, BTN_BIT(PIN_BTN_M), pins, diff, now);
+        capture_one(BTN_R, BTN_BIT(PIN_BTN_R), pins, diff, now);
+    }
+
+    uint8_t left = (pins ^ stable_state) & BTN_MASK;
+    uint8_t have = 0;
+    uint32_t at = 0;
+    recheck_one(BTN_L, BTN_BIT(PIN_BTN_L), left, &have, &at);
+    recheck_one(BTN_M, BTN_BIT(PIN_BTN_M), left, &have, &at);
+    recheck_one(BTN_R, BTN_BIT(PIN_BTN_R), left, &have, &at);
+
+    // Bounces within one window land on the same time: arm only on change
+    if (have && (!recheck_armed || at != recheck_at)) {
+        recheck_at = at;
+        recheck_armed = 1;
+        timer_set_deadline(TIMER_SLOT_DEBOUNCE, at);
+    } else if (!have && recheck_armed) {
+        recheck_armed = 0;
+        timer_clear_deadline(TIMER_SLOT_DEBOUNCE);
+    }
+}
+
+// L = INT0, M = INT1, R = PCINT2 (port D pin change)
+ISR(INT0_vect) {
+    capture(btn_port_read(), millis());
+}
+
+ISR(INT1_vect) {
+    capture(btn_port_read(), millis());
+}
+
+ISR(PCINT2_vect) {
+    capture(btn_port_read(), millis());
+}
 
 void buttons_init(void) {
     // Set as Input
-    BTN_DDR &= ~((1 << PIN_BTN_L) | (1 << PIN_BTN_M) | (1 << PIN_BTN_R));
+    btn_port_input();
     // Enable Internal Pull-ups
-    BTN_PORT |= (1 << PIN_BTN_L) | (1 << PIN_BTN_M) | (1 << PIN_BTN_R);
+    btn_port_pullup();
+
+    // INT0/INT1 on any logical change, a pin change for the right button
+    EICRA = (1 << ISC00) | (1 << ISC10);
+    EIFR = (1 << INTF0) | (1 << INTF1);
+    EIMSK = (1 << INT0) | (1 << INT1);
+
+    PCMSK2 = BTN_BIT(PIN_BTN_R);
+    PCIFR = (1 << PCIF2);
+    PCICR |= (1 << PCIE2);
 }
 
-ButtonID buttons_read(void) {
-    uint32_t now = millis();
-    if (now - last_debounce_time < DEBOUNCE_DELAY) return BTN_NONE;
-
-    // Read Logic: Active LOW (0 = Pressed)
-    uint8_t mask = (1 << PIN_BTN_L) | (1 << PIN_BTN_M) | (1 << PIN_BTN_R);
-    uint8_t current_state = BTN_PIN_REG & mask;
-    
-    ButtonID detected = BTN_NONE;
-
-    // Detect Falling Edge (Transition from 1 to 0)
-    // Check Left
-    if ((last_port_state & (1 << PIN_BTN_L)) && !(current_state & (1 << PIN_BTN_L))) {
-        detected = BTN_L;
-    }
-    // Check Middle
-    else if ((last_port_state & (1 << PIN_BTN_M)) && !(current_state & (1 << PIN_BTN_M))) {
-        detected = BTN_M;
+uint8_t buttons_get_event(ButtonEvent *ev) {
+    BENCH_ENTER(BENCH_BUTTONS);
+    // An edge that arrived during a button's debounce window was ignored;
+    // re-sample so the final level is not lost once the window is over
+    // (TIMER_SLOT_DEBOUNCE wakes the loop for this).
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        capture(btn_port_read(), millis());
     }
-    // Check Right
-    else if ((last_port_state & (1 << PIN_BTN_R)) && !(current_state & (1 << PIN_BTN_R))) {
-        detected = BTN_R;
+
+    uint8_t tail = q_tail;
+    uint8_t got = (tail != q_head);
+    if (got) {
+        *ev = queue[tail];
+        q_tail = (tail + 1) & QUEUE_MASK;
     }
+    BENCH_EXIT(BENCH_BUTTONS);
+    return got;
+}
 
-    if (current_state != last_port_state) {
-        last_debounce_time = now;
-        last_port_state = current_state;
+ButtonID buttons_read(void) {
+    ButtonEvent ev;
+    while (buttons_get_event(&ev)) {
+        if (ev.edge == BTN_PRESS) return (ButtonID)ev.id;
     }
+    return BTN_NONE;
+}
 
-    return detected;
-}
\ No newline at end of file
+uint8_t buttons_dropped(void) {
+    return q_dropped;
+}
+
+uint8_t buttons_pending(void) {
+    return q_head != q_tail;
+}
+
+void buttons_set_wake(uint8_t enable) {
+    // Awake, INT0/INT1 and PCINT would both report L/M; capture() ignores
+    // the duplicate because the debounced state already matches
+    if (enable) PCMSK2 |= BTN_BIT(PIN_BTN_L) | BTN_BIT(PIN_BTN_M);
+    else        PCMSK2 &= (uint8_t)~(BTN_BIT(PIN_BTN_L) | BTN_BIT(PIN_BTN_M));
+}
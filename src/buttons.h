@@ -11,7 +11,34 @@ typedef enum {
     BTN_R  // Right
 } ButtonID;
 
+typedef enum {
+    BTN_PRESS,
+    BTN_RELEASE
+} ButtonEdge;
+
+// One debounced edge, captured in the pin interrupt
+typedef struct {
+    uint8_t  id;   // ButtonID
+    uint8_t  edge; // ButtonEdge
+    uint32_t time; // millis() when the edge happened
+} ButtonEvent;
+
+// Event queue slots (power of 2; one slot is kept free)
+#define BTN_QUEUE_SIZE 16
+
 void buttons_init(void);
+
+// Pops the oldest press/release event. Returns 0 if there is none.
+uint8_t buttons_get_event(ButtonEvent *ev);
+
+// Convenience: next press (releases are discarded), BTN_NONE if none
 ButtonID buttons_read(void);
 
-#endif
\ No newline at end of file
+uint8_t buttons_dropped(void); // Events lost because the queue was full
+uint8_t buttons_pending(void); // Events waiting in the queue
+
+// Power-down support: also route L/M through pin change interrupts, which
+// (unlike INT0/INT1 edges) can wake the CPU without the I/O clock
+void buttons_set_wake(uint8_t enable);
+
+#endif
@@ -0,0 +1,207 @@
+#include "calib.h"
+#include "eeprom_map.h"
+#include "uart.h"
+#include "timer.h"
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <stddef.h>
+
+#define CALIB_MAGIC 0xC5
+
+// Target CPU clock and what that means for the timebase (Timer1 / 64)
+#define TARGET_HZ     8000000UL
+#define TPM_NOMINAL   (125U << 8)
+
+// While measuring, Timer1 counts CPU cycles (prescaler 1, overflow every
+// 8.2 ms) and Timer2 counts the crystal (overflow every 256 / 32768 s).
+// Windows are in Timer2 overflows: 'w' of them last w / 128 s.
+#define START_TIMEOUT_OVF 122 // ~1 s for the crystal to start oscillating (and
+                              // what the first boot costs without one)
+#define SETTLE_WINDOW     16  // Let the crystal amplitude settle (125 ms)
+#define TRIM_WINDOW       4   // 31 ms per OSCCAL step
+#define FINAL_WINDOW      32  // 250 ms for the final rate
+#define MAX_TRIM_STEPS    40
+#define CYCLES_PER_WINDOW (TARGET_HZ / 128)
+
+typedef struct {
+    uint8_t  magic;
+    uint8_t  source;  // CalibSource
+    uint8_t  osccal;
+    uint8_t  ubrr;
+    uint16_t tpm_q8;
+    uint8_t  check;   // XOR of the bytes before it
+} CalibRecord;
+
+static CalibRecord cal;
+
+static uint8_t record_check(const CalibRecord *r) {
+    const uint8_t *p = (const uint8_t *)r;
+    uint8_t x = 0;
+    for (uint8_t i = 0; i < offsetof(CalibRecord, check); i++) x ^= p[i];
+    return x;
+}
+
+// Wait for the next Timer2 overflow while counting Timer1 overflows.
+// Returns 0 if the crystal stopped (no Timer2 overflow for ~32 ms).
+static uint8_t wait_crystal(uint16_t *ovf1) {
+    uint8_t guard = 0;
+    while (!(TIFR2 & (1 << TOV2))) {
+        if (TIFR1 & (1 << TOV1)) {
+            TIFR1 = (1 << TOV1);
+            (*ovf1)++;
+            if (++guard > 4) return 0;
+        }
+    }
+    TIFR2 = (1 << TOV2);
+    return 1;
+}
+
+// CPU cycles over 'window' crystal periods, 0 on failure
+static uint32_t measure(uint8_t window) {
+    uint16_t ovf1 = 0;
+    if (!wait_crystal(&ovf1)) return 0; // Line up with an overflow
+
+    TCNT1 = 0;
+    TIFR1 = (1 << TOV1);
+    ovf1 = 0;
+    for (uint8_t i = 0; i < window; i++) {
+        if (!wait_crystal(&ovf1)) return 0;
+    }
+
+    uint16_t t = TCNT1;
+    if ((TIFR1 & (1 << TOV1)) && t < 0x8000) ovf1++;
+    return ((uint32_t)ovf1 << 16) | t;
+}
+
+static uint8_t crystal_start(void) {
+    // Timer1 just counts cycles for the timeouts
+    TCCR1A = 0;
+    TCCR1B = (1 << CS10);
+    TIFR1 = (1 << TOV1);
+
+    // Timer2 from TOSC1/TOSC2, no prescaling
+    TIMSK2 = 0;
+    ASSR = (1 << AS2);
+    TCNT2 = 0;
+    TCCR2A = 0;
+    TCCR2B = (1 << CS20);
+
+    // The update-busy flags only clear if the crystal is running
+    uint8_t n = 0;
+    const uint8_t busy = (1 << TCN2UB) | (1 << TCR2AUB) | (1 << TCR2BUB);
+    for (;;) {
+        if (!(ASSR & busy)) {
+            TIFR2 = (1 << TOV2);
+            break;
+        }
+        if (TIFR1 & (1 << TOV1)) {
+            TIFR1 = (1 << TOV1);
+            if (++n > START_TIMEOUT_OVF) return 0;
+        }
+    }
+    while (!(TIFR2 & (1 << TOV2))) {
+        if (TIFR1 & (1 << TOV1)) {
+            TIFR1 = (1 << TOV1);
+            if (++n > START_TIMEOUT_OVF) return 0;
+        }
+    }
+    return measure(SETTLE_WINDOW) != 0;
+}
+
+static void crystal_stop(void) {
+    TCCR2B = 0;
+    ASSR = 0;
+    TCNT2 = 0;
+    TIFR2 = (1 << OCF2B) | (1 << OCF2A) | (1 << TOV2);
+    TCCR1B = 0;
+    TCNT1 = 0;
+    TIFR1 = (1 << TOV1);
+}
+
+static int32_t trim_error(uint32_t cycles) {
+    return (int32_t)(cycles - (uint32_t)TRIM_WINDOW * CYCLES_PER_WINDOW);
+}
+
+// Walk OSCCAL one step at a time towards 8 MHz (the datasheet asks for
+// small steps) until the error changes sign, keep the closer side.
+static uint8_t trim_osccal(void) {
+    uint32_t c = measure(TRIM_WINDOW);
+    if (!c) return 0;
+    int32_t err = trim_error(c);
+
+    int8_t dir = (err > 0) ? -1 : 1; // Too fast: lower OSCCAL
+    uint8_t best = OSCCAL;
+    int32_t best_err = (err < 0) ? -err : err;
+
+    for (uint8_t i = 0; i < MAX_TRIM_STEPS; i++) {
+        uint8_t next = OSCCAL + dir;
+        if ((next & 0x80) != (OSCCAL & 0x80)) break; // Stay in the same range half
+        OSCCAL = next;
+
+        c = measure(TRIM_WINDOW);
+        if (!c) return 0;
+        err = trim_error(c);
+        int32_t a = (err < 0) ? -err : err;
+        if (a < best_err) {
+            best_err = a;
+            best = next;
+        }
+        if ((dir < 0) == (err < 0)) break; // Crossed the target
+    }
+
+    OSCCAL = best;
+    return 1;
+}
+
+static uint8_t calibrate_crystal(void) {
+    uint8_t ok = crystal_start() && trim_osccal();
+    uint32_t c = ok ? measure(FINAL_WINDOW) : 0;
+    crystal_stop();
+    if (!c) return 0;
+
+    // f = cycles * 128 / window. Timer1 / 64 ticks per ms, Q8 = f / 250.
+    uint32_t f = c * (128 / FINAL_WINDOW);
+    uint32_t tpm = (f + 125) / 250;
+    if (tpm > TIMER_TPM_MAX) tpm = TIMER_TPM_MAX; // Trim ran out of range: as close as the timebase goes
+    cal.tpm_q8 = (uint16_t)tpm;
+    cal.ubrr = (uint8_t)((f + 38400) / 76800 - 1); // 9600 baud, U2X: f / (8 * 9600) - 1
+    cal.osccal = OSCCAL;
+    cal.source = CALIB_CRYSTAL;
+    return 1;
+}
+
+uint8_t calib_init(void) {
+    eeprom_read_block(&cal, (const void *)EE_CALIB_ADDR, sizeof(cal));
+    if (cal.magic == CALIB_MAGIC && cal.check == record_check(&cal) && cal.tpm_q8 <= TIMER_TPM_MAX) {
+        OSCCAL = cal.osccal;
+        return 1;
+    }
+
+    if (!calibrate_crystal()) {
+        cal.source = CALIB_DEFAULT;
+        cal.osccal = OSCCAL;
+        cal.tpm_q8 = TPM_NOMINAL;
+        cal.ubrr = UART_CALIBRATED_UBRR;
+    }
+
+    cal.magic = CALIB_MAGIC;
+    cal.check = record_check(&cal);
+    eeprom_update_block(&cal, (void *)EE_CALIB_ADDR, sizeof(cal));
+    return 0;
+}
+
+CalibSource calib_source(void) {
+    return (CalibSource)cal.source;
+}
+
+uint16_t calib_ticks_per_ms(void) {
+    return cal.tpm_q8;
+}
+
+uint8_t calib_ubrr(void) {
+    return cal.ubrr;
+}
+
+void calib_invalidate(void) {
+    eeprom_update_byte((uint8_t *)EE_CALIB_ADDR, 0xFF);
+}
@@ -0,0 +1,36 @@
+#ifndef CALIB_H
+#define CALIB_H
+
+#include <stdint.h>
+
+// Internal RC oscillator calibration.
+// On the first boot the CPU clock is measured against a 32.768 kHz watch
+// crystal on TOSC1/TOSC2 (PB6/PB7), if one is fitted: OSCCAL is trimmed as
+// close to 8 MHz as it goes and the rest of the error is handed to the
+// timebase as a fractional tick rate. The result lives in EEPROM, so later
+// boots only load it. Without a crystal the factory OSCCAL, nominal rate
+// and the hand-tuned UART divisor are used (and remembered as such).
+//
+// The very first boot spends up to ~1 s here either way: measuring, or
+// giving a crystal that isn't there its start-up time (a watch crystal
+// can take that long, so the wait can't be cut short safely). Every boot
+// after that loads the stored result in microseconds.
+
+typedef enum {
+    CALIB_DEFAULT, // No reference found, factory values
+    CALIB_CRYSTAL  // Measured against the 32 kHz crystal
+} CalibSource;
+
+// Load (or measure and store) the calibration and apply OSCCAL.
+// Must run before timer_init() and tm1637_init(): measuring borrows
+// Timer1 and Timer2. Returns 1 if it came from EEPROM.
+uint8_t calib_init(void);
+
+CalibSource calib_source(void);
+uint16_t calib_ticks_per_ms(void); // Timer1 ticks per ms, Q8 (for timer_set_rate())
+uint8_t calib_ubrr(void);          // UART divisor for 9600 baud (U2X)
+
+// Forget the stored result; the next boot measures again
+void calib_invalidate(void);
+
+#endif
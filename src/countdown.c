@@ -0,0 +1,197 @@
+#include "countdown.h"
+
+#define MS_PER_MIN  60000UL
+#define MS_PER_HOUR 3600000UL
+
+// --- DISPLAY VIEW ---
+// Every format is "how many units of 'unit' ms", split in two fields:
+//   HH:MM  unit = 1 min,  n / 60  : n % 60
+//   MM:SS  unit = 1 s,    n / 60  : n % 60
+//   SS.cc  unit = 10 ms,  n / 100 : n % 100
+uint32_t time_view(uint32_t ms, uint8_t flags, TimeView *v) {
+    uint8_t up = flags & TIME_VIEW_UP;
+    uint32_t unit;
+    uint8_t base;
+
+    // Pick the format from the rounded seconds, so it switches exactly when
+    // the shown value would roll over (e.g. 01:00 -> 59.99 on the way down)
+    uint32_t secs = up ? ms / 1000 : (ms + 999) / 1000;
+
+    if (up ? secs >= 3600 : secs > 3600) {
+        v->format = TIME_HHMM;
+        unit = MS_PER_MIN;
+        base = 60;
+    } else if (secs >= 60 || !(flags & TIME_VIEW_CENTIS)) {
+        v->format = TIME_MMSS;
+        unit = 1000;
+        base = 60;
+    } else {
+        v->format = TIME_SSCC;
+        unit = 10;
+        base = 100;
+    }
+
+    uint32_t n = up ? ms / unit : (ms + unit - 1) / unit;
+    uint16_t hi = (uint16_t)(n / base);
+    if (hi > 99) { // Past 99:59 hours: pin the display
+        v->hi = 99;
+        v->lo = 59;
+    } else {
+        v->hi = (uint8_t)hi;
+        v->lo = (uint8_t)(n % base);
+    }
+
+    if (up) return (n + 1) * unit - ms;
+    if (n == 0) return 0;
+    return ms - (n - 1) * unit;
+}
+
+// --- COUNT-DOWN CHANNELS ---
+// While running only the end time is kept, so the remaining time is exact
+// at any moment and nothing needs a periodic tick.
+typedef struct {
+    uint32_t t;     // Remaining ms (paused) or end time (running)
+    uint8_t status; // CountdownStatus
+    uint8_t pos;    // Index in heap[] while running
+} Channel;
+
+static Channel chans[CD_CHANNELS];
+static uint8_t heap[CD_CHANNELS]; // Running channels, soonest end first
+static uint8_t heap_len = 0;
+
+// Wrap-safe "ends before"
+static uint8_t sooner(uint8_t a, uint8_t b) {
+    return (int32_t)(chans[heap[a]].t - chans[heap[b]].t) < 0;
+}
+
+static void heap_swap(uint8_t a, uint8_t b) {
+    uint8_t ch = heap[a];
+    heap[a] = heap[b];
+    heap[b] = ch;
+    chans[heap[a]].pos = a;
+    chans[heap[b]].pos = b;
+}
+
+static void sift_up(uint8_t i) {
+    while (i > 0) {
+        uint8_t parent = (uint8_t)((i - 1) / 2);
+        if (!sooner(i, parent)) break;
+        heap_swap(i, parent);
+        i = parent;
+    }
+}
+
+static void sift_down(uint8_t i) {
+    for (;;) {
+        uint8_t best = i;
+        uint8_t l = (uint8_t)(2 * i + 1);
+        uint8_t r = (uint8_t)(l + 1);
+        if (l < heap_len && sooner(l, best)) best = l;
+        if (r < heap_len && sooner(r, best)) best = r;
+        if (best == i) break;
+        heap_swap(i, best);
+        i = best;
+    }
+}
+
+static void heap_remove(uint8_t ch) {
+    uint8_t i = chans[ch].pos;
+    heap_len--;
+    if (i == heap_len) return;
+    heap_swap(i, heap_len);
+    sift_down(i);
+    sift_up(i);
+}
+
+void countdown_load(uint8_t ch, uint32_t ms) {
+    countdown_cancel(ch);
+    if (ms > COUNTDOWN_MAX_MS) ms = COUNTDOWN_MAX_MS;
+    chans[ch].t = ms;
+    chans[ch].status = CD_PAUSED;
+}
+
+void countdown_start(uint8_t ch, uint32_t now) {
+    if (chans[ch].status != CD_PAUSED) return;
+    chans[ch].t += now;
+    chans[ch].status = CD_RUNNING;
+    chans[ch].pos = heap_len;
+    heap[heap_len++] = ch;
+    sift_up(chans[ch].pos);
+}
+
+void countdown_pause(uint8_t ch, uint32_t now) {
+    if (chans[ch].status != CD_RUNNING) return;
+    chans[ch].t = countdown_remaining(ch, now);
+    chans[ch].status = CD_PAUSED;
+    heap_remove(ch);
+}
+
+void countdown_cancel(uint8_t ch) {
+    if (chans[ch].status == CD_RUNNING) heap_remove(ch);
+    chans[ch].t = 0;
+    chans[ch].status = CD_IDLE;
+}
+
+uint8_t countdown_status(uint8_t ch) {
+    return chans[ch].status;
+}
+
+uint32_t countdown_remaining(uint8_t ch, uint32_t now) {
+    if (chans[ch].status != CD_RUNNING) return chans[ch].t;
+    int32_t left = (int32_t)(chans[ch].t - now);
+    return (left > 0) ? (uint32_t)left : 0;
+}
+
+uint8_t countdown_next(uint32_t *end) {
+    if (heap_len == 0) return CD_NONE;
+    if (end) *end = chans[heap[0]].t;
+    return heap[0];
+}
+
+uint8_t countdown_expire(uint32_t now) {
+    if (heap_len == 0) return CD_NONE;
+    uint8_t ch = heap[0];
+    if ((int32_t)(chans[ch].t - now) > 0) return CD_NONE;
+    heap_remove(ch);
+    chans[ch].t = 0;
+    chans[ch].status = CD_EXPIRED;
+    return ch;
+}
+
+uint8_t countdown_find(uint8_t status) {
+    for (uint8_t ch = 0; ch < CD_CHANNELS; ch++) {
+        if (chans[ch].status == status) return ch;
+    }
+    return CD_NONE;
+}
+
+uint8_t countdown_channel_bytes(void) {
+    return sizeof(Channel) + sizeof(heap[0]);
+}
+
+// --- STOPWATCH ---
+static uint32_t sw_elapsed = 0;
+static uint32_t sw_start = 0;
+static uint8_t sw_running = 0;
+
+void stopwatch_clear(void) {
+    sw_elapsed = 0;
+    sw_running = 0;
+}
+
+void stopwatch_start(uint32_t now) {
+    if (sw_running) return;
+    sw_start = now - sw_elapsed;
+    sw_running = 1;
+}
+
+void stopwatch_stop(uint32_t now) {
+    if (!sw_running) return;
+    sw_elapsed = stopwatch_elapsed(now);
+    sw_running = 0;
+}
+
+uint32_t stopwatch_elapsed(uint32_t now) {
+    uint32_t t = sw_running ? now - sw_start : sw_elapsed;
+    return (t > STOPWATCH_MAX_MS) ? STOPWATCH_MAX_MS : t;
+}
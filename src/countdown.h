@@ -0,0 +1,77 @@
+#ifndef COUNTDOWN_H
+#define COUNTDOWN_H
+
+#include <stdint.h>
+
+// Time core: a count-down and a count-up stopwatch, each kept as a single
+// 32-bit millisecond value, plus the conversion to display digits.
+
+#define COUNTDOWN_MAX_MS (99UL * 3600000 + 59UL * 60000 + 59UL * 1000) // 99:59:59
+#define STOPWATCH_MAX_MS (COUNTDOWN_MAX_MS + 999)
+
+// --- DISPLAY VIEW ---
+// Two two-digit fields with the colon between them. The format follows
+// the value: HH:MM from an hour up, MM:SS from a minute, SS.cc below that
+// (TIME_VIEW_CENTIS only; otherwise MM:SS all the way down).
+typedef enum {
+    TIME_HHMM,
+    TIME_MMSS,
+    TIME_SSCC
+} TimeFormat;
+
+typedef struct {
+    uint8_t hi;     // HH, MM or SS
+    uint8_t lo;     // MM, SS or cc
+    uint8_t format; // TimeFormat
+} TimeView;
+
+#define TIME_VIEW_UP     0x01 // Counting up: round down (default: round up, so
+                              // "00:01" means up to one second is left)
+#define TIME_VIEW_CENTIS 0x02 // Allow SS.cc below a minute
+
+// O(1) split of 'ms' into a view. Returns how many ms until the view
+// would change if the value keeps moving in the given direction (0 if it
+// never will, i.e. a count-down at zero).
+uint32_t time_view(uint32_t ms, uint8_t flags, TimeView *v);
+
+// --- COUNT-DOWN CHANNELS ---
+// CD_CHANNELS independent count-downs. Running ones sit in a min-heap on
+// their end time, so the next one due is always at the top: finding it is
+// O(1), starting/stopping one is O(log n).
+#define CD_CHANNELS 4
+#define CD_NONE     0xFF
+
+typedef enum {
+    CD_IDLE,    // Nothing loaded
+    CD_PAUSED,  // Loaded, not running
+    CD_RUNNING,
+    CD_EXPIRED  // Reached zero, alarm not dismissed yet
+} CountdownStatus;
+
+void countdown_load(uint8_t ch, uint32_t ms); // -> CD_PAUSED
+void countdown_start(uint8_t ch, uint32_t now);
+void countdown_pause(uint8_t ch, uint32_t now);
+void countdown_cancel(uint8_t ch);            // -> CD_IDLE
+uint8_t countdown_status(uint8_t ch);
+uint32_t countdown_remaining(uint8_t ch, uint32_t now);
+
+// Channel due next and its end time (millis()), or CD_NONE if none runs
+uint8_t countdown_next(uint32_t *end);
+
+// Take the next channel that has reached zero by 'now' off the heap and
+// mark it CD_EXPIRED; CD_NONE when there is none (call until then)
+uint8_t countdown_expire(uint32_t now);
+
+// First channel in a given status, CD_NONE if none
+uint8_t countdown_find(uint8_t status);
+
+// SRAM per channel in this module (state + heap slot)
+uint8_t countdown_channel_bytes(void);
+
+// --- STOPWATCH (10 ms resolution on the display) ---
+void stopwatch_clear(void);
+void stopwatch_start(uint32_t now);
+void stopwatch_stop(uint32_t now);
+uint32_t stopwatch_elapsed(uint32_t now);
+
+#endif
@@ -1,16 +1,107 @@
 #include "dfplayer.h"
 #include "uart.h"
-#include <util/delay.h>
+#include "timer.h"
+#include "bench.h"
+#include "trace.h"
 
-// Packet Constants
-#define DF_START_BYTE 0x7E
+// Packet Constants (start byte and size in dfplayer.h)
 #define DF_VERSION    0xFF
 #define DF_LEN        0x06
-#define DF_FEEDBACK   0x00 // 0=No feedback, 1=Feedback
+#define DF_FEEDBACK   0x01 // 0=No feedback, 1=Feedback (module ACKs every command)
 #define DF_END_BYTE   0xEF
 
-// Internal Helper: Builds and sends the 10-byte stack
-static void send_stack(uint8_t cmd, uint16_t param) {
+// Quiet time the module needs after each command (ms). Only used while
+// no frame has been heard from the module (RX not wired): once it talks,
+// commands are paced by its ACKs instead.
+#define DF_GAP_DEFAULT 100
+#define DF_GAP_VOLUME  300  // 100 + 200 extra for volume to apply
+#define DF_GAP_RESET   2000 // Wait for reboot (ends early on its online frame)
+#define DF_BOOT_TIME   3000 // Module takes 1.5 - 3 seconds after power-on (upper bound)
+
+// ACK pacing
+#define DF_GAP_ACKED   10   // Breathing room after an ACK before the next frame
+#define DF_ACK_TIMEOUT 150  // No ACK by then: send again
+#define DF_MAX_RETRIES 2    // Resends before a command is given up
+#define DF_GAP_BUSY    100  // Module said busy/garbled: wait this long, resend
+
+// --- COMMAND QUEUE ---
+// Commands are stored compactly and expanded to a 10-byte frame only when
+// they are handed to the UART.
+typedef struct {
+    uint8_t  cmd;
+    uint16_t param;
+    uint16_t gap_ms;
+} DF_Command;
+
+#define DF_QUEUE_MASK (DF_QUEUE_SIZE - 1)
+
+static DF_Command queue[DF_QUEUE_SIZE];
+static uint8_t q_head = 0;
+static uint8_t q_tail = 0;
+static uint8_t q_high_water = 0;
+static uint8_t q_dropped = 0;
+
+// Earliest time the next frame may go out
+static uint32_t next_send_time = 0;
+
+// Told when DF_Update() next has work to do
+static DF_NotifyFn notify = 0;
+
+// Told about status frames and query replies
+static DF_EventFn on_event = 0;
+
+// --- BOOT ---
+// Commands are held until the module says it is online, or DF_BOOT_TIME
+// has passed without a word (e.g. RX not wired).
+static DF_BootState boot_state = DF_BOOTING;
+static uint32_t boot_start = 0;
+static uint16_t ready_ms = 0;
+static uint8_t  warm = 0;      // Probing a module that should already be up
+static uint8_t  repeating = 0; // Repeat-current-track may be on (DF_CMD_REPEAT)
+
+// --- IN-FLIGHT COMMAND ---
+// The queue head stays queued until the module ACKs it (or it is given up)
+static uint8_t  rx_alive = 0;  // A valid frame has been heard: pace by ACK
+static uint8_t  inflight = 0;
+static uint8_t  tries = 0;     // Resends of the head command so far
+static uint32_t sent_at = 0;
+static uint32_t ack_deadline = 0;
+
+static DF_Stats stats;
+
+// --- RX FRAME ASSEMBLY ---
+static uint8_t rx_frame[DF_FRAME_SIZE];
+static uint8_t rx_len = 0;
+
+static void enqueue(uint8_t cmd, uint16_t param, uint16_t gap_ms) {
+    uint8_t depth = DF_QueueDepth();
+    if (depth >= DF_QUEUE_MASK) { // One slot stays empty to tell full from empty
+        if (q_dropped < 0xFF) q_dropped++;
+        return;
+    }
+
+    DF_Command *c = &queue[q_head];
+    c->cmd = cmd;
+    c->param = param;
+    c->gap_ms = gap_ms;
+    q_head = (q_head + 1) & DF_QUEUE_MASK;
+
+    if (depth + 1 > q_high_water) q_high_water = depth + 1;
+
+    // Ask for DF_Update() when this can go out
+    if (depth == 0 && notify) notify(next_send_time);
+}
+
+// Checksum of a whole frame (same formula as in send_stack())
+static uint16_t frame_checksum(const uint8_t *f) {
+    uint16_t sum = 0;
+    for (uint8_t i = 1; i <= 6; i++) sum += f[i];
+    return 0 - sum;
+}
+
+// Internal Helper: Builds the 10-byte stack and hands it to the UART ring
+static uint8_t send_stack(uint8_t cmd, uint16_t param) {
+    BENCH_ENTER(BENCH_SEND_STACK);
     uint8_t highByte = (uint8_t)(param >> 8);
     uint8_t lowByte  = (uint8_t)(param & 0xFF);
 
@@ -18,47 +109,287 @@ static void send_stack(uint8_t cmd, uint16_t param) {
     // Formula: 0 - (Ver + Len + Cmd + Feedback + ParaH + ParaL)
     uint16_t sum = DF_VERSION + DF_LEN + cmd + DF_FEEDBACK + highByte + lowByte;
     uint16_t checksum = 0 - sum;
-    
-    UART_Tx(DF_START_BYTE);
-    UART_Tx(DF_VERSION);
-    UART_Tx(DF_LEN);
-    UART_Tx(cmd);
-    UART_Tx(DF_FEEDBACK);
-    UART_Tx(highByte);
-    UART_Tx(lowByte);
-    UART_Tx((uint8_t)(checksum >> 8));
-    UART_Tx((uint8_t)(checksum & 0xFF));
-    UART_Tx(DF_END_BYTE);
-    
-    // Small delay ensures the module isn't flooded with commands
-    _delay_ms(100); 
+
+    uint8_t frame[DF_FRAME_SIZE] = {
+        DF_START_BYTE, DF_VERSION, DF_LEN, cmd, DF_FEEDBACK,
+        highByte, lowByte,
+        (uint8_t)(checksum >> 8), (uint8_t)(checksum & 0xFF),
+        DF_END_BYTE
+    };
+
+    uint8_t ok = UART_Write(frame, DF_FRAME_SIZE);
+    if (ok) trace(TR_DF_TX, cmd);
+    BENCH_EXIT(BENCH_SEND_STACK);
+    return ok;
+}
+
+static inline uint8_t time_reached(uint32_t now, uint32_t t) {
+    return (int32_t)(now - t) >= 0;
+}
+
+static void boot_done(DF_BootState how, uint32_t now) {
+    if (boot_state != DF_BOOTING) return;
+    boot_state = how;
+    ready_ms = (uint16_t)(now - boot_start);
+
+    // Whatever was queued during boot can go right away
+    next_send_time = now;
+    if (q_tail != q_head && notify) notify(now);
+}
+
+// The head command is done with (acknowledged, rejected or given up)
+static void complete(uint32_t next) {
+    q_tail = (q_tail + 1) & DF_QUEUE_MASK;
+    inflight = 0;
+    tries = 0;
+    next_send_time = next;
+    if (q_tail != q_head && notify) notify(next);
+}
+
+// Send the head command again after 'delay', or give up on it
+static void retry(uint32_t now, uint16_t delay) {
+    inflight = 0;
+    if (++tries > DF_MAX_RETRIES) {
+        stats.failed++;
+        complete(now);
+        return;
+    }
+    stats.retries++;
+    next_send_time = now + delay;
+    if (notify) notify(next_send_time);
+}
+
+static void handle_frame(uint8_t cmd, uint16_t param) {
+    uint32_t now = millis();
+
+    switch (cmd) {
+        case DF_EVT_ACK:
+            if (!inflight) break; // Late ACK for a command we already resent
+            stats.acks++;
+            stats.ack_last_ms = (uint8_t)((now - sent_at) > 0xFF ? 0xFF : now - sent_at);
+            if (stats.ack_last_ms > stats.ack_max_ms) stats.ack_max_ms = stats.ack_last_ms;
+            complete(now + DF_GAP_ACKED);
+            return;
+
+        case DF_EVT_ERROR:
+            stats.errors++;
+            stats.last_error = (uint8_t)param;
+            if (inflight) {
+                if (param == DF_ERR_BUSY || param == DF_ERR_SERIAL || param == DF_ERR_CHECKSUM) {
+                    retry(now, DF_GAP_BUSY);
+                } else {
+                    complete(now + DF_GAP_ACKED); // Rejected (e.g. no such track)
+                }
+            }
+            break;
+
+        case DF_EVT_ONLINE:
+            if (param) boot_done(DF_READY_ONLINE, now);
+            break;
+    }
+
+    // Status changes, errors and query replies go up to the application
+    if (on_event) on_event(cmd, param);
+}
+
+static void rx_byte(uint8_t b) {
+    // Hunt for the start byte, then collect a whole frame
+    if (rx_len == 0 && b != DF_START_BYTE) return;
+    rx_frame[rx_len++] = b;
+    if (rx_len < DF_FRAME_SIZE) return;
+    rx_len = 0;
+
+    uint16_t checksum = (uint16_t)((rx_frame[7] << 8) | rx_frame[8]);
+    if (rx_frame[1] != DF_VERSION || rx_frame[2] != DF_LEN || rx_frame[9] != DF_END_BYTE ||
+        checksum != frame_checksum(rx_frame)) {
+        stats.rx_bad++;
+        return;
+    }
+
+    rx_alive = 1;
+    if (warm) {
+        warm = 0;
+        boot_done(DF_READY_WARM, millis());
+    }
+    handle_frame(rx_frame[3], (uint16_t)((rx_frame[5] << 8) | rx_frame[6]));
 }
 
 void DF_Init(void) {
-    // The DFPlayer takes 1.5 - 3 seconds to boot up after power-on.
-    // We handle this delay here so the main code doesn't have to guess.
-    _delay_ms(3000);
+    // Don't block here: hold the queue until the module reports in, with
+    // DF_BOOT_TIME as the fallback. DF_Update() has to run at the timeout
+    // even if nothing gets queued.
+    boot_start = millis();
+    next_send_time = boot_start + DF_BOOT_TIME;
+    if (notify) notify(next_send_time);
+}
+
+void DF_InitWarm(void) {
+    // The module most likely kept running through our reset: any valid
+    // frame back (the ACK or the reply to this query) ends the wait
+    DF_Init();
+    warm = 1;
+    repeating = 1; // Whatever it was left in
+    send_stack(DF_QUERY_STATUS, 0);
+}
+
+void DF_Poll(void) {
+    uint8_t b;
+    while (UART_Read(&b)) rx_byte(b);
+}
+
+void DF_SetNotify(DF_NotifyFn fn) {
+    notify = fn;
+}
+
+void DF_SetEventHandler(DF_EventFn fn) {
+    on_event = fn;
+}
+
+void DF_Update(void) {
+    uint32_t now = millis();
+    if (boot_state == DF_BOOTING && time_reached(now, next_send_time)) {
+        boot_done(DF_READY_TIMEOUT, now);
+    }
+
+    if (q_tail == q_head) return;
+
+    if (inflight) {
+        if (!time_reached(now, ack_deadline)) {
+            if (notify) notify(ack_deadline);
+            return;
+        }
+        stats.timeouts++; // No ACK: send it again
+        retry(now, 0);
+        if (q_tail == q_head) return;
+    }
+
+    if (!time_reached(now, next_send_time)) {
+        if (notify) notify(next_send_time);
+        return;
+    }
+
+    DF_Command *c = &queue[q_tail];
+    if (!send_stack(c->cmd, c->param)) {
+        if (notify) notify(now + 1); // UART ring busy, retry shortly
+        return;
+    }
+
+    if (c->cmd == DF_CMD_RESET) {
+        // The module reboots: wait for it as at power-on, it ACKs nothing
+        complete(now + DF_GAP_RESET);
+        boot_state = DF_BOOTING;
+        boot_start = now;
+        return;
+    }
+
+    if (rx_alive) {
+        // Next frame goes out as soon as this one is acknowledged
+        inflight = 1;
+        sent_at = now;
+        ack_deadline = now + DF_ACK_TIMEOUT;
+        if (notify) notify(ack_deadline);
+    } else {
+        // Nobody listening on RX: small gap so the module isn't flooded
+        complete(now + c->gap_ms);
+    }
+}
+
+uint8_t DF_QueueDepth(void) {
+    return (uint8_t)((q_head - q_tail) & DF_QUEUE_MASK);
+}
+
+uint8_t DF_QueueHighWater(void) {
+    return q_high_water;
+}
+
+uint8_t DF_QueueDropped(void) {
+    return q_dropped;
+}
+
+// The module keeps repeating across track changes: a one-shot turns it
+// off first
+static void repeat_off(void) {
+    if (!repeating) return;
+    repeating = 0;
+    enqueue(DF_CMD_REPEAT, 1, DF_GAP_DEFAULT);
 }
 
 void DF_PlayTrack(uint16_t trackNum) {
-    send_stack(DF_CMD_PLAY_TRACK, trackNum);
+    repeat_off();
+    enqueue(DF_CMD_PLAY_TRACK, trackNum, DF_GAP_DEFAULT);
+}
+
+void DF_LoopTrack(uint16_t trackNum) {
+    enqueue(DF_CMD_LOOP_TRACK, trackNum, DF_GAP_DEFAULT);
+}
+
+void DF_PlayFolder(uint8_t folder, uint8_t track) {
+    repeat_off();
+    enqueue(DF_CMD_FOLDER, (uint16_t)folder << 8 | track, DF_GAP_DEFAULT);
+}
+
+void DF_LoopFolder(uint8_t folder, uint8_t track) {
+    // There is no looping form of the folder command: play it, then have
+    // the module repeat whatever is playing
+    enqueue(DF_CMD_FOLDER, (uint16_t)folder << 8 | track, DF_GAP_DEFAULT);
+    enqueue(DF_CMD_REPEAT, 0, DF_GAP_DEFAULT);
+    repeating = 1;
 }
 
 void DF_SetVolume(uint8_t volume) {
     if (volume > 30) volume = 30; // Clamp max volume
-    send_stack(DF_CMD_SET_VOL, volume);
-    _delay_ms(200); // Extra delay for volume to apply
+
+    // Coalesce: a ramp may change the volume faster than the module takes
+    // it, only the latest value matters. The in-flight head is already on
+    // the wire and is left alone.
+    uint8_t i = inflight ? ((q_tail + 1) & DF_QUEUE_MASK) : q_tail;
+    for (; i != q_head; i = (i + 1) & DF_QUEUE_MASK) {
+        if (queue[i].cmd == DF_CMD_SET_VOL) {
+            queue[i].param = volume;
+            return;
+        }
+    }
+    enqueue(DF_CMD_SET_VOL, volume, DF_GAP_VOLUME);
 }
 
 void DF_Pause(void) {
-    send_stack(DF_CMD_PAUSE, 0);
+    enqueue(DF_CMD_PAUSE, 0, DF_GAP_DEFAULT);
 }
 
 void DF_Resume(void) {
-    send_stack(DF_CMD_PLAY, 0);
+    enqueue(DF_CMD_PLAY, 0, DF_GAP_DEFAULT);
 }
 
 void DF_Reset(void) {
-    send_stack(DF_CMD_RESET, 0);
-    _delay_ms(2000); // Wait for reboot
-}
\ No newline at end of file
+    enqueue(DF_CMD_RESET, 0, DF_GAP_RESET);
+    repeating = 0;
+}
+
+void DF_Sleep(void) {
+    enqueue(DF_CMD_SLEEP, 0, DF_GAP_DEFAULT);
+}
+
+void DF_Wake(void) {
+    enqueue(DF_CMD_WAKE, 0, DF_GAP_DEFAULT);
+}
+
+void DF_Query(uint8_t cmd, uint16_t param) {
+    enqueue(cmd, param, DF_GAP_DEFAULT);
+}
+
+uint8_t DF_Idle(void) {
+    return q_tail == q_head && UART_TxIdle();
+}
+
+DF_BootState DF_BootStatus(void) {
+    return boot_state;
+}
+
+uint16_t DF_ReadyTime(void) {
+    return ready_ms;
+}
+
+void DF_GetStats(DF_Stats *out) {
+    *out = stats;
+    out->rx_overruns = UART_RxOverruns();
+}
@@ -3,6 +3,12 @@
 
 #include <stdint.h>
 
+// --- FRAMING ---
+// Every frame either way is DF_FRAME_SIZE bytes from DF_START_BYTE (host.c
+// needs this to tell the module's frames from its own on the shared RX line)
+#define DF_START_BYTE 0x7E
+#define DF_FRAME_SIZE 10
+
 // --- COMMAND DEFINITIONS ---
 #define DF_CMD_NEXT       0x01
 #define DF_CMD_PREV       0x02
@@ -11,17 +17,108 @@
 #define DF_CMD_VOL_DOWN   0x05
 #define DF_CMD_SET_VOL    0x06 // Parameters: 0x00, Volume (0-30)
 #define DF_CMD_EQ         0x07 // Parameters: 0x00, EQ_Type
+#define DF_CMD_LOOP_TRACK 0x08 // Parameters: 0x00, TrackNum (repeat it until stopped)
+#define DF_CMD_SLEEP      0x0A // Standby (low power)
+#define DF_CMD_WAKE       0x0B // Normal working
 #define DF_CMD_RESET      0x0C
 #define DF_CMD_PLAY       0x0D
 #define DF_CMD_PAUSE      0x0E
-#define DF_CMD_FOLDER     0x0F // Parameters: FolderNum, TrackNum
+#define DF_CMD_FOLDER     0x0F // Parameters: FolderNum, TrackNum (folders 01-99, files 001-255)
+#define DF_CMD_REPEAT     0x19 // Parameters: 0x00, 0 = repeat the current track, 1 = stop
+
+// --- QUERIES (reply comes back as a frame with the same code) ---
+#define DF_QUERY_STATUS       0x42
+#define DF_QUERY_VOLUME       0x43
+#define DF_QUERY_EQ           0x44
+#define DF_QUERY_SD_FILES     0x48 // Total tracks on the SD card
+#define DF_QUERY_SD_TRACK     0x4C // Current track
+#define DF_QUERY_FOLDER_FILES 0x4E // Parameter: folder
+#define DF_QUERY_FOLDERS      0x4F
+
+// --- STATUS FRAMES (module -> MCU) ---
+#define DF_EVT_INSERTED   0x3A // Media inserted
+#define DF_EVT_REMOVED    0x3B // Media removed
+#define DF_EVT_USB_DONE   0x3C // Track finished on USB, parameter = track
+#define DF_EVT_SD_DONE    0x3D // Track finished on SD, parameter = track
+#define DF_EVT_ONLINE     0x3F // Boot done, parameter = online media (bit 1 = SD card)
+#define DF_EVT_ERROR      0x40 // Parameter = error code
+#define DF_EVT_ACK        0x41 // Command received
+
+// Error codes in DF_EVT_ERROR frames
+#define DF_ERR_BUSY      0x01 // Still booting
+#define DF_ERR_SERIAL    0x03 // Frame garbled
+#define DF_ERR_CHECKSUM  0x04
+#define DF_ERR_RANGE     0x05 // Track number past the end
+#define DF_ERR_NOT_FOUND 0x06 // No such track (or folder)
+
+// --- CONFIGURATION ---
+// Command queue slots (power of 2; one slot is kept free)
+#define DF_QUEUE_SIZE 8
+
+// Called with the millis() time at which DF_Update() has work to do
+typedef void (*DF_NotifyFn)(uint32_t due);
+
+// Called from DF_Poll() for every valid frame from the module (status
+// changes, errors, query replies, ACKs) after the driver has handled it
+typedef void (*DF_EventFn)(uint8_t evt, uint16_t param);
+
+// Protocol counters
+typedef struct {
+    uint16_t acks;
+    uint16_t retries;     // Commands sent again (timeout or transient error)
+    uint16_t timeouts;    // ACKs that never came
+    uint16_t failed;      // Commands given up after DF_MAX_RETRIES
+    uint16_t errors;      // Error frames received
+    uint16_t rx_bad;      // Frames failing start/version/length/checksum/end
+    uint8_t  rx_overruns; // UART RX bytes lost
+    uint8_t  last_error;  // Code of the last error frame
+    uint8_t  ack_last_ms; // Command -> ACK turnaround (last, worst)
+    uint8_t  ack_max_ms;
+} DF_Stats;
+
+// How the module's boot wait ended
+typedef enum {
+    DF_BOOTING,       // Still waiting
+    DF_READY_ONLINE,  // It reported its media online
+    DF_READY_TIMEOUT, // No status frame, assumed up after DF_BOOT_TIME
+    DF_READY_WARM     // Answered a status query (only the MCU had reset)
+} DF_BootState;
 
 // --- API PROTOTYPES ---
+// All play/volume/etc. calls only queue a command and return immediately.
+// DF_Update() must be called from the main loop to send them out, and
+// DF_Poll() on every pass to pick up the module's replies. Once the module
+// has been heard from, each command waits for its ACK (resent on timeout)
+// instead of a fixed gap.
 void DF_Init(void);
-void DF_PlayTrack(uint16_t trackNum);
-void DF_SetVolume(uint8_t volume);
+void DF_InitWarm(void); // After an MCU-only reset: ask instead of waiting out the boot
+void DF_Update(void);
+void DF_Poll(void);
+void DF_SetNotify(DF_NotifyFn fn);
+void DF_SetEventHandler(DF_EventFn fn);
+void DF_PlayTrack(uint16_t trackNum); // Once (clears DF_LoopFolder's repeat first)
+void DF_LoopTrack(uint16_t trackNum);
+void DF_PlayFolder(uint8_t folder, uint8_t track); // Folder "01".."99", file "001".."255", once
+void DF_LoopFolder(uint8_t folder, uint8_t track); // Same, repeated until paused or a one-shot
+void DF_SetVolume(uint8_t volume); // Replaces a volume change still waiting in the queue
 void DF_Pause(void);
 void DF_Resume(void);
 void DF_Reset(void);
+void DF_Sleep(void);
+void DF_Wake(void);
+void DF_Query(uint8_t cmd, uint16_t param); // DF_QUERY_*; the answer arrives through the event handler
+
+// 1 when nothing is queued and the last frame has fully left the UART
+uint8_t DF_Idle(void);
+
+// --- BOOT ---
+DF_BootState DF_BootStatus(void);
+uint16_t DF_ReadyTime(void); // ms from DF_Init() until audio was ready (0 while booting)
+
+// --- QUEUE DIAGNOSTICS ---
+uint8_t DF_QueueDepth(void);     // Commands waiting right now
+uint8_t DF_QueueHighWater(void); // Deepest the queue has been since boot
+uint8_t DF_QueueDropped(void);   // Commands lost because the queue was full
+void DF_GetStats(DF_Stats *out);
 
 #endif
\ No newline at end of file
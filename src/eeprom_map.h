@@ -0,0 +1,18 @@
+#ifndef EEPROM_MAP_H
+#define EEPROM_MAP_H
+
+// EEPROM layout (ATmega328P: 1 KB). Every module that keeps something
+// across power cycles owns one region here; nothing else writes EEPROM.
+
+#define EE_CALIB_ADDR  0x000 // Oscillator calibration (calib.c)
+#define EE_CALIB_SIZE  8
+
+#define EE_PRESET_ADDR (EE_CALIB_ADDR + EE_CALIB_SIZE) // Preset ring log (presets.c)
+#define EE_PRESET_SIZE 896   // 32 records x 28 bytes
+
+#define EE_MEDIA_ADDR  (EE_PRESET_ADDR + EE_PRESET_SIZE) // SD card catalogue (media.c)
+#define EE_MEDIA_SIZE  16
+
+#define EE_FREE_ADDR   (EE_MEDIA_ADDR + EE_MEDIA_SIZE) // First unused byte
+
+#endif
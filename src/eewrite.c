@@ -0,0 +1,54 @@
+#include "eewrite.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <string.h>
+
+// --- WRITER (EE_READY ISR owned while active) ---
+static uint8_t block[EEWRITE_MAX];   // Block being written
+static uint8_t block_len;
+static volatile uint8_t pos = 0;     // Next byte of 'block'
+static uint16_t block_addr;
+static EewriteCount *block_count;
+static volatile uint8_t writing = 0;
+
+// Program the next byte that differs; called from the ISR (or to start)
+static void write_next(void) {
+    while (pos < block_len) {
+        uint16_t addr = block_addr + pos;
+        uint8_t value = block[pos++];
+        if (eeprom_read_byte((const uint8_t *)(uintptr_t)addr) == value) {
+            if (block_count) block_count->skipped++;
+            continue;
+        }
+        EEAR = addr;
+        EEDR = value;
+        EECR |= (1 << EEMPE);
+        EECR |= (1 << EEPE); // ~3.4 ms, EE_READY fires when done
+        if (block_count) block_count->written++;
+        return;
+    }
+    EECR &= ~(1 << EERIE);
+    writing = 0;
+}
+
+ISR(EE_READY_vect) {
+    write_next();
+}
+
+uint8_t eewrite_start(uint16_t addr, const void *src, uint8_t len, EewriteCount *count) {
+    if (writing) return 0;
+    memcpy(block, src, len);
+    block_len = len;
+    block_addr = addr;
+    block_count = count;
+    pos = 0;
+    writing = 1;
+    EECR |= (1 << EERIE); // Fires right away: EEPROM is idle
+    return 1;
+}
+
+uint8_t eewrite_busy(void) {
+    return writing;
+}
@@ -0,0 +1,26 @@
+#ifndef EEWRITE_H
+#define EEWRITE_H
+
+#include <stdint.h>
+
+// Background EEPROM writer shared by the regions in eeprom_map.h. One
+// block at a time goes out byte by byte from the EEPROM-ready interrupt
+// (bytes already holding their value are skipped), so the main loop never
+// waits on the ~3.4 ms per byte. The block is copied: the caller's buffer
+// is free again as soon as eewrite_start() returns.
+
+#define EEWRITE_MAX 28 // Largest block (a preset record)
+
+typedef struct {
+    uint16_t written;
+    uint16_t skipped; // Already held the right value
+} EewriteCount;
+
+// Queue 'len' bytes (at most EEWRITE_MAX) for EEPROM address 'addr'.
+// Returns 0, and queues nothing, while the previous block is still going
+// out. 'count' (or NULL) has this block's bytes added as they go.
+uint8_t eewrite_start(uint16_t addr, const void *src, uint8_t len, EewriteCount *count);
+
+uint8_t eewrite_busy(void); // A block is going out (don't power down)
+
+#endif
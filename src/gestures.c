@@ -0,0 +1,164 @@
+#include "gestures.h"
+#include "timer.h"
+#include <avr/pgmspace.h>
+
+// Default hold-repeat acceleration (ms between steps). Tuned so that 50
+// steps - the furthest any value is from the current one when wrapping
+// 0..99 - take about two seconds of holding.
+static const uint16_t default_curve[] PROGMEM = {
+    400, 200, 120, 80, 50, 35, 25
+};
+
+static const uint16_t *curve = default_curve;
+static uint8_t curve_len = sizeof(default_curve) / sizeof(default_curve[0]);
+
+static uint8_t repeat_mask = 0;
+static uint8_t held = 0;     // Buttons currently down
+static uint8_t consumed = 0; // Held buttons that already produced their gesture
+static uint32_t press_time[4];
+static uint32_t next_fire[4];
+static uint8_t repeat_count[4];
+static uint8_t wake_dirty = 0; // Held set or timing changed since last wake-up update
+
+void gestures_init(void) {
+    held = 0;
+    consumed = 0;
+}
+
+void gestures_set_repeat(uint8_t mask) {
+    if (mask == repeat_mask) return;
+    repeat_mask = mask;
+    wake_dirty = 1;
+}
+
+void gestures_set_curve(const uint16_t *curve_P, uint8_t len) {
+    curve = curve_P;
+    curve_len = len;
+}
+
+static uint16_t curve_step(uint8_t n) {
+    if (n >= curve_len) n = curve_len - 1;
+    return pgm_read_word(&curve[n]);
+}
+
+static uint8_t emit(Gesture *g, uint8_t kind, uint8_t id, uint8_t mask) {
+    g->kind = kind;
+    g->button = id;
+    g->mask = mask;
+    g->repeat = (kind == GESTURE_REPEAT) ? repeat_count[id] : 0;
+    return 1;
+}
+
+// Feed one raw edge; returns 1 if it completed a gesture
+static uint8_t on_edge(Gesture *g, const ButtonEvent *ev) {
+    uint8_t id = ev->id;
+    uint8_t bit = GESTURE_BIT(id);
+
+    wake_dirty = 1;
+
+    if (ev->edge == BTN_PRESS) {
+        // Another button went down just before this one: it's a chord
+        for (uint8_t other = BTN_L; other <= BTN_R; other++) {
+            uint8_t obit = GESTURE_BIT(other);
+            if ((held & obit) && !(consumed & obit) &&
+                ev->time - press_time[other] <= GESTURE_CHORD_MS) {
+                held |= bit;
+                consumed |= held;
+                repeat_count[id] = 0;
+                return emit(g, GESTURE_CHORD, BTN_NONE, held);
+            }
+        }
+
+        held |= bit;
+        consumed &= ~bit;
+        press_time[id] = ev->time;
+        next_fire[id] = ev->time + curve_step(0);
+        repeat_count[id] = 0;
+        return 0;
+    }
+
+    // Release
+    if (!(held & bit)) return 0;
+    held &= ~bit;
+    if (consumed & bit) {
+        consumed &= ~bit;
+        return 0;
+    }
+    return emit(g, GESTURE_SHORT, id, bit);
+}
+
+// Register when the next long-press / repeat is due, so a sleeping CPU
+// wakes up for it
+static void update_wakeup(void) {
+    uint8_t have = 0;
+    uint32_t best = 0;
+
+    for (uint8_t id = BTN_L; id <= BTN_R; id++) {
+        uint8_t bit = GESTURE_BIT(id);
+        uint32_t t;
+        if (!(held & bit)) continue;
+
+        if (repeat_mask & bit) {
+            if ((consumed & bit) && repeat_count[id] == 0) continue;
+            t = next_fire[id];
+        }
+        else if (!(consumed & bit)) {
+            t = press_time[id] + GESTURE_LONG_MS;
+        }
+        else continue;
+
+        if (!have || (int32_t)(t - best) < 0) {
+            best = t;
+            have = 1;
+        }
+    }
+
+    if (have) timer_set_deadline(TIMER_SLOT_INPUT, best);
+    else      timer_clear_deadline(TIMER_SLOT_INPUT);
+}
+
+static uint8_t poll_gesture(Gesture *g, uint32_t now) {
+    ButtonEvent ev;
+    while (buttons_get_event(&ev)) {
+        if (on_edge(g, &ev)) return 1;
+    }
+
+    // Time based gestures for buttons still held
+    uint8_t pending = held & ~consumed;
+    if (!pending && !(held & repeat_mask)) return 0;
+
+    for (uint8_t id = BTN_L; id <= BTN_R; id++) {
+        uint8_t bit = GESTURE_BIT(id);
+        if (!(held & bit)) continue;
+
+        if (repeat_mask & bit) {
+            // Chords consume their buttons, so don't repeat those either
+            if ((consumed & bit) && repeat_count[id] == 0) continue;
+            if ((int32_t)(now - next_fire[id]) < 0) continue;
+
+            consumed |= bit; // No short press on release after repeating
+            wake_dirty = 1;
+            emit(g, GESTURE_REPEAT, id, bit);
+            uint8_t n = repeat_count[id];
+            if (n < 0xFF) repeat_count[id] = n + 1;
+            next_fire[id] += curve_step(n + 1);
+            return 1;
+        }
+
+        if ((pending & bit) && now - press_time[id] >= GESTURE_LONG_MS) {
+            consumed |= bit;
+            wake_dirty = 1;
+            return emit(g, GESTURE_LONG, id, bit);
+        }
+    }
+    return 0;
+}
+
+uint8_t gestures_poll(Gesture *g, uint32_t now) {
+    uint8_t found = poll_gesture(g, now);
+    if (wake_dirty) {
+        wake_dirty = 0;
+        update_wakeup();
+    }
+    return found;
+}
@@ -0,0 +1,49 @@
+#ifndef GESTURES_H
+#define GESTURES_H
+
+#include <stdint.h>
+#include "buttons.h"
+
+// Gesture layer on top of the button event queue.
+// Turns raw press/release edges into short presses, long presses,
+// accelerating hold-repeat and multi-button chords.
+
+typedef enum {
+    GESTURE_NONE = 0,
+    GESTURE_SHORT,  // Pressed and released before the long-press threshold
+    GESTURE_LONG,   // Held past the threshold (buttons without repeat)
+    GESTURE_REPEAT, // Held, fires at an accelerating rate (buttons with repeat)
+    GESTURE_CHORD   // Two or more buttons pressed together
+} GestureKind;
+
+#define GESTURE_BIT(id)  (1 << (id))
+#define GESTURE_CHORD_LR (GESTURE_BIT(BTN_L) | GESTURE_BIT(BTN_R))
+#define GESTURE_CHORD_LM (GESTURE_BIT(BTN_L) | GESTURE_BIT(BTN_M))
+#define GESTURE_CHORD_MR (GESTURE_BIT(BTN_M) | GESTURE_BIT(BTN_R))
+
+// --- CONFIGURATION (ms) ---
+#define GESTURE_LONG_MS    700 // Same threshold as the old prototype
+#define GESTURE_CHORD_MS   80  // Max gap between presses to count as a chord
+
+typedef struct {
+    uint8_t kind;   // GestureKind
+    uint8_t button; // ButtonID for single-button gestures, BTN_NONE for chords
+    uint8_t mask;   // GESTURE_BIT() of every button involved
+    uint8_t repeat; // GESTURE_REPEAT: 0 for the first repeat, then counts up
+} Gesture;
+
+void gestures_init(void);
+
+// Which buttons auto-repeat while held (GESTURE_BIT mask). Buttons not in
+// the mask report GESTURE_LONG instead.
+void gestures_set_repeat(uint8_t mask);
+
+// Replace the hold-repeat acceleration curve: 'len' delays (ms) in flash,
+// the first one is the initial hold delay, the last one repeats forever.
+void gestures_set_curve(const uint16_t *curve_P, uint8_t len);
+
+// Returns 1 and fills 'g' if a gesture happened. Call every loop pass;
+// long-press and repeat timing is evaluated against 'now'.
+uint8_t gestures_poll(Gesture *g, uint32_t now);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef GLYPHS_H
+#define GLYPHS_H
+
+// 7-segment glyphs, resolved by the compiler: GLYPH('E') is a constant,
+// so tables of text built from it land in flash fully encoded and nothing
+// is looked up at run time.
+//
+//    a        bit 0 = a ... bit 6 = g,
+//  f   b      bit 7 = colon (on digit 1)
+//    g
+//  e   c
+//    d
+//
+// Letters follow the usual 7-segment forms; where upper and lower case
+// can't both be drawn only the drawable one exists ('b', 'd', 'n', 'r', 't'
+// ...). 'O' and 'S' look like '0' and '5'. Anything else is GLYPH_UNKNOWN,
+// which stands out on the display instead of silently showing blank.
+
+#define GLYPH_COLON   0x80
+#define GLYPH_UNKNOWN 0x49 // a, d, g: three bars
+
+#define GLYPH(c) ((uint8_t)(                                            \
+    (c) == ' ' ? 0x00 : (c) == '-' ? 0x40 : (c) == '_' ? 0x08 :         \
+    (c) == '=' ? 0x48 :                                                 \
+    (c) == '0' ? 0x3F : (c) == '1' ? 0x06 : (c) == '2' ? 0x5B :         \
+    (c) == '3' ? 0x4F : (c) == '4' ? 0x66 : (c) == '5' ? 0x6D :         \
+    (c) == '6' ? 0x7D : (c) == '7' ? 0x07 : (c) == '8' ? 0x7F :         \
+    (c) == '9' ? 0x6F :                                                 \
+    (c) == 'A' ? 0x77 : (c) == 'b' ? 0x7C : (c) == 'C' ? 0x39 :         \
+    (c) == 'c' ? 0x58 : (c) == 'd' ? 0x5E : (c) == 'E' ? 0x79 :         \
+    (c) == 'F' ? 0x71 : (c) == 'G' ? 0x3D : (c) == 'H' ? 0x76 :         \
+    (c) == 'h' ? 0x74 : (c) == 'I' ? 0x30 : (c) == 'J' ? 0x1E :         \
+    (c) == 'L' ? 0x38 : (c) == 'n' ? 0x54 : (c) == 'o' ? 0x5C :         \
+    (c) == 'O' ? 0x3F : (c) == 'P' ? 0x73 : (c) == 'q' ? 0x67 :         \
+    (c) == 'r' ? 0x50 : (c) == 'S' ? 0x6D : (c) == 't' ? 0x78 :         \
+    (c) == 'U' ? 0x3E : (c) == 'u' ? 0x1C : (c) == 'y' ? 0x6E :         \
+    GLYPH_UNKNOWN))
+
+// Four characters as an initializer:
+//   static const uint8_t paus[4] PROGMEM = GLYPH4('P', 'A', 'U', 'S');
+// Character constants rather than a subscripted string literal: avr-gcc
+// 7 does not take "PAUS"[0] as a constant in a static initializer.
+#define GLYPH4(a, b, c, d) { GLYPH(a), GLYPH(b), GLYPH(c), GLYPH(d) }
+
+#endif
@@ -0,0 +1,200 @@
+#include "host.h"
+#include "uart.h"
+#include "timer.h"
+#include "dfplayer.h"
+#include "countdown.h"
+
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+
+// Arguments and reply data per op (0xFF = no such op)
+typedef struct {
+    uint8_t args;
+    uint8_t reply;
+} HostOpDesc;
+
+static const HostOpDesc op_table[HOST_OP_COUNT] PROGMEM = {
+    [0]                = { 0xFF, 0 },
+    [HOST_OP_SET]      = { 4, 0 },
+    [HOST_OP_START]    = { 1, 0 },
+    [HOST_OP_PAUSE]    = { 1, 0 },
+    [HOST_OP_STOP]     = { 1, 0 },
+    [HOST_OP_SELECT]   = { 1, 0 },
+    [HOST_OP_FAV_SET]  = { 4, 0 },
+    [HOST_OP_FAV_LOAD] = { 2, 0 },
+    [HOST_OP_STATE]    = { 0, 3 + 5 * CD_CHANNELS },
+    [HOST_OP_COUNTERS] = { 0, HOST_COUNTER_BYTES },
+    [HOST_OP_POWER]    = { 1, HOST_POWER_BYTES },
+    [HOST_OP_DISPLAY]  = { 0, HOST_DISPLAY_BYTES },
+};
+
+// host_poll() queues a reply in one go (the ring keeps one slot free)
+_Static_assert(HOST_OVERHEAD + HOST_MAX_REPLY < UART_TX_BUF_SIZE, "reply does not fit the TX ring");
+
+static HostCmdFn handler = 0;
+static HostStats stats;
+
+// --- RECEIVE (USART_RX interrupt) ---
+// The packet is checked as it comes in, so by the time the foreground
+// sees it there is nothing left to do but run it.
+enum { RX_HUNT, RX_LEN, RX_SEQ, RX_DATA, RX_CRC_LO, RX_CRC_HI };
+
+static uint8_t rx_state = RX_HUNT;
+static uint8_t df_left = 0;   // Bytes of a DFPlayer frame still passing through
+static uint8_t rx_keep;       // Packet goes to rx_pkt (0: busy, counted and dropped)
+static uint8_t rx_pos;
+static uint16_t rx_crc;
+static uint16_t rx_last_ms;   // Time of the last byte (torn packets)
+
+static uint8_t rx_pkt[HOST_MAX_PAYLOAD];
+static uint8_t rx_len;
+static uint8_t rx_seq;
+static volatile uint8_t rx_ready = 0; // rx_pkt is complete and waiting
+
+static uint8_t rx_byte(uint8_t b) {
+    uint16_t now = (uint16_t)millis();
+    if (rx_state != RX_HUNT && (uint16_t)(now - rx_last_ms) > HOST_GAP_MS) {
+        stats.timeouts++; // Sender went away mid-packet: hunt again from here
+        rx_state = RX_HUNT;
+    }
+    rx_last_ms = now;
+
+    switch (rx_state) {
+        case RX_HUNT:
+            // The module's frames go through whole, whatever they contain
+            if (df_left) {
+                df_left--;
+                return 0;
+            }
+            if (b == DF_START_BYTE) {
+                df_left = DF_FRAME_SIZE - 1;
+                return 0;
+            }
+            if (b != HOST_START_BYTE) return 0; // Noise: dfplayer.c drops it
+            rx_crc = 0xFFFF;
+            rx_state = RX_LEN;
+            return 1;
+
+        case RX_LEN:
+            if (b > HOST_MAX_PAYLOAD) {
+                stats.errors++;
+                rx_state = RX_HUNT;
+                return 1;
+            }
+            rx_keep = !rx_ready;
+            if (rx_keep) rx_len = b;
+            rx_pos = b; // Counts down
+            rx_state = RX_SEQ;
+            break;
+
+        case RX_SEQ:
+            if (rx_keep) rx_seq = b;
+            rx_state = rx_pos ? RX_DATA : RX_CRC_LO;
+            break;
+
+        case RX_DATA:
+            if (rx_keep) rx_pkt[rx_len - rx_pos] = b;
+            if (--rx_pos == 0) rx_state = RX_CRC_LO;
+            break;
+
+        case RX_CRC_LO:
+            rx_crc ^= b; // Received CRC cancels out: 0 left if it matches
+            rx_state = RX_CRC_HI;
+            return 1;
+
+        default: // RX_CRC_HI
+            rx_crc ^= (uint16_t)b << 8;
+            rx_state = RX_HUNT;
+            if (rx_crc) stats.errors++;
+            else if (!rx_keep) stats.dropped++;
+            else rx_ready = 1;
+            return 1;
+    }
+    rx_crc = _crc_xmodem_update(rx_crc, b);
+    return 1;
+}
+
+// --- REPLY ---
+// Kept after sending: a repeated seq gets it again
+static uint8_t reply[HOST_OVERHEAD + HOST_MAX_REPLY];
+static uint8_t reply_len = 0;
+static uint8_t reply_pending = 0;
+static uint8_t have_last = 0; // 'reply' holds the answer to the last packet
+
+static void run_batch(void) {
+    uint8_t *out = &reply[3];
+    uint8_t room = HOST_MAX_REPLY;
+    uint8_t i = 0;
+
+    while (i < rx_len) {
+        uint8_t op = rx_pkt[i++];
+        uint8_t args = 0xFF;
+        uint8_t data = 0;
+        if (op < HOST_OP_COUNT) {
+            args = pgm_read_byte(&op_table[op].args);
+            data = pgm_read_byte(&op_table[op].reply);
+        }
+
+        uint8_t status;
+        if (room < 2 + data) status = HOST_ERR_FULL;
+        else if (args == 0xFF) status = HOST_ERR_OP;
+        else if (args > rx_len - i) status = HOST_ERR_LEN;
+        else status = handler(op, &rx_pkt[i], out + 2);
+
+        if (room < 2) break; // Not even the status fits
+        out[0] = op;
+        out[1] = status;
+        if (status != HOST_OK) data = 0;
+        out += 2 + data;
+        room -= 2 + data;
+        if (status == HOST_ERR_FULL || status == HOST_ERR_OP || status == HOST_ERR_LEN) break;
+        i += args;
+    }
+
+    uint8_t len = HOST_MAX_REPLY - room;
+    reply[0] = HOST_START_BYTE;
+    reply[1] = len;
+    reply[2] = rx_seq;
+    uint16_t crc = 0xFFFF;
+    for (uint8_t n = 1; n < 3 + len; n++) crc = _crc_xmodem_update(crc, reply[n]);
+    reply[3 + len] = (uint8_t)crc;
+    reply[4 + len] = (uint8_t)(crc >> 8);
+    reply_len = (uint8_t)(HOST_OVERHEAD + len);
+}
+
+void host_init(HostCmdFn fn) {
+    handler = fn;
+    UART_SetRxHook(rx_byte);
+}
+
+uint8_t host_poll(void) {
+    uint8_t ran = 0;
+
+    if (rx_ready) {
+        if (have_last && rx_seq == reply[2]) {
+            stats.repeats++; // Our reply got lost: same again
+        } else {
+            stats.packets++; // This one included, for HOST_OP_COUNTERS
+            run_batch();
+            ran = 1;
+        }
+        have_last = 1;
+        reply_pending = 1;
+        rx_ready = 0; // The interrupt may fill rx_pkt again
+    }
+
+    // All at once, so the module's frames can't end up in the middle
+    if (reply_pending && UART_Write(reply, reply_len)) reply_pending = 0;
+    return ran;
+}
+
+uint8_t host_pending(void) {
+    return rx_ready;
+}
+
+void host_get_stats(HostStats *out) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *out = stats;
+    }
+}
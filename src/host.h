@@ -0,0 +1,89 @@
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdint.h>
+
+// Host control protocol on the UART: a bench PC or a controller sets up
+// and drives the timers over RXD, in batches.
+//
+// Wiring: the host's TX joins the DFPlayer's TX on PD0 through a diode
+// each (both idle high, the RX pull-up does the rest); the host listens on
+// PD1 alongside the module. 9600 8N1, like the module.
+//
+// Packet, either way:
+//   0xA5 | len | seq | payload[len] | crc lo | crc hi
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over len, seq and payload.
+// 0xA5 never starts a DFPlayer frame, so the receive interrupt can pull
+// packets out of the stream and leave the module's frames to dfplayer.c.
+//
+// Request payload: commands back to back, each an op byte and its fixed
+// arguments. They all run in one loop pass, in order. Reply payload: per
+// command its op, a status and (only if HOST_OK) its data; a command that
+// fails does not stop the batch, except HOST_ERR_OP/LEN/FULL which end it
+// there (the rest is not run).
+//
+// Stop and wait: one packet in flight. A packet that comes in before the
+// last one has run is dropped; repeating a seq number (no reply seen)
+// gets the same reply again without running the batch twice. Packets are
+// not heard in power-down (the UART has no clock); any button wakes it.
+
+#define HOST_START_BYTE  0xA5
+#define HOST_MAX_PAYLOAD 32 // Request
+#define HOST_MAX_REPLY   58 // Reply (the whole packet has to fit the TX ring)
+#define HOST_OVERHEAD    5  // Start, len, seq, CRC
+#define HOST_GAP_MS      20 // Longer silence inside a packet drops it
+
+// --- COMMANDS ---
+// Times are hr (0-99), min, sec; channels and slots count from 0.
+// Multi-byte values are little endian.
+#define HOST_OP_SET      0x01 // ch hr min sec: channel's stored time
+#define HOST_OP_START    0x02 // ch: start from the stored time, or resume
+#define HOST_OP_PAUSE    0x03 // ch
+#define HOST_OP_STOP     0x04 // ch: cancel (silences its alarm)
+#define HOST_OP_SELECT   0x05 // ch: channel the buttons act on
+#define HOST_OP_FAV_SET  0x06 // slot hr min sec: store a favourite
+#define HOST_OP_FAV_LOAD 0x07 // ch slot: favourite into a channel's stored time
+#define HOST_OP_STATE    0x08 // -> state, selected, n, n x (status, ms left u32)
+#define HOST_OP_COUNTERS 0x09 // -> HOST_COUNTER_BYTES, see main.c
+#define HOST_OP_POWER    0x0A // tag -> awake, asleep, powerdown_s (u32), sleeps (u16); see power.h
+#define HOST_OP_DISPLAY  0x0B // -> TM1637_Stats: 4 x u32, ack_failures (u16); see tm1637.h
+#define HOST_OP_COUNT    0x0C
+
+#define HOST_COUNTER_BYTES 19
+#define HOST_POWER_BYTES   14
+#define HOST_DISPLAY_BYTES 18
+
+// Status per command
+#define HOST_OK        0
+#define HOST_ERR_ARG   1 // Channel, slot or time out of range
+#define HOST_ERR_STATE 2 // Not now (e.g. start at 00:00, pause a stopped timer)
+#define HOST_ERR_OP    3 // Unknown op: batch ends
+#define HOST_ERR_LEN   4 // Arguments cut off by the end of the packet: batch ends
+#define HOST_ERR_FULL  5 // No room left in the reply: batch ends
+#define HOST_ERR_BUSY  6 // Channel's time being edited on the buttons
+
+// Runs one command: 'arg' holds its arguments, its reply data goes to
+// 'out' (exactly as many bytes as the op returns). Returns a status.
+typedef uint8_t (*HostCmdFn)(uint8_t op, const uint8_t *arg, uint8_t *out);
+
+typedef struct {
+    uint16_t packets; // Batches run
+    uint16_t errors;  // Bad CRC or length
+    uint16_t dropped; // Arrived while the previous one was waiting
+    uint16_t repeats; // Same seq again: reply resent
+    uint16_t timeouts; // Cut off mid-packet (HOST_GAP_MS)
+} HostStats;
+
+// Takes over the UART receive hook; call after UART_Init()
+void host_init(HostCmdFn fn);
+
+// From the main loop: runs a packet that has come in and sends the reply
+// (as soon as the TX ring has room for all of it). Returns 1 if a batch ran.
+uint8_t host_poll(void);
+
+// A packet is waiting for host_poll() (checked before sleeping)
+uint8_t host_pending(void);
+
+void host_get_stats(HostStats *out);
+
+#endif
@@ -1,32 +1,78 @@
 #ifndef IO_MAP_H
 #define IO_MAP_H
 
-#include <avr/io.h>
-
-// --- UART / DFPLAYER (PD1/TXD) ---
-// UART is handled by the hardware peripheral, but we define pin for reference
-#define DF_UART_PORT   PORTD
-#define DF_UART_DDR    DDRD
-#define DF_UART_TX_PIN 1 
-
-// --- TM1637 DISPLAY (PB0, PB1) ---
-#define DISP_PORT      PORTB
-#define DISP_DDR       DDRB
-#define DISP_PIN_REG   PINB
-#define DISP_CLK_PIN   0
-#define DISP_DIO_PIN   1
-
-// --- BUTTONS (PD2, PD3, PD4) ---
-#define BTN_PORT       PORTD
-#define BTN_PIN_REG    PIND
-#define BTN_DDR        DDRD
-
-// Mapping Physical Pins to Logical Names
-// BTN_L (Left)   = PD2
-// BTN_M (Middle) = PD3
-// BTN_R (Right)  = PD4
-#define PIN_BTN_L      2 
-#define PIN_BTN_M      3 
-#define PIN_BTN_R      4 
-
-#endif
\ No newline at end of file
+#include <avr/io.h> // Native build (env:native) picks this up from sim/include
+#include <stdint.h>
+
+// --- PIN MAP ---
+// Port letter and bit of every signal; a board variant only edits this block.
+
+// UART / DFPLAYER: the hardware UART owns PD0/RXD and PD1/TXD, only the
+// RX pull-up is ours (module TX; an unplugged module reads idle)
+#define DF_UART_RX   D, 0
+
+// TM1637 DISPLAY
+#define DISP_CLK     B, 0
+#define DISP_DIO     B, 1
+
+// BUTTONS: all on one port, so a single read samples them together.
+// L and M are also INT0/INT1 (PD2/PD3), R any other port D pin: its pin
+// change interrupt (buttons.c checks this at compile time).
+#define BTN_PORT     D
+#define PIN_BTN_L    2
+#define PIN_BTN_M    3
+#define PIN_BTN_R    4
+
+// --- PIN ACCESS ---
+// IO_PIN(name, pin) generates static inline accessors for one pin of the
+// map. Port and bit are constants, so with the ATmega328P's ports all in
+// the bit-addressable I/O range each one folds to a single instruction:
+//   name_high() / name_low()      sbi / cbi PORTx
+//   name_output() / name_input()  sbi / cbi DDRx
+//   name_toggle()                 sbi PINx (writing a 1 to PINx toggles)
+//   if (name_read())              sbis / sbic PINx
+// IO_GROUP(name, port, mask) does the same for several pins of one port:
+// name_read() is one IN of the whole port, masked.
+#define IO_PIN(name, pin)             IO_PIN_(name, pin)
+#define IO_GROUP(name, port, mask)    IO_GROUP_(name, port, mask)
+
+// The host simulator follows every pin write (its TM1637 decodes the bus
+// edge by edge); on the chip this is nothing.
+#ifdef DAMKA_SIM
+void sim_pin_written(void);
+#define IO_WRITTEN() sim_pin_written()
+#else
+#define IO_WRITTEN() ((void)0)
+#endif
+
+#define IO_PIN_(name, port, bit)                                                                    \
+    enum { name##_bit = (1 << (bit)) };                                                             \
+    static inline void name##_high(void)    { PORT##port |= (1 << (bit)); IO_WRITTEN(); }           \
+    static inline void name##_low(void)     { PORT##port &= (uint8_t)~(1 << (bit)); IO_WRITTEN(); } \
+    static inline void name##_output(void)  { DDR##port |= (1 << (bit)); IO_WRITTEN(); }            \
+    static inline void name##_input(void)   { DDR##port &= (uint8_t)~(1 << (bit)); IO_WRITTEN(); }  \
+    static inline void name##_toggle(void)  { PIN##port |= (1 << (bit)); IO_WRITTEN(); }            \
+    static inline uint8_t name##_read(void) { return (PIN##port & (1 << (bit))) != 0; }
+
+#define IO_GROUP_(name, port, mask)                                                 \
+    static inline uint8_t name##_read(void)  { return PIN##port & (mask); }          \
+    static inline void name##_pullup(void)   { PORT##port |= (mask); }               \
+    static inline void name##_input(void)    { DDR##port &= (uint8_t)~(mask); }
+
+// Port letter as a number, for #if checks against the map:
+//   #if IO_PORT_ID(BTN_PORT) != IO_PORT_ID_D
+#define IO_PORT_ID(port)  IO_PORT_ID_(port)
+#define IO_PORT_ID_(port) IO_PORT_ID_##port
+#define IO_PORT_ID_B      1
+#define IO_PORT_ID_C      2
+#define IO_PORT_ID_D      3
+
+#define BTN_BIT(pin) (1 << (pin))
+#define BTN_MASK     (BTN_BIT(PIN_BTN_L) | BTN_BIT(PIN_BTN_M) | BTN_BIT(PIN_BTN_R))
+
+IO_PIN(df_rx, DF_UART_RX)
+IO_PIN(disp_clk, DISP_CLK)
+IO_PIN(disp_dio, DISP_DIO)
+IO_GROUP(btn_port, BTN_PORT, BTN_MASK)
+
+#endif
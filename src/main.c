@@ -1,194 +1,936 @@
 #include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <avr/wdt.h>
 #include <stdbool.h>
 
 #include "io_map.h"
 
+#include "app.h"
+
 #include "uart.h"
 #include "dfplayer.h"
 #include "tm1637.h"
+#include "anim.h"
 #include "timer.h"
 #include "buttons.h"
+#include "gestures.h"
+#include "power.h"
+#include "sched.h"
+#include "alarm.h"
+#include "media.h"
+#include "countdown.h"
+#include "presets.h"
+#include "calib.h"
+#include "recovery.h"
+#include "trace.h"
+#include "host.h"
+#include "bench.h"
 
 // --- STATE DEFINITIONS ---
 typedef enum {
     STATE_IDLE,
+    STATE_SET_HR,
     STATE_SET_MIN,
     STATE_SET_SEC,
     STATE_RUNNING,
     STATE_PAUSED,
-    STATE_ALARM
+    STATE_ALARM,
+    STATE_STOPWATCH,  // Stopwatch stopped (shows the elapsed time)
+    STATE_SW_RUNNING, // Stopwatch counting up
+    NUM_STATES
 } TimerState;
 
+// Events fed to the state machine
+typedef enum {
+    EV_L,        // Short press or hold-repeat
+    EV_M,
+    EV_R,
+    EV_CHORD_LR, // L+R together
+    EV_CHORD_MR, // M+R together: next channel
+    EV_CHORD_LM, // L+M together
+    EV_LONG_L,   // Long press (buttons without hold-repeat)
+    EV_LONG_M,
+    EV_LONG_R,
+    EV_OTHER,    // Any other gesture (other long presses, other chords)
+    EV_EXPIRED,  // A countdown reached zero (selected by then)
+    NUM_EVENTS
+} UiEvent;
+
 TimerState currentState = STATE_IDLE;
 
-// --- DATA VARIABLES ---
-// 'stored' holds the config, 'live' holds the countdown
-uint8_t stored_min = 0;
-uint8_t stored_sec = 0;
-int8_t  live_min = 0; // Signed to make underflow logic easier
-int8_t  live_sec = 0;
+// --- CHANNELS ---
+// CD_CHANNELS independent timers. The buttons act on the selected one;
+// the others keep running in countdown.c (plain milliseconds, deadline heap).
+// The config of each is its last-used time, restored from EEPROM at boot.
+typedef PresetTime ChannelConfig;
+
+static ChannelConfig channels[CD_CHANNELS];
+static ChannelConfig *cfg = &channels[0]; // Selected channel's config
+static uint8_t sel = 0;                   // Selected channel
+
+// Alarm sound per channel, so overlapping timers can be told apart
+_Static_assert(SND_ALARM_4 - SND_ALARM_1 + 1 == CD_CHANNELS, "one alarm sound per channel");
+
+static uint8_t fav = 0xFF; // Favourite last recalled (0xFF = none yet)
+
+// Labels: "Ch n" is shown this long whenever the display switches to
+// another channel's time, "P n" when a favourite is recalled or saved
+#define LABEL_MS  800
+
+// Takes turns with the time while paused
+static const uint8_t text_paused[4] PROGMEM = GLYPH4('P', 'A', 'U', 'S');
+
+static uint8_t label_ch = 0;       // Channel whose time was shown last
+static uint8_t label_seg[2];       // First two digits of the label
+static uint8_t label_num;          // Last digit (1-based)
+static uint32_t label_until = 0;
+static bool label_on = false;
 
 // --- TIMING VARIABLES ---
-uint32_t last_tick_time = 0;
-uint32_t last_blink_time = 0;
-bool blink_on = true;
+static bool blink_on = true;
+
+// --- TASKS ---
+// Everything time-driven runs from the scheduler; the loop itself only
+// reacts to button gestures.
+// One id per task registered in app_init(), so the table size is checked
+// against them at compile time.
+static struct {
+    uint8_t expire;  // Next countdown end or cue (one-shot, any channel running)
+    uint8_t blink;   // 500ms Slow Blink for UI (blinking states only)
+    uint8_t display; // Push the current frame (on change)
+    uint8_t audio;   // DFPlayer command queue
+    uint8_t idle;    // Power-down after inactivity
+    uint8_t alarm;   // Alarm volume ramp / escalation (ALARM only)
+    uint8_t presets; // Deferred preset save
+    uint8_t trace;   // Trace dump going out (trace.h)
+} task;
+
+_Static_assert(sizeof(task) <= SCHED_MAX_TASKS, "more tasks than SCHED_MAX_TASKS");
+
+// Request a display update
+static void display_dirty(void) {
+    sched_at(task.display, millis());
+}
+
+// --- ACTIONS ---
+// Transition actions return false to veto the transition (guards).
+// Entry/exit actions ignore the return value.
+typedef bool (*ActionFn)(void);
+
+static bool act_none(void)      { return true; }
+static bool act_hr_down(void)   { if (cfg->hr == 0) cfg->hr = 99; else cfg->hr--; return true; }
+static bool act_hr_up(void)     { if (cfg->hr >= 99) cfg->hr = 0; else cfg->hr++; return true; }
+static bool act_hr_clear(void)  { cfg->hr = 0; return true; }
+static bool act_min_down(void)  { if (cfg->min == 0) cfg->min = 59; else cfg->min--; return true; }
+static bool act_min_up(void)    { if (cfg->min >= 59) cfg->min = 0; else cfg->min++; return true; }
+static bool act_min_clear(void) { cfg->min = 0; return true; }
+static bool act_sec_down(void)  { if (cfg->sec == 0) cfg->sec = 59; else cfg->sec--; return true; }
+static bool act_sec_up(void)    { if (cfg->sec >= 59) cfg->sec = 0; else cfg->sec++; return true; }
+static bool act_sec_clear(void) { cfg->sec = 0; return true; }
+
+static uint32_t config_ms(const ChannelConfig *c) {
+    return ((uint32_t)c->hr * 3600 + (uint16_t)c->min * 60 + c->sec) * 1000;
+}
+
+static uint32_t stored_ms(void) {
+    return config_ms(cfg);
+}
+
+static void show_label(uint8_t s0, uint8_t s1, uint8_t num) {
+    label_seg[0] = s0;
+    label_seg[1] = s1;
+    label_num = num;
+    label_until = millis() + LABEL_MS;
+    label_on = true;
+}
+
+static void save_preset(uint8_t slot, const PresetTime *t) {
+    presets_set(slot, t, millis());
+    sched_at(task.presets, millis());
+}
+
+static void select_channel(uint8_t ch) {
+    sel = ch;
+    cfg = &channels[ch];
+}
+
+// Sound cues before the channel due next ends: SND_WARNING once, then
+// SND_TICK on each of its last seconds. Not while an alarm is ringing.
+#define CUE_WARN_MS 10000
+#define CUE_TICKS   3
+
+static uint32_t cue_at;
+static uint8_t cue = SND_COUNT; // Sound due at cue_at, SND_COUNT = none
+
+// No per-second tick: one deadline for whichever channel ends first (or
+// its next cue), the display follows on its own. O(1) to find, whatever
+// the number running.
+static void rearm_expire(void) {
+    uint32_t end;
+    if (countdown_next(&end) == CD_NONE) {
+        cue = SND_COUNT;
+        sched_stop(task.expire);
+        return;
+    }
+
+    // Next cue still ahead: the warning, else the furthest tick
+    int32_t left = (int32_t)(end - millis());
+    cue = SND_COUNT;
+    if (left > CUE_WARN_MS) {
+        cue = SND_WARNING;
+        cue_at = end - CUE_WARN_MS;
+    } else if (left > 1000) {
+        uint8_t n = (uint8_t)((left - 1) / 1000);
+        if (n > CUE_TICKS) n = CUE_TICKS;
+        cue = SND_TICK;
+        cue_at = end - n * 1000UL;
+    }
+    sched_at(task.expire, cue != SND_COUNT ? cue_at : end);
+}
+
+// Start a channel from its stored time (only a non-zero one)
+static bool start_channel(uint8_t ch) {
+    uint32_t ms = config_ms(&channels[ch]);
+    if (ms == 0) return false;
+    save_preset(PRESET_LAST(ch), &channels[ch]); // Comes back after a power cycle
+    countdown_load(ch, ms);
+    countdown_start(ch, millis());
+    rearm_expire();
+    return true;
+}
+
+static bool act_start(void) {
+    return start_channel(sel);
+}
+
+static bool act_resume(void) {
+    countdown_start(sel, millis());
+    rearm_expire();
+    return true;
+}
+
+static bool act_pause(void) {
+    countdown_pause(sel, millis());
+    rearm_expire();
+    return true;
+}
+
+static bool act_cancel(void) {
+    countdown_cancel(sel);
+    rearm_expire();
+    return true;
+}
+
+static bool act_next_ch(void) {
+    select_channel((uint8_t)((sel + 1) % CD_CHANNELS));
+    label_ch = sel; // Always say where we landed
+    show_label(GLYPH('C'), GLYPH('h'), sel + 1);
+    return true;
+}
+
+// Favourites: long R steps through them into the selected channel,
+// L+M stores the selected channel's time in the one shown last
+static bool act_fav_next(void) {
+    fav = (uint8_t)((fav + 1) % PRESET_FAV_SLOTS);
+    presets_get(PRESET_FAV(fav), cfg);
+    show_label(GLYPH('P'), 0, fav + 1);
+    return true;
+}
+
+static bool act_fav_save(void) {
+    if (fav >= PRESET_FAV_SLOTS) fav = 0;
+    save_preset(PRESET_FAV(fav), cfg);
+    show_label(GLYPH('P'), 0, fav + 1);
+    return true;
+}
+
+static bool act_sw_start(void) { stopwatch_start(millis()); return true; }
+static bool act_sw_stop(void)  { stopwatch_stop(millis()); return true; }
+static bool act_sw_clear(void) { stopwatch_clear(); return true; }
+
+// Service chord (L+M in the stopwatch): trace and counters out on the UART
+static bool act_trace_dump(void) {
+    trace_dump(millis());
+    sched_at(task.trace, millis());
+    anim_play(&anim_spinner, millis()); // Until the dump is out
+    return true;
+}
+
+// Into the settings from IDLE: say so before the digits come up
+static bool act_set_enter(void) {
+    anim_play(&anim_set, millis());
+    return true;
+}
+
+static bool act_alarm_start(void) {
+    alarm_start(millis(), SND_ALARM(sel)); // Loops until dismissed
+    sched_at(task.alarm, millis());
+    anim_play(&anim_alarm, millis());
+    return true;
+}
+
+static bool act_alarm_stop(void) {
+    alarm_stop();
+    sched_stop(task.alarm);
+    anim_stop();
+    countdown_cancel(sel);
+
+    // Timers that ran out meanwhile are up next
+    uint8_t ch = countdown_find(CD_EXPIRED);
+    if (ch != CD_NONE) select_channel(ch);
+    return true;
+}
+
+typedef enum {
+    ACT_NONE,
+    ACT_HR_DOWN, ACT_HR_UP, ACT_HR_CLEAR,
+    ACT_MIN_DOWN, ACT_MIN_UP, ACT_MIN_CLEAR,
+    ACT_SEC_DOWN, ACT_SEC_UP, ACT_SEC_CLEAR,
+    ACT_START, ACT_RESUME, ACT_PAUSE, ACT_CANCEL, ACT_NEXT_CH,
+    ACT_FAV_NEXT, ACT_FAV_SAVE,
+    ACT_ALARM_START, ACT_ALARM_STOP,
+    ACT_SW_START, ACT_SW_STOP, ACT_SW_CLEAR,
+    ACT_TRACE_DUMP, ACT_SET_ENTER
+} ActionID;
+
+static const ActionFn action_table[] PROGMEM = {
+    [ACT_NONE]        = act_none,
+    [ACT_HR_DOWN]     = act_hr_down,
+    [ACT_HR_UP]       = act_hr_up,
+    [ACT_HR_CLEAR]    = act_hr_clear,
+    [ACT_MIN_DOWN]    = act_min_down,
+    [ACT_MIN_UP]      = act_min_up,
+    [ACT_MIN_CLEAR]   = act_min_clear,
+    [ACT_SEC_DOWN]    = act_sec_down,
+    [ACT_SEC_UP]      = act_sec_up,
+    [ACT_SEC_CLEAR]   = act_sec_clear,
+    [ACT_START]       = act_start,
+    [ACT_RESUME]      = act_resume,
+    [ACT_PAUSE]       = act_pause,
+    [ACT_CANCEL]      = act_cancel,
+    [ACT_NEXT_CH]     = act_next_ch,
+    [ACT_FAV_NEXT]    = act_fav_next,
+    [ACT_FAV_SAVE]    = act_fav_save,
+    [ACT_ALARM_START] = act_alarm_start,
+    [ACT_ALARM_STOP]  = act_alarm_stop,
+    [ACT_SW_START]    = act_sw_start,
+    [ACT_SW_STOP]     = act_sw_stop,
+    [ACT_SW_CLEAR]    = act_sw_clear,
+    [ACT_TRACE_DUMP]  = act_trace_dump,
+    [ACT_SET_ENTER]   = act_set_enter,
+};
+
+// --- STATE TABLE ---
+// Per state: entry/exit actions, what the display shows and how it behaves
+#define SF_LIVE        0x01 // Value moves on its own: redraw whenever the view changes
+#define SF_BLINK_COLON 0x04 // Blink phase off = colon hidden (edit mode)
+#define SF_BLINK_ALL   0x08 // Blink phase off = "PAUS" instead of the time
+#define SF_REPEAT_LR   0x10 // L/R auto-repeat while held
+
+typedef enum {
+    VIEW_SOONEST,   // Soonest running channel (with its "Ch n") if any, else the stored time
+    VIEW_SET_HM,    // Stored hours:minutes (editing hours)
+    VIEW_SET_MS,    // Stored minutes:seconds (editing minutes/seconds)
+    VIEW_COUNTDOWN, // Selected channel's remaining time, down to SS.cc (paused)
+    VIEW_STOPWATCH, // Elapsed time, SS.cc for the first minute
+    VIEW_ZERO       // 00:00
+} ViewID;
+
+typedef struct {
+    uint8_t entry;
+    uint8_t exit;
+    uint8_t flags;
+    uint8_t view;
+} StateDesc;
+
+static const StateDesc state_table[NUM_STATES] PROGMEM = {
+    [STATE_IDLE]       = { ACT_NONE,        ACT_NONE,       SF_LIVE,                       VIEW_SOONEST },
+    [STATE_SET_HR]     = { ACT_NONE,        ACT_NONE,       SF_BLINK_COLON | SF_REPEAT_LR, VIEW_SET_HM },
+    [STATE_SET_MIN]    = { ACT_NONE,        ACT_NONE,       SF_BLINK_COLON | SF_REPEAT_LR, VIEW_SET_MS },
+    [STATE_SET_SEC]    = { ACT_NONE,        ACT_NONE,       SF_BLINK_COLON | SF_REPEAT_LR, VIEW_SET_MS },
+    [STATE_RUNNING]    = { ACT_NONE,        ACT_NONE,       SF_LIVE,                       VIEW_SOONEST },
+    [STATE_PAUSED]     = { ACT_NONE,        ACT_NONE,       SF_BLINK_ALL,                  VIEW_COUNTDOWN },
+    [STATE_ALARM]      = { ACT_ALARM_START, ACT_ALARM_STOP, 0,                             VIEW_ZERO }, // Animated
+    [STATE_STOPWATCH]  = { ACT_NONE,        ACT_NONE,       0,                             VIEW_STOPWATCH },
+    [STATE_SW_RUNNING] = { ACT_SW_START,    ACT_SW_STOP,    SF_LIVE,                       VIEW_STOPWATCH },
+};
+
+// --- TRANSITION TABLE ---
+// state x event -> action, next state. ST_SAME = stay (no exit/entry),
+// ST_CHANNEL = whatever state the selected channel is in (exit/entry always
+// run, e.g. one alarm handing over to the next).
+#define ST_SAME    0xFF
+#define ST_CHANNEL 0xFE
+
+typedef struct {
+    uint8_t action;
+    uint8_t next;
+} Transition;
+
+#define T(act, next) { ACT_##act, next }
+#define NOP          { ACT_NONE, ST_SAME }
+#define CH(act)      T(act, ST_CHANNEL)
+
+static const Transition transition_table[NUM_STATES][NUM_EVENTS] PROGMEM = {
+    //                     EV_L                         EV_M                       EV_R                         EV_CHORD_LR            EV_CHORD_MR  EV_CHORD_LM             EV_LONG_L                   EV_LONG_M                 EV_LONG_R             EV_OTHER  EV_EXPIRED
+    [STATE_IDLE]       = { T(SET_ENTER, STATE_SET_MIN), T(START, STATE_RUNNING),   T(SET_ENTER, STATE_SET_SEC), NOP,                   CH(NEXT_CH), T(FAV_SAVE, ST_SAME),   T(SET_ENTER, STATE_SET_HR), T(NONE, STATE_STOPWATCH), T(FAV_NEXT, ST_SAME), NOP,      CH(NONE) },
+    [STATE_SET_HR]     = { T(HR_DOWN, ST_SAME),         T(NONE, STATE_SET_MIN),    T(HR_UP, ST_SAME),           T(HR_CLEAR, ST_SAME),  NOP,         NOP,                    NOP,                        NOP,                      NOP,                  NOP,      CH(NONE) },
+    [STATE_SET_MIN]    = { T(MIN_DOWN, ST_SAME),        T(NONE, STATE_SET_SEC),    T(MIN_UP, ST_SAME),          T(MIN_CLEAR, ST_SAME), NOP,         NOP,                    NOP,                        NOP,                      NOP,                  NOP,      CH(NONE) },
+    [STATE_SET_SEC]    = { T(SEC_DOWN, ST_SAME),        T(NONE, STATE_IDLE),       T(SEC_UP, ST_SAME),          T(SEC_CLEAR, ST_SAME), NOP,         NOP,                    NOP,                        NOP,                      NOP,                  NOP,      CH(NONE) },
+    [STATE_RUNNING]    = { NOP,                         T(PAUSE, STATE_PAUSED),    NOP,                         T(CANCEL, STATE_IDLE), CH(NEXT_CH), NOP,                    NOP,                        NOP,                      NOP,                  NOP,      CH(NONE) },
+    [STATE_PAUSED]     = { T(CANCEL, STATE_IDLE),       T(RESUME, STATE_RUNNING),  T(CANCEL, STATE_IDLE),       T(CANCEL, STATE_IDLE), CH(NEXT_CH), NOP,                    NOP,                        NOP,                      NOP,                  NOP,      CH(NONE) },
+    [STATE_ALARM]      = { CH(NONE),                    CH(NONE),                  CH(NONE),                    CH(NONE),              CH(NONE),    CH(NONE),               CH(NONE),                   CH(NONE),                 CH(NONE),             CH(NONE), NOP },
+    [STATE_STOPWATCH]  = { T(SW_CLEAR, ST_SAME),        T(NONE, STATE_SW_RUNNING), T(NONE, STATE_IDLE),         T(NONE, STATE_IDLE),   NOP,         T(TRACE_DUMP, ST_SAME), NOP,                        T(NONE, STATE_IDLE),      NOP,                  NOP,      CH(NONE) },
+    [STATE_SW_RUNNING] = { NOP,                         T(NONE, STATE_STOPWATCH),  NOP,                         T(NONE, STATE_IDLE),   NOP,         NOP,                    NOP,                        NOP,                      NOP,                  NOP,      CH(NONE) },
+};
+
+// UI state the selected channel is in
+static TimerState channel_state(void) {
+    switch (countdown_status(sel)) {
+        case CD_RUNNING: return STATE_RUNNING;
+        case CD_PAUSED:  return STATE_PAUSED;
+        case CD_EXPIRED: return STATE_ALARM;
+        default:         return STATE_IDLE;
+    }
+}
+
+static bool run_action(uint8_t id) {
+    ActionFn fn = (ActionFn)pgm_read_ptr(&action_table[id]);
+    return fn();
+}
+
+static void enter_state(TimerState s) {
+    trace(TR_STATE, s);
+    uint8_t flags = pgm_read_byte(&state_table[s].flags);
+
+    gestures_set_repeat((flags & SF_REPEAT_LR) ? (GESTURE_BIT(BTN_L) | GESTURE_BIT(BTN_R)) : 0);
+
+    // Blink only runs in states that show it
+    blink_on = true;
+    if (flags & (SF_BLINK_COLON | SF_BLINK_ALL)) sched_at(task.blink, millis() + 500);
+    else                                         sched_stop(task.blink);
+
+    run_action(pgm_read_byte(&state_table[s].entry));
+}
+
+// O(1): one table lookup, then only the actions of this transition
+static void fsm_dispatch(UiEvent ev) {
+    uint8_t action = pgm_read_byte(&transition_table[currentState][ev].action);
+    uint8_t next   = pgm_read_byte(&transition_table[currentState][ev].next);
+
+    if (action == ACT_NONE && next == ST_SAME) return;
+    if (!run_action(action)) return; // Guard said no
+
+    if (next == ST_CHANNEL) {
+        // Exit first: it may hand over to another channel (alarm queue)
+        run_action(pgm_read_byte(&state_table[currentState].exit));
+        currentState = channel_state();
+        enter_state(currentState);
+    }
+    else if (next != ST_SAME && next != currentState) {
+        run_action(pgm_read_byte(&state_table[currentState].exit));
+        currentState = (TimerState)next;
+        enter_state(currentState);
+    }
+    display_dirty();
+}
 
 // --- DISPLAY LOGIC ---
-void refresh_display(void) {
-    uint32_t now = millis();
+// Returns the ms until the shown value changes (0 = it won't by itself)
+uint32_t refresh_display(uint32_t now) {
+    BENCH_ENTER(BENCH_DISPLAY);
+    uint8_t flags = pgm_read_byte(&state_table[currentState].flags);
     bool show_colon = true;
-    
-    // 500ms Slow Blink for UI
-    if (now - last_blink_time >= 500) {
-        blink_on = !blink_on;
-        last_blink_time = now;
+    TimeView v = { cfg->min, cfg->sec, TIME_MMSS };
+    uint8_t ch = sel; // Channel whose time is shown
+    uint32_t until = 0;
+
+    switch (pgm_read_byte(&state_table[currentState].view)) {
+        case VIEW_SOONEST:
+            ch = countdown_next(0);
+            if (ch != CD_NONE) {
+                until = time_view(countdown_remaining(ch, now), TIME_VIEW_CENTIS, &v);
+            } else {
+                ch = sel;
+                time_view(stored_ms(), 0, &v);
+            }
+            break;
+        case VIEW_SET_HM:
+            v.hi = cfg->hr;
+            v.lo = cfg->min;
+            break;
+        case VIEW_COUNTDOWN:
+            until = time_view(countdown_remaining(sel, now), TIME_VIEW_CENTIS, &v);
+            break;
+        case VIEW_STOPWATCH: {
+            uint32_t t = stopwatch_elapsed(now);
+            until = time_view(t, TIME_VIEW_UP | TIME_VIEW_CENTIS, &v);
+            if (t >= STOPWATCH_MAX_MS) until = 0; // Pinned at the maximum
+            ch = label_ch; // Not a channel
+            break;
+        }
+        case VIEW_ZERO:
+            v.hi = 0;
+            v.lo = 0;
+            break;
+        default: // VIEW_SET_MS
+            break;
+    }
+    if (!(flags & SF_LIVE)) until = 0;
+
+    // Channel indicator (a label already up runs its course first)
+    if (ch != label_ch && !label_on) {
+        label_ch = ch;
+        show_label(GLYPH('C'), GLYPH('h'), ch + 1);
+    }
+    if (label_on) {
+        int32_t left = (int32_t)(label_until - now);
+        if (left > 0) {
+            tm1637_display_segments(label_seg[0], label_seg[1], 0, tm1637_digit(label_num));
+            BENCH_EXIT(BENCH_DISPLAY);
+            return (uint32_t)left;
+        }
+        label_on = false;
     }
 
-    uint8_t d_min = (currentState == STATE_RUNNING || currentState == STATE_PAUSED) ? live_min : stored_min;
-    uint8_t d_sec = (currentState == STATE_RUNNING || currentState == STATE_PAUSED) ? live_sec : stored_sec;
+    // Animation playing: its frames instead of the view
+    if (anim_active()) {
+        uint32_t next = anim_update(now);
+        if (next) {
+            BENCH_EXIT(BENCH_DISPLAY);
+            return next;
+        }
+    }
 
     // Visual Feedback based on State
-    if (currentState == STATE_SET_MIN && !blink_on) {
-        // While setting minutes, we could blank them or just blink colon rapidly
-        // Let's blink the colon to indicate Edit Mode
-        show_colon = false; 
+    if (!blink_on) {
+        if (flags & SF_BLINK_ALL) {
+            // Paused: time and "PAUS" take turns
+            anim_text(text_paused);
+            BENCH_EXIT(BENCH_DISPLAY);
+            return until;
+        }
+        // Blink the colon to indicate Edit Mode
+        if (flags & SF_BLINK_COLON) show_colon = false;
     }
-    else if (currentState == STATE_SET_SEC && !blink_on) {
-        show_colon = false;
+
+    tm1637_display_time(v.hi, v.lo, show_colon);
+    BENCH_EXIT(BENCH_DISPLAY);
+    return until;
+}
+
+// TIMER FINISHED: every channel due by now is marked expired; the first
+// one gets the alarm unless one is already sounding (the rest queue up)
+static void expire_task(uint32_t now) {
+    if (cue != SND_COUNT && (int32_t)(now - cue_at) >= 0 && currentState != STATE_ALARM) {
+        media_play((MediaSound)cue);
     }
-    else if (currentState == STATE_PAUSED && !blink_on) {
-        // Flash entire display in Pause
-        tm1637_display_segments(0,0,0,0); 
+
+    uint8_t first = countdown_expire(now);
+    while (countdown_expire(now) != CD_NONE);
+    rearm_expire();
+
+    if (first != CD_NONE && currentState != STATE_ALARM) {
+        select_channel(first);
+        fsm_dispatch(EV_EXPIRED);
+    }
+}
+
+static void blink_task(uint32_t now) {
+    (void)now;
+    blink_on = !blink_on;
+    display_dirty();
+}
+
+// Live states redraw exactly when the view changes: once a second (or
+// minute) in MM:SS / HH:MM, every 10 ms in SS.cc. Frames are only queued
+// for the TM1637 interrupt engine, so 100 fps costs a few us per frame here.
+static void display_task(uint32_t now) {
+    uint32_t until = refresh_display(now);
+    if (until) sched_at(task.display, now + until);
+}
+
+static void audio_task(uint32_t now) {
+    (void)now;
+    DF_Update();
+}
+
+static void alarm_task(uint32_t now) {
+    uint32_t next;
+    if (alarm_update(now, &next)) sched_at(task.alarm, next);
+}
+
+static void presets_task(uint32_t now) {
+    uint32_t next;
+    if (presets_update(now, &next)) sched_at(task.presets, next);
+}
+
+static void trace_task(uint32_t now) {
+    if (trace_dump_poll()) {
+        sched_at(task.trace, now + 10); // ~10 bytes at 9600 baud
         return;
     }
-    else if (currentState == STATE_ALARM) {
-         // Flash "00:00" rapidly
-         if (!blink_on) {
-             tm1637_display_segments(0,0,0,0);
-             return;
-         }
-         d_min = 0; d_sec = 0;
+    if (anim_playing(&anim_spinner)) {
+        anim_stop(); // Dump complete
+        display_dirty();
     }
+}
 
-    tm1637_display_time(d_min, d_sec, show_colon);
+static void audio_notify(uint32_t due) {
+    sched_at(task.audio, due);
 }
 
-int main(void) {
-    // 1. Hardware Initialization via IO_MAP
+static void idle_task(uint32_t now) {
+    if (currentState != STATE_IDLE) return;
+    if (countdown_next(0) != CD_NONE || presets_busy() || trace_dumping()) {
+        sched_at(task.idle, now + POWER_DOWN_TIMEOUT_MS); // Timers running / EEPROM write / dump due
+        return;
+    }
+    power_request_down(); // Nobody around: save the battery
+}
+
+// Gesture -> state machine event
+static UiEvent gesture_event(const Gesture *g) {
+    if (g->kind == GESTURE_SHORT || g->kind == GESTURE_REPEAT) {
+        if (g->button == BTN_L) return EV_L;
+        if (g->button == BTN_M) return EV_M;
+        if (g->button == BTN_R) return EV_R;
+    }
+    if (g->kind == GESTURE_LONG) {
+        if (g->button == BTN_L) return EV_LONG_L;
+        if (g->button == BTN_M) return EV_LONG_M;
+        if (g->button == BTN_R) return EV_LONG_R;
+    }
+    if (g->kind == GESTURE_CHORD && g->mask == GESTURE_CHORD_LR) return EV_CHORD_LR;
+    if (g->kind == GESTURE_CHORD && g->mask == GESTURE_CHORD_MR) return EV_CHORD_MR;
+    if (g->kind == GESTURE_CHORD && g->mask == GESTURE_CHORD_LM) return EV_CHORD_LM;
+    return EV_OTHER;
+}
+
+// --- HOST CONTROL ---
+// Commands from host.c, run between two loop passes. They work on any
+// channel; follow_channel() then brings the UI in line if it is showing
+// the selected channel (settings and the stopwatch are left alone).
+static bool channel_view(void) {
+    return currentState == STATE_IDLE || currentState == STATE_RUNNING ||
+           currentState == STATE_PAUSED || currentState == STATE_ALARM;
+}
+
+// Its stored time is being edited on the buttons (cfg points at it)
+static bool editing(uint8_t ch) {
+    return ch == sel && (currentState == STATE_SET_HR || currentState == STATE_SET_MIN ||
+                         currentState == STATE_SET_SEC);
+}
+
+static void follow_channel(void) {
+    if (!channel_view() || channel_state() == currentState) return;
+    // As ST_CHANNEL: exit first, a stopped alarm hands over to the next
+    run_action(pgm_read_byte(&state_table[currentState].exit));
+    currentState = channel_state();
+    enter_state(currentState);
+}
+
+static bool host_time(const uint8_t *t, PresetTime *out) {
+    if (t[0] > 99 || t[1] > 59 || t[2] > 59) return false;
+    out->hr = t[0];
+    out->min = t[1];
+    out->sec = t[2];
+    return true;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t v) {
+    *p++ = (uint8_t)v;
+    *p++ = (uint8_t)(v >> 8);
+    return p;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v) {
+    p = put16(p, (uint16_t)v);
+    return put16(p, (uint16_t)(v >> 16));
+}
+
+static uint8_t host_op(uint8_t op, const uint8_t *arg, uint8_t *out) {
+    uint32_t now = millis();
+    PresetTime t;
+
+    switch (op) {
+        case HOST_OP_SET:
+            if (arg[0] >= CD_CHANNELS || !host_time(&arg[1], &t)) return HOST_ERR_ARG;
+            if (editing(arg[0])) return HOST_ERR_BUSY;
+            channels[arg[0]] = t;
+            save_preset(PRESET_LAST(arg[0]), &t);
+            return HOST_OK;
+
+        case HOST_OP_START:
+            if (arg[0] >= CD_CHANNELS) return HOST_ERR_ARG;
+            if (countdown_status(arg[0]) == CD_PAUSED) {
+                countdown_start(arg[0], now);
+                rearm_expire();
+                return HOST_OK;
+            }
+            if (countdown_status(arg[0]) != CD_IDLE) return HOST_ERR_STATE;
+            return start_channel(arg[0]) ? HOST_OK : HOST_ERR_STATE;
+
+        case HOST_OP_PAUSE:
+            if (arg[0] >= CD_CHANNELS) return HOST_ERR_ARG;
+            if (countdown_status(arg[0]) != CD_RUNNING) return HOST_ERR_STATE;
+            countdown_pause(arg[0], now);
+            rearm_expire();
+            return HOST_OK;
+
+        case HOST_OP_STOP:
+            if (arg[0] >= CD_CHANNELS) return HOST_ERR_ARG;
+            countdown_cancel(arg[0]);
+            rearm_expire();
+            return HOST_OK;
+
+        case HOST_OP_SELECT:
+            if (arg[0] >= CD_CHANNELS) return HOST_ERR_ARG;
+            if (!channel_view() || currentState == STATE_ALARM) return HOST_ERR_STATE;
+            select_channel(arg[0]);
+            return HOST_OK;
+
+        case HOST_OP_FAV_SET:
+            if (arg[0] >= PRESET_FAV_SLOTS || !host_time(&arg[1], &t)) return HOST_ERR_ARG;
+            save_preset(PRESET_FAV(arg[0]), &t);
+            return HOST_OK;
+
+        case HOST_OP_FAV_LOAD:
+            if (arg[0] >= CD_CHANNELS || arg[1] >= PRESET_FAV_SLOTS) return HOST_ERR_ARG;
+            if (editing(arg[0])) return HOST_ERR_BUSY;
+            presets_get(PRESET_FAV(arg[1]), &channels[arg[0]]);
+            return HOST_OK;
+
+        case HOST_OP_STATE:
+            *out++ = currentState;
+            *out++ = sel;
+            *out++ = CD_CHANNELS;
+            for (uint8_t ch = 0; ch < CD_CHANNELS; ch++) {
+                *out++ = countdown_status(ch);
+                out = put32(out, countdown_remaining(ch, now));
+            }
+            return HOST_OK;
+
+        case HOST_OP_COUNTERS: {
+            // Host link, then the DFPlayer link and its command queue
+            // (HOST_COUNTER_BYTES)
+            HostStats hs;
+            DF_Stats ds;
+            host_get_stats(&hs);
+            DF_GetStats(&ds);
+            out = put16(out, hs.packets);
+            out = put16(out, hs.errors);
+            out = put16(out, hs.dropped);
+            out = put16(out, hs.repeats);
+            out = put16(out, hs.timeouts);
+            *out++ = UART_RxOverruns();
+            out = put16(out, ds.failed);
+            out = put16(out, ds.timeouts);
+            out = put16(out, ds.rx_bad);
+            *out++ = DF_QueueHighWater();
+            *out = DF_QueueDropped();
+            return HOST_OK;
+        }
+
+        case HOST_OP_POWER: {
+            // Tags are the UI states (power_sleep(currentState))
+            PowerStats ps;
+            if (arg[0] >= POWER_MAX_TAGS) return HOST_ERR_ARG;
+            power_get_stats(arg[0], &ps);
+            out = put32(out, ps.awake);
+            out = put32(out, ps.asleep);
+            out = put32(out, ps.powerdown_s);
+            put16(out, ps.sleeps);
+            return HOST_OK;
+        }
+
+        case HOST_OP_DISPLAY: {
+            TM1637_Stats ts;
+            tm1637_get_stats(&ts);
+            out = put32(out, ts.bytes_requested);
+            out = put32(out, ts.bytes_sent);
+            out = put32(out, ts.frames_skipped);
+            out = put32(out, ts.frames_replaced);
+            put16(out, ts.ack_failures);
+            return HOST_OK;
+        }
+
+        default:
+            return HOST_ERR_OP;
+    }
+}
+
+// After every command, so the next one in the batch sees the UI state
+static uint8_t host_command(uint8_t op, const uint8_t *arg, uint8_t *out) {
+    uint8_t status = host_op(op, arg, out);
+    follow_channel();
+    return status;
+}
+
+// --- RESET RECOVERY ---
+// Taken on every loop pass, so a reset loses at most the time the reset
+// itself took (estimated by recovery_init())
+static void snapshot(void) {
+    RecoverySnapshot *s = recovery_snapshot();
+    uint32_t now = millis();
+    s->state = currentState;
+    s->channel = sel;
+    for (uint8_t ch = 0; ch < CD_CHANNELS; ch++) {
+        s->status[ch] = countdown_status(ch);
+        s->left[ch] = countdown_remaining(ch, now);
+    }
+    recovery_commit();
+}
+
+// Put the channels back as the snapshot had them. Whatever ran out while
+// the MCU was down (or had already rung) goes in with 0 ms left and
+// expires on the first pass, which brings the alarm back up.
+static void resume(const RecoverySnapshot *s, uint16_t lost_ms) {
+    uint32_t gone = lost_ms + millis();
+    for (uint8_t ch = 0; ch < CD_CHANNELS; ch++) {
+        uint32_t left = s->left[ch];
+
+        switch (s->status[ch]) {
+            case CD_RUNNING:
+                countdown_load(ch, left > gone ? left - gone : 0);
+                countdown_start(ch, millis());
+                break;
+            case CD_EXPIRED:
+                countdown_load(ch, 0);
+                countdown_start(ch, millis());
+                break;
+            case CD_PAUSED:
+                countdown_load(ch, left);
+                break;
+            default:
+                break;
+        }
+    }
+    if (s->channel < CD_CHANNELS) select_channel(s->channel);
+    rearm_expire();
+    // Stopwatch and setting states aren't worth keeping: back to the
+    // selected channel's state
+    currentState = channel_state();
+}
+
+void app_init(uint8_t reset_cause) {
+    // Reset recovery first, before anything touches the timers
+    RecoverySnapshot snap;
+    uint16_t lost_ms = 0;
+    uint8_t warm = recovery_init(reset_cause, &snap, &lost_ms);
+    trace_init(reset_cause);
+    trace(TR_BOOT, reset_cause);
+
+    // Staged boot: the display and the buttons come up first so the UI is
+    // live within milliseconds; the DFPlayer finishes booting in the
+    // background (DF_BootStatus()/DF_ReadyTime()).
+
+    // 0. Clock: load the oscillator calibration (only the very first boot
+    //    of a board spends ~1 s here, crystal fitted or not; see calib.h)
+    calib_init();
+
+    // 1. Timebase, display and buttons (UI)
+    timer_set_rate(calib_ticks_per_ms());
     timer_init();
+    tm1637_init(); // TM1637 Init (using pins from io_map.h)
     buttons_init();
-    UART_Init();
-    
-    // TM1637 Init (using pins from io_map.h)
-    tm1637_init();
+    gestures_init();
+
+    // Scheduler: deadline-ordered, worst-case timing recorded per task
+    task.expire  = sched_add(expire_task, 0, 10);
+    task.blink   = sched_add(blink_task, 500, 50);
+    task.display = sched_add(display_task, 0, 20);
+    task.audio   = sched_add(audio_task, 0, 20);
+    task.idle    = sched_add(idle_task, 0, 1000);
+    task.alarm   = sched_add(alarm_task, 0, 100);
+    task.presets = sched_add(presets_task, 0, 1000);
+    task.trace   = sched_add(trace_task, 0, 100);
+
+    // Last-used times and favourites from EEPROM
+    presets_init();
+    for (uint8_t ch = 0; ch < CD_CHANNELS; ch++) presets_get(PRESET_LAST(ch), &channels[ch]);
 
-    // DFPlayer Init
-    DF_Init();
+    // Watchdog or brown-out reset with timers running: carry on
+    if (warm) resume(&snap, lost_ms);
+
+    enter_state(currentState);
+    display_dirty(); // First frame goes out on the first loop pass
+
+    // 2. Power management and audio
+    power_init();
+    UART_Init(calib_ubrr());
+    host_init(host_command); // Bench PC / controller on RXD (host.h)
+
+    // DFPlayer Init (non-blocking, commands wait in the queue until it has booted)
+    DF_SetNotify(audio_notify);
+    if (warm) DF_InitWarm(); // The module didn't reset with us
+    else      DF_Init();
     DF_SetVolume(18);
+    media_init(warm); // SD card catalogue: one query if the card is known
 
-    while (1) {
-        ButtonID btn = buttons_read();
-        uint32_t now = millis();
-
-        switch (currentState) {
-            // --- IDLE STATE ---
-            case STATE_IDLE:
-                if (btn == BTN_L) {
-                    currentState = STATE_SET_MIN; // Shortcut to Min
-                } 
-                else if (btn == BTN_R) {
-                    currentState = STATE_SET_SEC; // Shortcut to Sec
-                } 
-                else if (btn == BTN_M) {
-                    // Start Timer
-                    if (stored_min > 0 || stored_sec > 0) {
-                        live_min = stored_min;
-                        live_sec = stored_sec;
-                        currentState = STATE_RUNNING;
-                        last_tick_time = now;
-                    }
-                }
-                break;
+    sched_at(task.idle, millis() + POWER_DOWN_TIMEOUT_MS);
+}
 
-            // --- CONFIGURATION STATES ---
-            case STATE_SET_MIN:
-                // L = Down, R = Up, M = Accept (Go to Sec)
-                if (btn == BTN_L) {
-                    if (stored_min == 0) stored_min = 99; else stored_min--;
-                } 
-                else if (btn == BTN_R) {
-                    if (stored_min >= 99) stored_min = 0; else stored_min++;
-                } 
-                else if (btn == BTN_M) {
-                    currentState = STATE_SET_SEC; 
-                }
-                break;
+void app_poll(void) {
+    Gesture g;
+    BENCH_STATE(currentState);
+    BENCH_ENTER(BENCH_LOOP);
+    trace_time(millis());
 
-            case STATE_SET_SEC:
-                // L = Down, R = Up, M = Accept (Go to IDLE)
-                if (btn == BTN_L) {
-                    if (stored_sec == 0) stored_sec = 59; else stored_sec--;
-                } 
-                else if (btn == BTN_R) {
-                    if (stored_sec >= 59) stored_sec = 0; else stored_sec++;
-                } 
-                else if (btn == BTN_M) {
-                    currentState = STATE_IDLE; 
-                }
-                break;
+    if (gestures_poll(&g, millis())) {
+        trace(TR_GESTURE, (uint8_t)(g.kind << 4 | g.mask));
+        power_activity();
+        sched_at(task.idle, millis() + POWER_DOWN_TIMEOUT_MS);
+        anim_stop(); // Any button cuts an animation short (the alarm's
+                     // goes with the state anyway)
+        display_dirty();
+        fsm_dispatch(gesture_event(&g));
+    }
 
-            // --- RUNNING STATE ---
-            case STATE_RUNNING:
-                // M = Pause
-                if (btn == BTN_M) {
-                    currentState = STATE_PAUSED;
-                }
-                // (Optional: BTN_L could be Stop/Reset if desired, keeping simple for now)
-
-                // Timer Logic
-                if (now - last_tick_time >= 1000) {
-                    last_tick_time += 1000;
-                    
-                    if (live_sec == 0) {
-                        if (live_min == 0) {
-                            // TIMER FINISHED
-                            currentState = STATE_ALARM;
-                            DF_PlayTrack(1); // Play Alarm Sound
-                        } else {
-                            live_min--;
-                            live_sec = 59;
-                        }
-                    } else {
-                        live_sec--;
-                    }
-                }
-                break;
+    DF_Poll(); // Status frames from the module
+    media_poll(millis());
+    if (host_poll()) {
+        power_activity(); // Somebody is around
+        sched_at(task.idle, millis() + POWER_DOWN_TIMEOUT_MS);
+        display_dirty();
+    }
+    sched_run();
+    BENCH_EXIT(BENCH_LOOP);
 
-            // --- PAUSED STATE ---
-            case STATE_PAUSED:
-                // M = Resume, L/R = Reset to IDLE?
-                if (btn == BTN_M) {
-                    currentState = STATE_RUNNING;
-                    last_tick_time = now; // Prevent jump
-                } 
-                else if (btn == BTN_L || btn == BTN_R) {
-                    currentState = STATE_IDLE; // Reset
-                }
-                break;
+    // Pass done: record where the timers are, then prove we're alive
+    snapshot();
+    recovery_kick();
 
-            // --- ALARM STATE ---
-            case STATE_ALARM:
-                // "Until any button is pressed"
-                if (btn != BTN_NONE) {
-                    DF_Pause(); // Stop Sound Immediately
-                    currentState = STATE_IDLE;
-                    // Reset live values is implied by reloading from 'stored' next run
-                }
-                // Note: If track finishes, DFPlayer stops. 
-                // Ideally, use a looping track or send Loop Command if supported.
-                break;
-        }
+    // Nothing left to do until the next interrupt (button, deadline, bus)
+    if (power_sleep(currentState)) {
+        // Woke from power-down
+        sched_at(task.idle, millis() + POWER_DOWN_TIMEOUT_MS);
+    }
+}
+
+uint8_t app_state(void) {
+    return currentState;
+}
+
+uint8_t app_channel(void) {
+    return sel;
+}
+
+uint8_t app_channel_bytes(void) {
+    return sizeof(ChannelConfig) + countdown_channel_bytes();
+}
 
-        refresh_display();
+// The host simulator (env:native) brings its own main() and drives app_poll()
+#ifndef DAMKA_SIM
+int main(void) {
+    // The reset cause has to be read before anything clears it, and a
+    // watchdog reset leaves the watchdog running (at its shortest period)
+    uint8_t cause = MCUSR;
+    MCUSR = 0;
+    wdt_disable();
+    app_init(cause);
+    while (1) {
+        app_poll();
     }
-}
\ No newline at end of file
+}
+#endif
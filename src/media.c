@@ -0,0 +1,261 @@
+#include "media.h"
+#include "dfplayer.h"
+#include "eewrite.h"
+#include "eeprom_map.h"
+
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <stddef.h>
+#include <string.h>
+
+// --- SOUNDS ---
+typedef struct {
+    uint8_t folder; // 01-MEDIA_FOLDERS
+    uint8_t track;
+    uint8_t root;   // Root index if that file isn't on the card (0 = silent)
+} MediaEntry;
+
+static const MediaEntry sound_table[SND_COUNT] PROGMEM = {
+    [SND_ALARM_1]  = { 1, 1, 1 },
+    [SND_ALARM_2]  = { 1, 2, 3 },
+    [SND_ALARM_3]  = { 1, 3, 4 },
+    [SND_ALARM_4]  = { 1, 4, 5 },
+    [SND_ESCALATE] = { 2, 1, 2 },
+    [SND_WARNING]  = { 2, 2, 0 },
+    [SND_TICK]     = { 2, 3, 0 },
+};
+
+// --- CATALOGUE (EE_MEDIA_ADDR) ---
+#define MEDIA_MAGIC 0xC5 // Anything but erased
+
+typedef struct {
+    uint16_t files;                // Fingerprint: files on the card
+    uint8_t  magic;
+    uint8_t  folders;              // Folders on the card
+    uint8_t  count[MEDIA_FOLDERS]; // Files in folders 01.. (0: none, or not asked)
+    uint8_t  crc;                  // CRC-8 over everything above
+} MediaCatalogue;
+
+_Static_assert(sizeof(MediaCatalogue) <= EE_MEDIA_SIZE, "catalogue does not fit its region");
+_Static_assert(sizeof(MediaCatalogue) <= EEWRITE_MAX, "catalogue too big for the writer");
+
+static MediaCatalogue cat;
+static uint8_t cached = 0;   // 'cat' matches the EEPROM copy and its CRC
+static uint8_t usable = 0;   // 'cat' describes the card in the module
+static uint8_t save = 0;     // 'cat' to be written once the writer is free
+static MediaStatus status = MEDIA_NONE;
+
+// Query waiting for its reply (0 = none)
+static uint8_t waiting = 0;
+static uint8_t asked;        // Folder being counted
+static uint32_t wait_from;
+
+// Fingerprint past the total: the file counts of the folders the sound
+// table uses (01..key_folders) have to match the cached ones as well
+static uint8_t key_folders;
+static uint8_t checking = 0; // Comparing those with 'cat'
+
+// Last sound started, played again by root index if its file is missing
+static MediaSound last;
+static uint8_t last_loop;
+static uint8_t last_folder = 0; // It went by folder and file
+
+static uint8_t cat_crc(void) {
+    const uint8_t *p = (const uint8_t *)&cat;
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < offsetof(MediaCatalogue, crc); i++) crc = _crc8_ccitt_update(crc, p[i]);
+    return crc;
+}
+
+static void ask(uint8_t query, uint16_t param) {
+    DF_Query(query, param);
+    waiting = query;
+}
+
+// Fingerprint first: the rest only if the card turns out to be another one
+static void query_card(void) {
+    usable = 0;
+    checking = 0;
+    status = MEDIA_QUERYING;
+    ask(DF_QUERY_SD_FILES, 0);
+}
+
+static void scan(uint16_t files) {
+    memset(&cat, 0, sizeof(cat));
+    cat.files = files;
+    cached = 0;
+    checking = 0;
+    status = MEDIA_SCANNING;
+    ask(DF_QUERY_FOLDERS, 0);
+}
+
+static void next_check(void) {
+    if (asked < key_folders) {
+        ask(DF_QUERY_FOLDER_FILES, ++asked);
+        return;
+    }
+    checking = 0;
+    usable = 1;
+    status = MEDIA_CACHED;
+}
+
+static void next_folder(void) {
+    if (asked < cat.folders && asked < MEDIA_FOLDERS) {
+        ask(DF_QUERY_FOLDER_FILES, ++asked);
+        return;
+    }
+    cat.magic = MEDIA_MAGIC;
+    cat.crc = cat_crc();
+    cached = 1;
+    usable = 1;
+    save = 1;
+    status = MEDIA_SCANNED;
+}
+
+static uint8_t clip(uint16_t n) {
+    return n > 0xFF ? 0xFF : (uint8_t)n;
+}
+
+static void start(MediaSound s, uint8_t repeat);
+
+static void answer(uint8_t query, uint16_t param) {
+    switch (query) {
+        case DF_QUERY_SD_FILES:
+            if (cached && cat.files == param) {
+                checking = 1;
+                asked = 0;
+                next_check();
+                return;
+            }
+            scan(param);
+            break;
+
+        case DF_QUERY_FOLDERS:
+            cat.folders = clip(param);
+            asked = 0;
+            next_folder();
+            break;
+
+        default: // DF_QUERY_FOLDER_FILES
+            if (!checking) {
+                cat.count[asked - 1] = clip(param);
+                next_folder();
+            } else if (clip(param) == cat.count[asked - 1]) {
+                next_check();
+            } else {
+                scan(cat.files); // Same total, files moved between folders
+            }
+            break;
+    }
+}
+
+static void on_event(uint8_t evt, uint16_t param) {
+    switch (evt) {
+        case DF_QUERY_SD_FILES:
+        case DF_QUERY_FOLDERS:
+        case DF_QUERY_FOLDER_FILES:
+            if (evt != waiting) break; // Not asked by us (or too late)
+            waiting = 0;
+            answer(evt, param);
+            break;
+
+        case DF_EVT_ERROR:
+            if (param == DF_ERR_BUSY || param == DF_ERR_SERIAL || param == DF_ERR_CHECKSUM) break; // Resent
+            if (waiting == DF_QUERY_FOLDER_FILES) {
+                waiting = 0;
+                answer(DF_QUERY_FOLDER_FILES, 0); // No such folder
+            } else if (waiting) {
+                waiting = 0;
+                status = MEDIA_NONE;
+            } else if (last_folder && (param == DF_ERR_NOT_FOUND || param == DF_ERR_RANGE)) {
+                // The catalogue was wrong about this card (same file count,
+                // other files): root index for now, and count it again
+                cached = 0;
+                usable = 0;
+                start(last, last_loop);
+                query_card();
+            }
+            break;
+
+        case DF_EVT_INSERTED:
+            query_card();
+            break;
+
+        case DF_EVT_REMOVED:
+            usable = 0;
+            waiting = 0;
+            status = MEDIA_NONE;
+            break;
+    }
+}
+
+void media_init(uint8_t warm) {
+    for (uint8_t i = 0; i < SND_COUNT; i++) {
+        uint8_t folder = pgm_read_byte(&sound_table[i].folder);
+        if (folder > key_folders && folder <= MEDIA_FOLDERS) key_folders = folder;
+    }
+
+    eeprom_read_block(&cat, (const void *)EE_MEDIA_ADDR, sizeof(cat));
+    cached = cat.magic == MEDIA_MAGIC && cat.crc == cat_crc();
+    DF_SetEventHandler(on_event);
+
+    if (warm && cached) {
+        // Only we were reset: the module still has the card we last saw
+        usable = 1;
+        status = MEDIA_CACHED;
+        return;
+    }
+    query_card();
+}
+
+void media_poll(uint32_t now) {
+    // Time the reply from when the query has left (it can sit in the
+    // queue through the module's boot)
+    if (waiting) {
+        if (!DF_Idle() || DF_BootStatus() == DF_BOOTING) {
+            wait_from = now;
+        } else if (now - wait_from > MEDIA_REPLY_MS) {
+            waiting = 0;
+            usable = 0;
+            status = MEDIA_NONE;
+        }
+    }
+
+    // Once per new card, in the background; waits while a preset record
+    // is going out
+    if (save && eewrite_start(EE_MEDIA_ADDR, &cat, sizeof(cat), NULL)) save = 0;
+}
+
+static void start(MediaSound s, uint8_t repeat) {
+    const MediaEntry *e = &sound_table[s];
+    uint8_t folder = pgm_read_byte(&e->folder);
+    uint8_t track = pgm_read_byte(&e->track);
+    last = s;
+    last_loop = repeat;
+
+    // The file is there if its folder has at least that many
+    last_folder = usable && folder && folder <= MEDIA_FOLDERS && track <= cat.count[folder - 1];
+    if (last_folder) {
+        if (repeat) DF_LoopFolder(folder, track);
+        else        DF_PlayFolder(folder, track);
+        return;
+    }
+
+    uint8_t root = pgm_read_byte(&e->root);
+    if (!root) return;
+    if (repeat) DF_LoopTrack(root);
+    else        DF_PlayTrack(root);
+}
+
+void media_play(MediaSound s) {
+    start(s, 0);
+}
+
+void media_loop(MediaSound s) {
+    start(s, 1);
+}
+
+MediaStatus media_status(void) {
+    return status;
+}
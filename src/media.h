@@ -0,0 +1,67 @@
+#ifndef MEDIA_H
+#define MEDIA_H
+
+#include <stdint.h>
+
+// Media catalogue on top of the DFPlayer driver. The firmware asks for
+// sounds by what they are for, not by file index: a flash table gives
+// each its folder and file, and the catalogue (files per folder on the
+// card, kept in EEPROM) says whether that file is there, one array lookup
+// per play.
+//
+// Card layout:
+//   01/001.mp3 .. 004.mp3  alarm, timer channels 1-4
+//   02/001.mp3             escalation
+//   02/002.mp3             warning, 10 s before a timer ends
+//   02/003.mp3             tick, each of its last 3 seconds
+// A sound whose file isn't on the card plays by root index instead, as
+// the firmware always did (0001 alarm, 0002 escalation, 0003-0005
+// channels 2-4), so a card with just numbered files keeps working.
+//
+// Boot: the card's fingerprint is its total file count plus the file
+// count of each folder the sound table uses (01-02), one query each. If
+// it matches the cached catalogue that's it; otherwise (first boot,
+// another card, files moved between folders) the folders are counted one
+// query each and the result cached. After an MCU-only reset the module
+// kept its card, so nothing is asked at all. Inserting a card, or a file
+// the catalogue promised not being found, scans again.
+
+#define MEDIA_FOLDERS  8   // Folders 01..08 are catalogued
+#define MEDIA_REPLY_MS 200 // Query sent and nothing back: no card info (root indices)
+
+typedef enum {
+    SND_ALARM_1,  // Per channel, in order
+    SND_ALARM_2,
+    SND_ALARM_3,
+    SND_ALARM_4,
+    SND_ESCALATE,
+    SND_WARNING,  // One-shots, silent without their file
+    SND_TICK,
+    SND_COUNT
+} MediaSound;
+
+#define SND_ALARM(ch) ((MediaSound)(SND_ALARM_1 + (ch)))
+
+typedef enum {
+    MEDIA_QUERYING, // Fingerprint asked, root indices until it's known
+    MEDIA_SCANNING, // New card: counting folders
+    MEDIA_CACHED,   // Catalogue from EEPROM
+    MEDIA_SCANNED,  // Catalogue just counted (and being cached)
+    MEDIA_NONE      // No answers: root indices only
+} MediaStatus;
+
+// After DF_Init()/DF_InitWarm() ('warm' as passed to the driver). Takes
+// over the DFPlayer event handler; the queries wait in the command queue
+// until the module has booted.
+void media_init(uint8_t warm);
+
+// From the main loop: query timeouts, handing the catalogue to the
+// EEPROM writer
+void media_poll(uint32_t now);
+
+void media_play(MediaSound s); // Once
+void media_loop(MediaSound s); // Repeated until the module is paused
+
+MediaStatus media_status(void);
+
+#endif
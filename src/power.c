@@ -0,0 +1,130 @@
+#include "power.h"
+#include "buttons.h"
+#include "dfplayer.h"
+#include "tm1637.h"
+#include "host.h"
+#include "timer.h"
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+static PowerStats stats[POWER_MAX_TAGS];
+static uint16_t awake_rem[POWER_MAX_TAGS];  // Sub-unit remainders (us)
+static uint16_t asleep_rem[POWER_MAX_TAGS];
+
+static uint32_t last_wake_us = 0;
+static uint8_t down_requested = 0;
+static volatile uint8_t wdt_seconds = 0;
+
+// Add 'us' to a counter kept in 1024 us units
+static void account(uint32_t *units, uint16_t *rem, uint32_t us) {
+    us += *rem;
+    *units += us >> 10;
+    *rem = us & 1023;
+}
+
+// Power-down clock: the watchdog keeps running when the timers don't.
+// Awake it is in reset-only mode (recovery.c) and this never runs.
+ISR(WDT_vect) {
+    wdt_seconds++;
+}
+
+void power_init(void) {
+    last_wake_us = micros();
+}
+
+void power_request_down(void) {
+    if (down_requested) return;
+    down_requested = 1;
+    tm1637_set_power(0);
+    DF_Sleep();
+}
+
+void power_activity(void) {
+    if (!down_requested) return;
+    down_requested = 0;
+    DF_Wake();
+    tm1637_set_power(1);
+}
+
+static void enter_idle(uint8_t tag) {
+    uint32_t t0 = micros();
+    account(&stats[tag].awake, &awake_rem[tag], t0 - last_wake_us);
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    cli();
+    // An event or host packet that arrived after the loop polled, or a
+    // deadline that came up while it was being armed, must not wait for
+    // the next unrelated interrupt
+    uint8_t due = timer_take_wake();
+    if (!due && !buttons_pending() && !host_pending()) {
+        sleep_enable();
+        sei();       // The instruction after SEI always runs: no lost wake-up
+        sleep_cpu();
+        sleep_disable();
+        stats[tag].sleeps++;
+    }
+    sei();
+
+    last_wake_us = micros();
+    account(&stats[tag].asleep, &asleep_rem[tag], last_wake_us - t0);
+}
+
+static void enter_power_down(uint8_t tag) {
+    account(&stats[tag].awake, &awake_rem[tag], micros() - last_wake_us);
+
+    buttons_set_wake(1);
+
+    // 1 s watchdog interrupt (no reset) to count the time spent down
+    cli();
+    wdt_seconds = 0;
+    wdt_reset();
+    WDTCSR = (1 << WDCE) | (1 << WDE);
+    WDTCSR = (1 << WDIE) | (1 << WDP2) | (1 << WDP1);
+
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    while (!buttons_pending()) {
+        sleep_enable();
+        sleep_bod_disable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+        stats[tag].sleeps++;
+        cli();
+    }
+
+    wdt_reset();
+    MCUSR &= ~(1 << WDRF);
+    WDTCSR = (1 << WDCE) | (1 << WDE);
+    WDTCSR = 0;
+    sei();
+
+    stats[tag].powerdown_s += wdt_seconds;
+    buttons_set_wake(0);
+
+    // The button that woke us only wakes: drop its events
+    ButtonEvent ev;
+    while (buttons_get_event(&ev));
+
+    down_requested = 0;
+    DF_Wake();
+    tm1637_set_power(1);
+    last_wake_us = micros();
+}
+
+uint8_t power_sleep(uint8_t tag) {
+    if (tag >= POWER_MAX_TAGS) tag = POWER_MAX_TAGS - 1;
+
+    if (down_requested && DF_Idle() && !tm1637_busy()) {
+        enter_power_down(tag);
+        return 1;
+    }
+
+    enter_idle(tag);
+    return 0;
+}
+
+void power_get_stats(uint8_t tag, PowerStats *out) {
+    *out = stats[tag];
+}
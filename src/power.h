@@ -0,0 +1,36 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+
+// --- CONFIGURATION ---
+#define POWER_DOWN_TIMEOUT_MS 60000UL // Idle time in STATE_IDLE before power-down
+#define POWER_MAX_TAGS        9       // Accounting buckets (one per UI state)
+
+// Time awake vs. asleep per tag. Awake/asleep are in units of 1.024 ms
+// (micros() >> 10); power-down time is counted in whole seconds by the
+// watchdog since the timers stop in that mode.
+typedef struct {
+    uint32_t awake;
+    uint32_t asleep;
+    uint32_t powerdown_s;
+    uint16_t sleeps;
+} PowerStats;
+
+void power_init(void);
+
+// End of a main loop pass: sleep (SLEEP_MODE_IDLE) until the next interrupt,
+// or power down if that was requested and audio/display have flushed.
+// 'tag' selects the accounting bucket. Returns 1 after a power-down wake-up.
+uint8_t power_sleep(uint8_t tag);
+
+// Blank the display and send the DFPlayer to sleep; the CPU powers down on
+// the next power_sleep() once that has gone out. Any button wakes it up.
+void power_request_down(void);
+
+// User activity: cancels a power-down that was requested but not entered yet
+void power_activity(void);
+
+void power_get_stats(uint8_t tag, PowerStats *out);
+
+#endif
@@ -0,0 +1,135 @@
+#include "presets.h"
+#include "eeprom_map.h"
+#include "eewrite.h"
+
+#include <avr/eeprom.h>
+#include <stddef.h>
+#include <string.h>
+
+// --- RECORD ---
+// seq 0xFFFF is what an erased record reads as, so it is never written
+#define SEQ_ERASED 0xFFFF
+
+typedef struct {
+    uint16_t   seq;
+    PresetTime slot[PRESET_SLOTS];
+    uint8_t    reserved;
+    uint8_t    crc;       // CRC-8 over everything above
+} PresetRecord;
+
+_Static_assert(sizeof(PresetRecord) == PRESET_RECORD_SIZE, "record layout");
+_Static_assert(sizeof(PresetRecord) <= EEWRITE_MAX, "record too big for the writer");
+
+#define RECORD_SIZE    PRESET_RECORD_SIZE
+#define RECORD_COUNT   (EE_PRESET_SIZE / RECORD_SIZE)
+#define RECORD_ADDR(i) ((uintptr_t)(EE_PRESET_ADDR + (uint16_t)(i) * RECORD_SIZE))
+
+static PresetTime slots[PRESET_SLOTS]; // Live values
+static PresetStats stats;
+static uint8_t dirty = 0;
+static uint32_t settle_at = 0;
+
+static uint8_t crc8(const uint8_t *p, uint8_t len) {
+    uint8_t crc = 0;
+    while (len--) {
+        crc ^= *p++;
+        for (uint8_t i = 0; i < 8; i++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t read_seq(uint8_t i) {
+    uint16_t seq;
+    eeprom_read_block(&seq, (const void *)RECORD_ADDR(i), sizeof(seq));
+    stats.scan_reads += sizeof(seq);
+    return seq;
+}
+
+static uint8_t read_record(uint8_t i, PresetRecord *r) {
+    eeprom_read_block(r, (const void *)RECORD_ADDR(i), RECORD_SIZE);
+    stats.scan_reads += RECORD_SIZE;
+    return r->seq != SEQ_ERASED && r->crc == crc8((const uint8_t *)r, offsetof(PresetRecord, crc));
+}
+
+uint8_t presets_init(void) {
+    PresetRecord r;
+
+    // Records are written in ring order with consecutive sequence numbers
+    // (wrap-safe compare): one pass over the sequence numbers finds the
+    // newest, then walk back only past records with a bad CRC.
+    // Worst case RECORD_COUNT * (2 + RECORD_SIZE) reads.
+    uint8_t newest = 0xFF;
+    uint16_t best = 0;
+    for (uint8_t i = 0; i < RECORD_COUNT; i++) {
+        uint16_t seq = read_seq(i);
+        if (seq == SEQ_ERASED) continue;
+        if (newest == 0xFF || (int16_t)(seq - best) > 0) {
+            newest = i;
+            best = seq;
+        }
+    }
+
+    memset(slots, 0, sizeof(slots));
+    stats.head = RECORD_COUNT - 1; // First save goes to record 0
+    stats.seq = 0;
+
+    for (uint8_t n = 0; newest != 0xFF && n < RECORD_COUNT; n++) {
+        if (read_record(newest, &r)) {
+            memcpy(slots, r.slot, sizeof(slots));
+            stats.head = newest;
+            stats.seq = r.seq;
+            stats.restored = 1;
+            break;
+        }
+        newest = newest ? newest - 1 : (uint8_t)(RECORD_COUNT - 1);
+    }
+    return stats.restored;
+}
+
+void presets_get(uint8_t slot, PresetTime *t) {
+    *t = slots[slot];
+}
+
+void presets_set(uint8_t slot, const PresetTime *t, uint32_t now) {
+    if (!memcmp(&slots[slot], t, sizeof(*t))) return;
+    slots[slot] = *t;
+    if (dirty) stats.coalesced++;
+    dirty = 1;
+    settle_at = now + PRESET_SETTLE_MS;
+}
+
+uint8_t presets_update(uint32_t now, uint32_t *next) {
+    if (!dirty) return 0;
+
+    if (eewrite_busy() || (int32_t)(settle_at - now) > 0) {
+        // Still changing, or the EEPROM is busy (the previous record, or
+        // the media catalogue)
+        *next = eewrite_busy() ? now + 100 : settle_at;
+        return 1;
+    }
+
+    PresetRecord out;
+    out.seq = stats.seq + 1;
+    if (out.seq == SEQ_ERASED) out.seq = 0;
+    memcpy(out.slot, slots, sizeof(slots));
+    out.reserved = 0xFF;
+    out.crc = crc8((const uint8_t *)&out, offsetof(PresetRecord, crc));
+
+    stats.head = (stats.head + 1) % RECORD_COUNT;
+    stats.seq = out.seq;
+    stats.saves++;
+    dirty = 0;
+
+    eewrite_start(RECORD_ADDR(stats.head), &out, RECORD_SIZE, &stats.bytes); // Idle, see above
+    return 0;
+}
+
+uint8_t presets_busy(void) {
+    return dirty || eewrite_busy();
+}
+
+void presets_get_stats(PresetStats *s) {
+    *s = stats;
+}
@@ -0,0 +1,63 @@
+#ifndef PRESETS_H
+#define PRESETS_H
+
+#include <stdint.h>
+#include "eewrite.h"
+
+// Times that survive a power cycle: the last-used time of each timer
+// channel and a few favourites.
+//
+// EEPROM holds an append-only ring of full snapshots, each with a sequence
+// number and a CRC. Every save goes to the next record, so wear is spread
+// over the whole region; at boot the newest record with a good CRC wins
+// (a write cut off by a power loss just falls back to the one before).
+// Saves are coalesced until the values have been stable for
+// PRESET_SETTLE_MS and then handed to the background writer (eewrite.h),
+// so the main loop never waits on the ~3.4 ms per byte.
+
+#define PRESET_LAST_SLOTS 4 // One per timer channel
+#define PRESET_FAV_SLOTS  4
+#define PRESET_SLOTS      (PRESET_LAST_SLOTS + PRESET_FAV_SLOTS)
+
+#define PRESET_LAST(ch) (ch)
+#define PRESET_FAV(i)   (PRESET_LAST_SLOTS + (i))
+
+#define PRESET_SETTLE_MS 3000 // No change for this long -> write
+
+#define PRESET_RECORD_SIZE 28 // seq + slots + reserved + CRC (EE_PRESET_SIZE is a multiple)
+
+typedef struct {
+    uint8_t hr;
+    uint8_t min;
+    uint8_t sec;
+} PresetTime;
+
+typedef struct {
+    uint16_t seq;        // Sequence number of the newest record
+    uint8_t  head;       // Its index in the ring
+    uint8_t  restored;   // A valid record was found at boot
+    uint16_t scan_reads; // EEPROM bytes read by the boot scan
+    uint16_t saves;      // Records written since boot
+    uint16_t coalesced;  // Changes folded into a pending save
+    EewriteCount bytes;  // EEPROM bytes of those records
+} PresetStats;
+
+// Scan the log and load the newest valid snapshot (all zero if none).
+// Returns 1 if one was found.
+uint8_t presets_init(void);
+
+void presets_get(uint8_t slot, PresetTime *out);
+
+// Change a slot; the write happens PRESET_SETTLE_MS after the last change
+void presets_set(uint8_t slot, const PresetTime *t, uint32_t now);
+
+// Drive the deferred write. Returns 1 with the time it wants to run
+// again in *next, 0 when there is nothing pending.
+uint8_t presets_update(uint32_t now, uint32_t *next);
+
+// Unsaved changes or an EEPROM write in progress (don't power down)
+uint8_t presets_busy(void);
+
+void presets_get_stats(PresetStats *out);
+
+#endif
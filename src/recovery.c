@@ -0,0 +1,69 @@
+#include "recovery.h"
+
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include <util/atomic.h>
+#include <stddef.h>
+
+#define SNAP_MAGIC 0xD4A1
+
+// Survives any reset but a power cycle; after power-on it is garbage,
+// which the magic and the checksum catch
+static RecoverySnapshot snap __attribute__((section(".noinit")));
+
+static uint8_t reset_cause = 0;
+
+static uint16_t fletcher16(const uint8_t *p, uint8_t len) {
+    uint8_t a = 0, b = 0;
+    while (len--) {
+        a += *p++;
+        b += a;
+    }
+    return (uint16_t)((b << 8) | a);
+}
+
+static uint16_t snap_check(void) {
+    return fletcher16((const uint8_t *)&snap, offsetof(RecoverySnapshot, check));
+}
+
+uint8_t recovery_init(uint8_t mcusr, RecoverySnapshot *out, uint16_t *lost_ms) {
+    reset_cause = mcusr;
+
+    // Not after the reset button (EXTRF alone): somebody meant it
+    uint8_t ok = !(mcusr & (1 << PORF)) && (mcusr & ((1 << WDRF) | (1 << BORF))) &&
+                 snap.magic == SNAP_MAGIC && snap.check == snap_check();
+    if (ok) {
+        *out = snap;
+        // Watchdog: the reset came exactly one period after the last
+        // pass. Brown-out: somewhere before the next pass, take the middle.
+        *lost_ms = (mcusr & (1 << WDRF)) ? RECOVERY_WDT_MS : RECOVERY_GAP_MS / 2;
+        *lost_ms += RECOVERY_STARTUP_MS;
+    }
+    snap.magic = 0;
+    return ok;
+}
+
+RecoverySnapshot *recovery_snapshot(void) {
+    return &snap;
+}
+
+void recovery_commit(void) {
+    snap.magic = SNAP_MAGIC;
+    snap.check = snap_check();
+}
+
+void recovery_kick(void) {
+    wdt_reset();
+    if ((WDTCSR & ((1 << WDE) | (1 << WDIE))) == (1 << WDE)) return;
+
+    // Off, or interrupt-only after a power-down. Timed sequence;
+    // WDTO_1S = WDP2 | WDP1, no WDIE: a timeout resets straight away
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        WDTCSR = (1 << WDCE) | (1 << WDE);
+        WDTCSR = (1 << WDE) | (1 << WDP2) | (1 << WDP1);
+    }
+}
+
+uint8_t recovery_reset_cause(void) {
+    return reset_cause;
+}
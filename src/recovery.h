@@ -0,0 +1,49 @@
+#ifndef RECOVERY_H
+#define RECOVERY_H
+
+#include <stdint.h>
+#include "countdown.h"
+
+// Reset recovery. The main loop keeps a snapshot of the timers in RAM
+// that the C startup code leaves alone (.noinit) and kicks the watchdog on
+// every pass. After a watchdog or brown-out reset the RAM still holds the
+// snapshot, so the countdowns pick up where they were, minus the time the
+// reset cost, instead of coming back in IDLE. The reset button is a
+// deliberate restart: it clears the timers like a power-on. Brown-out
+// resets need the BOD fuse programmed (efuse 0xFD, 2.7 V, platformio.ini).
+//
+// Watchdog: reset-only mode, so a hang with interrupts off resets too (in
+// interrupt + reset mode the ISR has to run before the hardware escalates).
+// The loop comes round at least once per Timer1 overflow even when idle,
+// well inside the period.
+
+#define RECOVERY_WDT_MS     1000 // WDTO_1S
+#define RECOVERY_GAP_MS     524  // Longest idle sleep between passes (Timer1 overflow)
+#define RECOVERY_STARTUP_MS 65   // Start-up delay after reset (SUT fuses, int. RC)
+
+typedef struct {
+    uint16_t magic;
+    uint8_t  state;                // App state (TimerState)
+    uint8_t  channel;              // Selected channel
+    uint8_t  status[CD_CHANNELS];  // CountdownStatus
+    uint32_t left[CD_CHANNELS];    // Remaining ms at the last loop pass
+    uint16_t check;                // Fletcher-16 over the above
+} RecoverySnapshot;
+
+// Call first thing with the MCUSR value from before it was cleared. If
+// the reset left a valid snapshot behind, copies it to 'out', sets
+// *lost_ms to the estimated time between that snapshot and now
+// (millis() == 0) and returns 1. The RAM copy is invalidated either way.
+uint8_t recovery_init(uint8_t mcusr, RecoverySnapshot *out, uint16_t *lost_ms);
+
+// The snapshot to fill in, then seal with recovery_commit()
+RecoverySnapshot *recovery_snapshot(void);
+void recovery_commit(void);
+
+// Main loop pass done: restart the watchdog period (and put it back in
+// reset mode after power.c had it in interrupt-only mode)
+void recovery_kick(void);
+
+uint8_t recovery_reset_cause(void); // MCUSR as seen at boot
+
+#endif
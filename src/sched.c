@@ -0,0 +1,102 @@
+#include "sched.h"
+#include "timer.h"
+#include "trace.h"
+
+typedef struct {
+    TaskFn   fn;
+    uint32_t next_run;
+    uint16_t period;
+    uint16_t slack_ms;
+    uint8_t  active;
+    TaskStats stats;
+} Task;
+
+static Task tasks[SCHED_MAX_TASKS];
+static uint8_t task_count = 0;
+
+uint8_t sched_add(TaskFn fn, uint16_t period, uint16_t slack_ms) {
+    if (task_count == SCHED_MAX_TASKS) return SCHED_NONE;
+    Task *t = &tasks[task_count];
+    t->fn = fn;
+    t->period = period;
+    t->slack_ms = slack_ms;
+    t->active = 0;
+    return task_count++;
+}
+
+void sched_at(uint8_t id, uint32_t when) {
+    if (id >= task_count) return;
+    tasks[id].next_run = when;
+    tasks[id].active = 1;
+}
+
+void sched_stop(uint8_t id) {
+    if (id >= task_count) return;
+    tasks[id].active = 0;
+}
+
+uint8_t sched_active(uint8_t id) {
+    return id < task_count && tasks[id].active;
+}
+
+// Earliest active task, or 0xFF if none
+static uint8_t earliest(void) {
+    uint8_t best = 0xFF;
+    for (uint8_t i = 0; i < task_count; i++) {
+        if (!tasks[i].active) continue;
+        if (best == 0xFF || (int32_t)(tasks[i].next_run - tasks[best].next_run) < 0) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+uint8_t sched_run(void) {
+    uint8_t ran = 0;
+
+    while (1) {
+        uint8_t id = earliest();
+        uint32_t now = millis();
+
+        if (id == 0xFF) {
+            timer_clear_deadline(TIMER_SLOT_SCHED);
+            break;
+        }
+
+        Task *t = &tasks[id];
+        int32_t late = (int32_t)(now - t->next_run);
+        if (late < 0) {
+            // Nothing due: let the timebase wake us for the next one
+            timer_set_deadline(TIMER_SLOT_SCHED, t->next_run);
+            break;
+        }
+
+        if (late > t->stats.max_late_ms) t->stats.max_late_ms = (late > 0xFFFF) ? 0xFFFF : late;
+        if (late > t->slack_ms) {
+            t->stats.overruns++;
+            trace(TR_OVERRUN, id);
+        }
+
+        // Periodic tasks keep their phase (no drift); one-shots stop
+        // unless they re-arm themselves
+        if (t->period) t->next_run += t->period;
+        else           t->active = 0;
+
+        uint32_t start = micros();
+        t->fn(now);
+        uint32_t took = micros() - start;
+
+        if (took > t->stats.wcet_us) t->stats.wcet_us = (took > 0xFFFF) ? 0xFFFF : took;
+        t->stats.runs++;
+        ran++;
+    }
+    return ran;
+}
+
+void sched_get_stats(uint8_t id, TaskStats *out) {
+    *out = tasks[id].stats;
+}
+
+uint8_t sched_task_count(void) {
+    return task_count;
+}
@@ -0,0 +1,40 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+// Deadline-ordered cooperative scheduler. Tasks live in a fixed table
+// (no heap); sched_run() only calls the ones whose next-run time has come,
+// earliest deadline first, and arms the timebase for the next one.
+
+#define SCHED_MAX_TASKS 8
+#define SCHED_NONE      0xFF // sched_add(): the table is full
+
+typedef void (*TaskFn)(uint32_t now);
+
+// Per-task timing record
+typedef struct {
+    uint16_t wcet_us;     // Worst-case execution time
+    uint16_t max_late_ms; // Worst start delay after the deadline
+    uint16_t overruns;    // Runs that started later than the task's slack
+    uint32_t runs;
+} TaskStats;
+
+// Registers a task (initially stopped) and returns its id, or SCHED_NONE
+// if all SCHED_MAX_TASKS are taken.
+// 'period' = 0 makes it one-shot: it stops after running until re-armed.
+// 'slack_ms' is how late a start may be before it counts as an overrun.
+uint8_t sched_add(TaskFn fn, uint16_t period, uint16_t slack_ms);
+
+// SCHED_NONE (or any id never handed out) is ignored by these
+void sched_at(uint8_t id, uint32_t when); // (Re)arm to run at 'when'
+void sched_stop(uint8_t id);
+uint8_t sched_active(uint8_t id);
+
+// Run every due task. Returns the number of tasks run.
+uint8_t sched_run(void);
+
+void sched_get_stats(uint8_t id, TaskStats *out);
+uint8_t sched_task_count(void);
+
+#endif
@@ -1,32 +1,177 @@
 #include "timer.h"
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <util/atomic.h>
 
-volatile uint32_t system_millis = 0;
+// Prescaler 64: 8MHz / 64 = 125,000 Hz (8us per tick), 125 ticks = 1ms.
+// The real rate depends on the RC oscillator, so ticks per ms is kept in
+// 1/256 tick units (Q8) and set from the calibration. Leftover fractions
+// carry over, so no rounding error builds up however long it runs.
+#define TPM_NOMINAL (125U << 8)
+
+// One overflow = 65536 ticks, in Q8 units
+#define OVF_Q8      (65536UL << 8)
+
+static uint16_t tpm = TPM_NOMINAL;  // Ticks per ms (Q8)
+static uint16_t ovf_ms;             // Whole ms in one overflow...
+static uint16_t ovf_rem;            // ...plus this much (Q8 ticks)
+
+static volatile uint32_t base_ms = 0;      // millis at the last overflow
+static volatile uint16_t frac_ticks = 0;   // Leftover (< 1ms, Q8 ticks) at the last overflow
+static volatile uint32_t ovf_count = 0;
+
+static uint32_t deadline[TIMER_SLOT_COUNT];
+static volatile uint8_t deadline_active = 0; // Bit per slot
+static volatile uint8_t wake_now = 0;        // Due before the compare could catch it
+
+// Add one overflow period to a (ms, fraction) pair
+static void add_overflow(uint32_t *base, uint16_t *frac) {
+    *base += ovf_ms;
+    uint16_t f = *frac + ovf_rem; // Both < tpm <= TIMER_TPM_MAX: fits 16 bits
+    if (f >= tpm) {
+        (*base)++;
+        f -= tpm;
+    }
+    *frac = f;
+}
+
+// Snapshot of the extended counter. Interrupts must be disabled.
+// 'sub' is how far past *ms the counter is, in Q8 ticks.
+static void read_counter(uint32_t *ms, uint16_t *sub, uint16_t *tcnt) {
+    uint16_t t = TCNT1;
+    uint32_t base = base_ms;
+    uint16_t frac = frac_ticks;
+
+    // Overflow happened but its ISR hasn't run yet (we are in an ISR or
+    // inside a critical section): account for it here.
+    if ((TIFR1 & (1 << TOV1)) && t < 0x8000) {
+        add_overflow(&base, &frac);
+    }
+
+    uint32_t n = ((uint32_t)t << 8) + frac;
+    *ms = base + (uint16_t)(n / tpm);
+    *sub = (uint16_t)(n % tpm);
+    *tcnt = t;
+}
+
+// Program compare A for the nearest future deadline that fits in 16 bits.
+// Further ones are picked up again from the overflow ISR. A deadline that
+// is already due (it came up between the caller's millis() and here) or
+// that the compare missed while this ran sets wake_now instead, so
+// power_sleep() goes round again rather than waiting for the next
+// unrelated interrupt. Interrupts must be disabled.
+static void arm_compare(void) {
+    uint32_t now;
+    uint16_t sub;
+    uint16_t t;
+    read_counter(&now, &sub, &t);
+
+    int32_t best = INT32_MAX;
+    uint8_t due = 0;
+    for (uint8_t i = 0; i < TIMER_SLOT_COUNT; i++) {
+        if (!(deadline_active & (1 << i))) continue;
+        int32_t delta = (int32_t)(deadline[i] - now);
+        if (delta <= 0) due = 1;
+        else if (delta < best) best = delta;
+    }
+    wake_now = due;
+
+    // Land on (just past) the millisecond boundary. Anything further than
+    // one counter period is at most due at the next overflow, which wakes
+    // the CPU anyway.
+    uint32_t ticks = 0x10000;
+    if (best <= ovf_ms + 1) {
+        uint32_t q8 = (uint32_t)best * tpm - sub;
+        ticks = (q8 + 255) >> 8;
+    }
+    if (ticks > 0xFFFF) {
+        TIMSK1 &= ~(1 << OCIE1A);
+        return;
+    }
+
+    OCR1A = t + (uint16_t)ticks;
+    TIFR1 = (1 << OCF1A);
+    TIMSK1 |= (1 << OCIE1A);
+
+    // The maths above takes tens of us: with a near deadline the counter
+    // can be past OCR1A already, and the match wouldn't come for 0.5 s
+    if ((uint16_t)(TCNT1 - t) >= (uint16_t)ticks) wake_now = 1;
+}
+
+void timer_set_rate(uint16_t ticks_per_ms_q8) {
+    tpm = ticks_per_ms_q8;
+}
 
 void timer_init(void) {
-    // CTC Mode (Clear Timer on Compare Match)
-    TCCR0A = (1 << WGM01);
-    
-    // Prescaler 64: 8MHz / 64 = 125,000 Hz (8us per tick)
-    // 1ms target = 1000us / 8us = 125 ticks
-    OCR0A = 133; // 0-124 is 125 counts
-    
-    TIMSK0 |= (1 << OCIE0A); // Enable Compare Match A Interrupt
-    TCCR0B |= (1 << CS01) | (1 << CS00); // Start Timer, Prescaler 64
-    
+    ovf_ms = (uint16_t)(OVF_Q8 / tpm);
+    ovf_rem = (uint16_t)(OVF_Q8 % tpm);
+
+    // Normal mode, free running
+    TCCR1A = 0;
+    TCNT1 = 0;
+    TIFR1 = (1 << TOV1) | (1 << OCF1A);
+    TIMSK1 = (1 << TOIE1); // Overflow extends the counter
+
+    TCCR1B = (1 << CS11) | (1 << CS10); // Start Timer, Prescaler 64
+
     sei(); // Ensure Global Interrupts are enabled
 }
 
-ISR(TIMER0_COMPA_vect) {
-    system_millis++;
+ISR(TIMER1_OVF_vect) {
+    uint32_t base = base_ms;
+    uint16_t frac = frac_ticks;
+    add_overflow(&base, &frac);
+    base_ms = base;
+    frac_ticks = frac;
+    ovf_count++;
+
+    arm_compare();
+}
+
+// One-shot: its only job is to wake the CPU; then aim at the next deadline
+ISR(TIMER1_COMPA_vect) {
+    arm_compare();
 }
 
 uint32_t millis(void) {
     uint32_t m;
-    // Atomic read: disable interrupts while reading volatile multi-byte variable
-    cli(); 
-    m = system_millis;
-    sei();
+    uint16_t sub;
+    uint16_t t;
+    // Atomic read, restoring the previous interrupt state (safe inside ISRs)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        read_counter(&m, &sub, &t);
+    }
     return m;
-}
\ No newline at end of file
+}
+
+uint32_t micros(void) {
+    uint32_t ovf;
+    uint16_t t;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        t = TCNT1;
+        ovf = ovf_count;
+        if ((TIFR1 & (1 << TOV1)) && t < 0x8000) ovf++;
+    }
+    return ((ovf << 16) | t) << 3; // 8us per tick
+}
+
+void timer_set_deadline(uint8_t slot, uint32_t when) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        deadline[slot] = when;
+        deadline_active |= (1 << slot);
+        arm_compare();
+    }
+}
+
+uint8_t timer_take_wake(void) {
+    uint8_t w = wake_now;
+    wake_now = 0;
+    return w;
+}
+
+void timer_clear_deadline(uint8_t slot) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        deadline_active &= ~(1 << slot);
+        arm_compare();
+    }
+}
@@ -3,10 +3,41 @@
 
 #include <stdint.h>
 
-// Initialize Timer0 for 1ms interrupts
+// Tickless timebase: Timer1 free-runs at 8us per tick and is extended in
+// software on overflow (~2 interrupts/s). millis()/micros() are computed
+// from the counter on demand, so there is no 1 kHz tick interrupt.
+
+// --- DEADLINE SLOTS ---
+// Modules register the next time they need the CPU; Timer1 compare A is
+// armed as a one-shot for the nearest one so the CPU can sleep until then.
+#define TIMER_SLOT_SCHED    0 // Next task in the scheduler (tick, blink, audio...)
+#define TIMER_SLOT_INPUT    1 // Next long-press / hold-repeat
+#define TIMER_SLOT_DEBOUNCE 2 // End of a debounce window that dropped an edge
+#define TIMER_SLOT_COUNT    3
+
+// Measured Timer1 ticks per ms in 1/256 units (nominal 125 << 8 = 32000).
+// Call before timer_init(). At most TIMER_TPM_MAX (clock 2.4% fast): the
+// fraction carried across overflows is summed in 16 bits.
+#define TIMER_TPM_MAX 32768U
+void timer_set_rate(uint16_t ticks_per_ms_q8);
+
+// Initialize Timer1 as the free-running timebase
 void timer_init(void);
 
 // Get current milliseconds since startup
 uint32_t millis(void);
 
-#endif
\ No newline at end of file
+// Get current microseconds since startup (8us resolution, wraps after ~71 min).
+// Nominal ticks, not rate-corrected: for measuring short intervals only.
+uint32_t micros(void);
+
+// Arm / disarm a deadline slot ('when' is a millis() value)
+void timer_set_deadline(uint8_t slot, uint32_t when);
+void timer_clear_deadline(uint8_t slot);
+
+// 1 if a deadline was already due when it was armed, or the compare slipped
+// past it: sleeping now would miss it. Clears the flag. Call with interrupts
+// disabled, right before sleeping.
+uint8_t timer_take_wake(void);
+
+#endif
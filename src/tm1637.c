@@ -1,101 +1,304 @@
 #include "tm1637.h"
 #include "io_map.h"      // <--- Now it knows about your board wiring
+#include "bench.h"
 #include <avr/io.h>
-#include <util/delay.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
 
-// 7-segment encoding 0-9
-static const uint8_t digit_to_seg[10] = {
+// 7-segment encoding 0-9 (flash: not copied to SRAM at startup)
+static const uint8_t digit_to_seg[10] PROGMEM = {
     0x3F,0x06,0x5B,0x4F,0x66,0x6D,0x7D,0x07,0x7F,0x6F
 };
 
-// --- LOW LEVEL MACROS (Mapped to io_map.h) ---
-// We use the definitions from io_map.h directly for maximum speed
-#define CLK_HIGH()  (DISP_PORT |=  (1 << DISP_CLK_PIN))
-#define CLK_LOW()   (DISP_PORT &= ~(1 << DISP_CLK_PIN))
-#define DIO_HIGH()  (DISP_PORT |=  (1 << DISP_DIO_PIN))
-#define DIO_LOW()   (DISP_PORT &= ~(1 << DISP_DIO_PIN))
-
-// Input/Output Direction Macros
-#define DIO_OUTPUT() (DISP_DDR |= (1 << DISP_DIO_PIN))
-#define DIO_INPUT()  (DISP_DDR &= ~(1 << DISP_DIO_PIN))
-#define DIO_READ()   (DISP_PIN_REG & (1 << DISP_DIO_PIN))
-
-
-static void tm1637_start(void) {
-    CLK_HIGH();
-    DIO_HIGH();
-    DIO_LOW();
-    CLK_LOW();
-}
-
-static void tm1637_stop(void) {
-    CLK_LOW();
-    DIO_LOW();
-    CLK_HIGH();
-    DIO_HIGH();
-}
-
-static void tm1637_write_byte(uint8_t b) {
-    for (uint8_t i = 0; i < 8; i++) {
-        CLK_LOW();
-        if (b & 0x01) DIO_HIGH();
-        else          DIO_LOW();
-        _delay_us(3);
-        CLK_HIGH();
-        _delay_us(3);
-        b >>= 1;
+// --- LOW LEVEL (io_map.h accessors) ---
+// Each is a single sbi/cbi/sbic, see IO_PIN()
+
+// TM1637 commands
+#define CMD_DATA_AUTO   0x40 // Write data, auto increment address
+#define CMD_DATA_FIXED  0x44 // Write data, fixed address
+#define CMD_ADDR        0xC0 // | digit index
+#define CMD_DISPLAY_ON  0x88 // | brightness (0-7)
+#define CMD_DISPLAY_OFF 0x80
+
+// Bytes on the bus for a full frame: data cmd + address + 4 digits
+#define FULL_FRAME_BYTES 6
+
+// --- MAILBOX (foreground -> ISR) ---
+// Only the latest frame is kept; a new submit simply overwrites it.
+#define PEND_FRAME 0x01
+#define PEND_CTRL  0x02
+
+static volatile uint8_t mbox_frame[4];
+static volatile uint8_t mbox_ctrl;
+static volatile uint8_t mbox_pending = 0;
+
+// --- SHADOW FRAMEBUFFER (ISR owned) ---
+// What the display currently shows, so unchanged digits never touch the bus
+static uint8_t shadow[4];
+static uint8_t shadow_valid = 0;
+
+static volatile TM1637_Stats stats;
+static uint8_t brightness_level = 3;
+
+// --- TRANSFER ENGINE (ISR owned) ---
+// A transfer is a list of bus transactions, each encoded as
+// [length][bytes...]; a length of 0 ends the list. Worst case is the
+// fixed-address form for two digits plus a brightness command.
+#define XFER_BUF_SIZE 12
+
+typedef enum {
+    PH_START,    // DIO low while CLK high (start condition)
+    PH_BIT,      // CLK low, next bit on DIO, CLK high: device samples
+    PH_ACK,      // CLK low, let go of DIO, CLK high: device pulls DIO low
+    PH_ACK_NEXT, // Read ACK, CLK low, take DIO back, then the first bit
+                 // of the next byte, or CLK high for the stop condition
+    PH_STOP      // DIO high while CLK high (stop condition)
+} XferPhase;
+
+static uint8_t xfer[XFER_BUF_SIZE];
+static uint8_t xfer_pos;       // Index of the current byte in xfer[]
+static uint8_t xfer_remaining; // Bytes left in the current transaction
+static uint8_t xfer_byte;      // Shift register for the byte on the wire
+static uint8_t xfer_bit;
+static XferPhase xfer_phase;
+static volatile uint8_t xfer_active = 0;
+
+// Timer2 tick = 1us (8MHz / 8), one bus step per compare match
+#define STEP_TICKS (TM1637_STEP_US - 1)
+
+static void engine_start_timer(void) {
+    TCNT2 = 0;
+    TIFR2 = (1 << OCF2A);
+    TIMSK2 |= (1 << OCIE2A);
+}
+
+static void engine_stop_timer(void) {
+    TIMSK2 &= ~(1 << OCIE2A);
+}
+
+// Called from the ISR (or with interrupts off): turns the mailbox into a
+// transfer script. Returns 0 if there is nothing to put on the bus.
+static uint8_t engine_build(void) {
+    uint8_t pending = mbox_pending;
+    uint8_t n = 0;
+    mbox_pending = 0;
+
+    if (pending & PEND_FRAME) {
+        uint8_t frame[4];
+        uint8_t changed = 0; // Bit i set = digit i differs from the shadow
+        uint8_t count = 0;
+
+        for (uint8_t i = 0; i < 4; i++) {
+            frame[i] = mbox_frame[i];
+            if (!shadow_valid || frame[i] != shadow[i]) {
+                changed |= (1 << i);
+                count++;
+            }
+            shadow[i] = frame[i];
+        }
+        shadow_valid = 1;
+
+        // Fixed address mode costs 1 + 2 bytes per digit, a full write costs 6,
+        // so it only pays off for one or two changed digits.
+        if (count > 2) {
+            xfer[n++] = 1;
+            xfer[n++] = CMD_DATA_AUTO; // Auto increment address
+            xfer[n++] = 5;
+            xfer[n++] = CMD_ADDR;      // Start address 0
+            for (uint8_t i = 0; i < 4; i++) xfer[n++] = frame[i];
+        }
+        else if (count > 0) {
+            xfer[n++] = 1;
+            xfer[n++] = CMD_DATA_FIXED;
+            for (uint8_t i = 0; i < 4; i++) {
+                if (!(changed & (1 << i))) continue;
+                xfer[n++] = 2;
+                xfer[n++] = CMD_ADDR | i;
+                xfer[n++] = frame[i];
+            }
+        }
+        else {
+            stats.frames_skipped++;
+        }
+    }
+
+    if (pending & PEND_CTRL) {
+        xfer[n++] = 1;
+        xfer[n++] = mbox_ctrl;
+    }
+
+    if (n == 0) return 0;
+    xfer[n] = 0;
+
+    xfer_pos = 0;
+    xfer_phase = PH_START;
+    return 1;
+}
+
+// Kick the engine if it is idle; must be called with interrupts disabled
+static void engine_kick(void) {
+    if (xfer_active) return; // ISR picks the mailbox up when it finishes
+    if (engine_build()) {
+        xfer_active = 1;
+        engine_start_timer();
     }
+}
 
-    // ACK Check
-    CLK_LOW();
-    DIO_INPUT();   // Float pin to listen for ACK
-    DIO_LOW();     // Internal Pull-off (ensure strictly input)
-    _delay_us(3);
-    CLK_HIGH();
-    _delay_us(3);  // Device pulls Low here if ACK
-    CLK_LOW();
-    DIO_OUTPUT();  // Reclaim control
+// Put the next bit on DIO and clock it in. CLK is low for the few cycles
+// in between, well over the 0.4 us the TM1637 needs, and stays high
+// until the next step.
+static inline void clock_bit(void) {
+    disp_clk_low();
+    if (xfer_byte & 0x01) disp_dio_high();
+    else                  disp_dio_low();
+    xfer_byte >>= 1;
+    disp_clk_high();
+}
+
+ISR(TIMER2_COMPA_vect) {
+    BENCH_ISR_ENTER(BENCH_DISP_ISR);
+
+    switch (xfer_phase) {
+        case PH_START:
+            disp_dio_low();
+            xfer_remaining = xfer[xfer_pos++];
+            xfer_byte = xfer[xfer_pos++];
+            xfer_bit = 0;
+            xfer_phase = PH_BIT;
+            break;
+
+        case PH_BIT:
+            clock_bit();
+            if (++xfer_bit == 8) xfer_phase = PH_ACK;
+            break;
+
+        case PH_ACK:
+            disp_clk_low();
+            disp_dio_input();   // Float pin to listen for ACK
+            disp_dio_low();     // Internal Pull-off (ensure strictly input)
+            disp_clk_high();    // Ninth clock: device pulls Low here if ACK
+            xfer_phase = PH_ACK_NEXT;
+            break;
+
+        case PH_ACK_NEXT:
+            if (disp_dio_read()) stats.ack_failures++;
+            stats.bytes_sent++;
+            disp_clk_low();
+            disp_dio_output();  // Reclaim control (driving Low)
+
+            if (--xfer_remaining) {
+                xfer_byte = xfer[xfer_pos++];
+                clock_bit();
+                xfer_bit = 1;
+                xfer_phase = PH_BIT;
+            } else {
+                disp_clk_high(); // DIO still low: ready for the stop condition
+                xfer_phase = PH_STOP;
+            }
+            break;
+
+        case PH_STOP:
+            disp_dio_high();    // Bus idle again (both lines high)
+
+            if (xfer[xfer_pos]) {
+                xfer_phase = PH_START; // Next transaction
+            }
+            else if (!engine_build()) {
+                xfer_active = 0;
+                engine_stop_timer();
+            }
+            break;
+    }
+
+    BENCH_ISR_EXIT(BENCH_DISP_ISR);
 }
 
 // NOTE: We no longer need pin arguments! It's all in io_map.h
 void tm1637_init(void) {
     // Set pins as Output
-    DISP_DDR |= (1 << DISP_CLK_PIN) | (1 << DISP_DIO_PIN);
-    
+    disp_clk_output();
+    disp_dio_output();
+
     // Set Defaults (High)
-    CLK_HIGH();
-    DIO_HIGH();
+    disp_clk_high();
+    disp_dio_high();
+
+    // Timer2: CTC, prescaler 8, interrupt only enabled while a transfer runs
+    TCCR2A = (1 << WGM21);
+    OCR2A = STEP_TICKS;
+    TCCR2B = (1 << CS21);
 
     tm1637_set_brightness(3);
 }
 
+static void post_ctrl(uint8_t cmd) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        stats.bytes_requested++;
+        mbox_ctrl = cmd;
+        mbox_pending |= PEND_CTRL;
+        engine_kick();
+    }
+}
+
 void tm1637_set_brightness(uint8_t brightness) {
-    tm1637_start();
-    tm1637_write_byte(0x88 | (brightness & 0x07)); 
-    tm1637_stop();
+    brightness_level = brightness & 0x07;
+    post_ctrl(CMD_DISPLAY_ON | brightness_level);
+}
+
+uint8_t tm1637_get_brightness(void) {
+    return brightness_level;
+}
+
+void tm1637_set_power(uint8_t on) {
+    post_ctrl(on ? (CMD_DISPLAY_ON | brightness_level) : CMD_DISPLAY_OFF);
 }
 
 void tm1637_display_segments(uint8_t s0, uint8_t s1, uint8_t s2, uint8_t s3) {
-    tm1637_start();
-    tm1637_write_byte(0x40); // Auto increment address
-    tm1637_stop();
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        stats.bytes_requested += FULL_FRAME_BYTES;
 
-    tm1637_start();
-    tm1637_write_byte(0xC0); // Start address 0
-    tm1637_write_byte(s0);
-    tm1637_write_byte(s1);
-    tm1637_write_byte(s2);
-    tm1637_write_byte(s3);
-    tm1637_stop();
+        if (mbox_frame[0] == s0 && mbox_frame[1] == s1 &&
+            mbox_frame[2] == s2 && mbox_frame[3] == s3 && shadow_valid) {
+            // Same as the last frame submitted: nothing new for the bus
+            stats.frames_skipped++;
+        } else {
+            if (mbox_pending & PEND_FRAME) stats.frames_replaced++;
+            mbox_frame[0] = s0;
+            mbox_frame[1] = s1;
+            mbox_frame[2] = s2;
+            mbox_frame[3] = s3;
+            mbox_pending |= PEND_FRAME;
+            engine_kick();
+        }
+    }
 }
 
 void tm1637_display_time(uint8_t min, uint8_t sec, uint8_t colon) {
-    uint8_t s0 = digit_to_seg[min / 10];
-    uint8_t s1 = digit_to_seg[min % 10];
-    uint8_t s2 = digit_to_seg[sec / 10];
-    uint8_t s3 = digit_to_seg[sec % 10];
+    uint8_t s0 = pgm_read_byte(&digit_to_seg[min / 10]);
+    uint8_t s1 = pgm_read_byte(&digit_to_seg[min % 10]);
+    uint8_t s2 = pgm_read_byte(&digit_to_seg[sec / 10]);
+    uint8_t s3 = pgm_read_byte(&digit_to_seg[sec % 10]);
 
-    if (colon) s1 |= 0x80; 
+    if (colon) s1 |= 0x80;
 
     tm1637_display_segments(s0, s1, s2, s3);
-}
\ No newline at end of file
+}
+
+uint8_t tm1637_digit(uint8_t d) {
+    return pgm_read_byte(&digit_to_seg[d % 10]);
+}
+
+uint8_t tm1637_busy(void) {
+    return xfer_active || mbox_pending;
+}
+
+void tm1637_flush(void) {
+    while (tm1637_busy());
+}
+
+void tm1637_get_stats(TM1637_Stats *out) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        *out = stats;
+    }
+}
@@ -3,9 +3,37 @@
 
 #include <stdint.h>
 
+// Time between bus steps (us). The transfer engine on Timer2 clocks a
+// whole bit per compare match (CLK low, DIO, CLK high), so a full frame
+// is 60 interrupts (~2.4 ms) and one changed digit 33. The bench runner
+// times the interrupt body (not its register saves) as the tm1637_isr
+// probe.
+#define TM1637_STEP_US 40
+
+// Bus traffic counters: 'requested' is what writing every frame in full
+// would have cost, 'sent' is what actually went out after the shadow compare.
+typedef struct {
+    uint32_t bytes_requested;
+    uint32_t bytes_sent;
+    uint32_t frames_skipped;  // Frames identical to what is already shown
+    uint32_t frames_replaced; // Frames overwritten in the mailbox before being sent
+    uint16_t ack_failures;    // Bytes the display did not acknowledge
+} TM1637_Stats;
+
 void tm1637_init(void); // Params removed
+
+// These only post to a mailbox and return immediately; a Timer2 interrupt
+// clocks the data out in the background. If a new frame arrives while a
+// transfer is running, only the latest one is sent afterwards.
 void tm1637_set_brightness(uint8_t brightness);
+uint8_t tm1637_get_brightness(void); // Last level set (0-7)
+void tm1637_set_power(uint8_t on); // Display off keeps the RAM, on restores brightness
 void tm1637_display_segments(uint8_t s0, uint8_t s1, uint8_t s2, uint8_t s3);
 void tm1637_display_time(uint8_t min, uint8_t sec, uint8_t colon);
+uint8_t tm1637_digit(uint8_t d); // Segment pattern of 0-9, for display_segments()
+
+uint8_t tm1637_busy(void);  // Transfer running or frame waiting
+void tm1637_flush(void);    // Block until everything is on the display
+void tm1637_get_stats(TM1637_Stats *out);
 
-#endif
\ No newline at end of file
+#endif
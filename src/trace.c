@@ -0,0 +1,157 @@
+#include "trace.h"
+#include "sched.h"
+#include "uart.h"
+
+#include <avr/pgmspace.h>
+
+// Kept over resets (trace_init() decides)
+TraceEntry trace_ring[TRACE_SIZE] __attribute__((section(".noinit")));
+uint16_t trace_count __attribute__((section(".noinit")));
+uint16_t trace_now = 0;
+uint8_t trace_frozen = 0;
+TraceProbe trace_probes[TRACE_PROBES];
+
+void trace_init(uint8_t reset_cause) {
+    if ((reset_cause & (1 << PORF)) || !(reset_cause & ((1 << WDRF) | (1 << BORF) | (1 << EXTRF)))) {
+        trace_count = 0; // Power-on: whatever is in RAM is noise
+    }
+}
+
+// --- DUMP ---
+// One line at a time, generated only once the UART has room for it
+enum { DUMP_IDLE, DUMP_HEAD, DUMP_EVENTS, DUMP_PROBES, DUMP_TASKS, DUMP_END };
+
+#define LINE_MAX 40
+
+static uint8_t section = DUMP_IDLE;
+static uint8_t item = 0;
+static uint32_t dump_ms = 0;
+static char line[LINE_MAX];
+static uint8_t line_len = 0; // Built but not queued yet
+
+static char *put_hex(char *p, uint32_t v, uint8_t digits) {
+    for (int8_t i = (int8_t)(digits - 1); i >= 0; i--) {
+        uint8_t n = (v >> (i * 4)) & 0x0F;
+        *p++ = (char)(n < 10 ? '0' + n : 'A' + n - 10);
+    }
+    return p;
+}
+
+// 's' in flash (PSTR): string literals would otherwise sit in SRAM
+static char *put_str_P(char *p, const char *s) {
+    char c;
+    while ((c = (char)pgm_read_byte(s++))) *p++ = c;
+    return p;
+}
+
+static uint8_t events_kept(void) {
+    return (trace_count < TRACE_SIZE) ? (uint8_t)trace_count : TRACE_SIZE;
+}
+
+// Build the next line into 'line'; 0 once the dump is complete
+static uint8_t next_line(void) {
+    char *p = line;
+
+    while (p == line) {
+        switch (section) {
+            case DUMP_HEAD:
+                p = put_str_P(p, PSTR("TRACE "));
+                p = put_hex(p, trace_count, 4);
+                *p++ = ' ';
+                p = put_hex(p, dump_ms, 8);
+                section = DUMP_EVENTS;
+                item = 0;
+                break;
+
+            case DUMP_EVENTS: {
+                if (item >= events_kept()) {
+                    section = DUMP_PROBES;
+                    item = 0;
+                    break;
+                }
+                // Oldest first
+                uint16_t n = (uint16_t)(trace_count - events_kept() + item++);
+                const TraceEntry *e = &trace_ring[n & (TRACE_SIZE - 1)];
+                p = put_hex(p, e->ms, 4);
+                *p++ = ' ';
+                p = put_hex(p, e->type, 2);
+                *p++ = ' ';
+                p = put_hex(p, e->arg, 2);
+                break;
+            }
+
+            case DUMP_PROBES: {
+                if (item >= TRACE_PROBES) {
+                    section = DUMP_TASKS;
+                    item = 0;
+                    break;
+                }
+                const TraceProbe *pr = &trace_probes[item];
+                if (pr->calls) {
+                    *p++ = 'P';
+                    p = put_hex(p, item, 1);
+                    *p++ = ' ';
+                    p = put_hex(p, pr->calls, 4);
+                    *p++ = ' ';
+                    p = put_hex(p, pr->total, 8);
+                    *p++ = ' ';
+                    p = put_hex(p, pr->max, 4);
+                }
+                item++;
+                break;
+            }
+
+            case DUMP_TASKS: {
+                if (item >= sched_task_count()) {
+                    section = DUMP_END;
+                    break;
+                }
+                TaskStats st;
+                sched_get_stats(item, &st);
+                *p++ = 'S';
+                p = put_hex(p, item++, 1);
+                *p++ = ' ';
+                p = put_hex(p, st.runs, 8);
+                *p++ = ' ';
+                p = put_hex(p, st.wcet_us, 4);
+                *p++ = ' ';
+                p = put_hex(p, st.max_late_ms, 4);
+                *p++ = ' ';
+                p = put_hex(p, st.overruns, 4);
+                break;
+            }
+
+            case DUMP_END:
+                p = put_str_P(p, PSTR("END"));
+                section = DUMP_IDLE;
+                break;
+
+            default:
+                return 0;
+        }
+    }
+
+    *p++ = '\n';
+    line_len = (uint8_t)(p - line);
+    return 1;
+}
+
+void trace_dump(uint32_t now) {
+    if (section != DUMP_IDLE || line_len) return; // One at a time
+    trace_frozen = 1;
+    dump_ms = now;
+    section = DUMP_HEAD;
+}
+
+uint8_t trace_dump_poll(void) {
+    while (line_len || next_line()) {
+        if (!UART_Write((const uint8_t *)line, line_len)) return 1; // TX ring full
+        line_len = 0;
+    }
+    trace_frozen = 0;
+    return 0;
+}
+
+uint8_t trace_dumping(void) {
+    return trace_frozen;
+}
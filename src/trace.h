@@ -0,0 +1,107 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <stdint.h>
+
+// Field diagnostics: a small ring of binary events and per-probe Timer1
+// counters, kept in every build and dumped on request over the UART.
+//
+// The events live in .noinit RAM, so after a watchdog or brown-out reset
+// the dump still shows what led up to it.
+//
+// Recording is a few stores (no millis() call: each event takes the
+// timestamp of the loop pass it happened in, see trace_time()), so it
+// stays enabled in production. Main loop only, not from ISRs.
+//
+// The dump is plain ASCII (hex digits, spaces, newlines) on the DFPlayer's
+// TX line at its 9600 baud. The module only listens for frames starting
+// with 0x7E, which never occurs in the text, so it ignores the dump; tap
+// the TX pin with a USB-serial adapter to read it:
+//   TRACE <events recorded> <ms now>
+//   <ms> <type> <arg>                   oldest first, up to TRACE_SIZE
+//   P<probe> <calls> <ticks> <max>      Timer1 ticks (8 us = 64 cycles)
+//   S<task> <runs> <wcet us> <max late ms> <overruns>
+//   END
+// All numbers hex. Recording stops while the dump is going out.
+
+#define TRACE_SIZE 32 // Events (power of 2), 4 bytes each
+
+// Event types
+#define TR_BOOT    1 // arg: reset cause (MCUSR)
+#define TR_STATE   2 // arg: TimerState entered
+#define TR_GESTURE 3 // arg: kind << 4 | button mask (gestures.h)
+#define TR_DF_TX   4 // arg: DFPlayer command sent
+#define TR_OVERRUN 5 // arg: scheduler task that started past its slack
+
+#define TRACE_PROBES 5 // Firmware probe ids from bench.h (1-4)
+
+typedef struct {
+    uint16_t ms; // Low 16 bits of millis()
+    uint8_t  type;
+    uint8_t  arg;
+} TraceEntry;
+
+typedef struct {
+    uint16_t calls;
+    uint16_t max;   // Timer1 ticks
+    uint32_t total;
+    uint16_t start;
+} TraceProbe;
+
+extern TraceEntry trace_ring[TRACE_SIZE];
+extern uint16_t trace_count;
+extern uint16_t trace_now;
+extern uint8_t trace_frozen;
+extern TraceProbe trace_probes[TRACE_PROBES];
+
+// Timestamp for the events that follow (once per loop pass)
+static inline void trace_time(uint32_t now) {
+    trace_now = (uint16_t)now;
+}
+
+static inline void trace(uint8_t type, uint8_t arg) {
+    if (trace_frozen) return;
+    TraceEntry *e = &trace_ring[trace_count++ & (TRACE_SIZE - 1)];
+    e->ms = trace_now;
+    e->type = type;
+    e->arg = arg;
+}
+
+// Timer1 is the timebase (8 us per tick). 16-bit reads go through the
+// shared TEMP register, so keep interrupts out of the way.
+static inline uint16_t trace_ticks(void) {
+    uint16_t t;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        t = TCNT1;
+    }
+    return t;
+}
+
+static inline void trace_prof_enter(uint8_t id) {
+    trace_probes[id].start = trace_ticks();
+}
+
+static inline void trace_prof_exit(uint8_t id) {
+    TraceProbe *p = &trace_probes[id];
+    uint16_t d = trace_ticks() - p->start;
+    p->calls++;
+    p->total += d;
+    if (d > p->max) p->max = d;
+}
+
+// Call at boot with MCUSR: keeps the events over a reset that left the RAM
+// powered, clears them after power-on
+void trace_init(uint8_t reset_cause);
+
+// Start sending the dump (freezes recording until it is out)
+void trace_dump(uint32_t now);
+
+// Queue as much of the dump as the UART has room for. Returns 1 while
+// there is more to send; call again once some of it has drained.
+uint8_t trace_dump_poll(void);
+
+uint8_t trace_dumping(void);
+
+#endif
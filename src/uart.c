@@ -1,26 +1,121 @@
 #include "uart.h"
+#include "io_map.h"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 
-void UART_Init(void) {
+#define TX_MASK (UART_TX_BUF_SIZE - 1)
+#define RX_MASK (UART_RX_BUF_SIZE - 1)
+
+// --- TX RING BUFFER ---
+// Head is only written by the foreground, tail only by the UDRE ISR.
+static uint8_t tx_buf[UART_TX_BUF_SIZE];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+static uint8_t tx_started = 0; // Something was sent since TXC0 was last cleared
+
+// --- RX RING BUFFER ---
+// Head is only written by the RX ISR, tail only by the foreground.
+static uint8_t rx_buf[UART_RX_BUF_SIZE];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+static volatile uint8_t rx_overruns = 0;
+static UART_RxHook rx_hook = 0;
+
+void UART_Init(uint8_t ubrr) {
     // 1. Set the Calibrated Baud Rate
     UBRR0H = 0;
-    UBRR0L = UART_CALIBRATED_UBRR;
+    UBRR0L = ubrr;
     
     // 2. Enable Double Speed Mode (U2X0)
     // This reduces error rates for 8MHz internal oscillators.
     UCSR0A |= (1 << U2X0);
     
-    // 3. Enable Transmitter
-    // We only need TX to talk to the DFPlayer. RX is optional.
-    UCSR0B = (1 << TXEN0);
+    // 3. Enable Transmitter and Receiver
+    // RX carries the DFPlayer's status frames (boot done, track finished).
+    // The pull-up keeps the line idle if the module's TX is not wired.
+    df_rx_high();
+    UCSR0B = (1 << TXEN0) | (1 << RXEN0) | (1 << RXCIE0);
     
     // 4. Set Frame Format: 8 Data bits, No Parity, 1 Stop bit (8N1)
     UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
 }
 
+// Data Register Empty: feed the next queued byte, or go quiet when drained
+ISR(USART_UDRE_vect) {
+    uint8_t tail = tx_tail;
+    if (tail == tx_head) {
+        UCSR0B &= ~(1 << UDRIE0);
+        return;
+    }
+    UDR0 = tx_buf[tail];
+    tx_tail = (tail + 1) & TX_MASK;
+}
+
+// Receive Complete: stash the byte, drop it if the foreground fell behind
+ISR(USART_RX_vect) {
+    uint8_t data = UDR0;
+    if (rx_hook && rx_hook(data)) return;
+    uint8_t head = rx_head;
+    uint8_t next = (head + 1) & RX_MASK;
+    if (next == rx_tail) {
+        if (rx_overruns < 0xFF) rx_overruns++;
+        return;
+    }
+    rx_buf[head] = data;
+    rx_head = next;
+}
+
+uint8_t UART_Read(uint8_t *data) {
+    uint8_t tail = rx_tail;
+    if (tail == rx_head) return 0;
+    *data = rx_buf[tail];
+    rx_tail = (tail + 1) & RX_MASK;
+    return 1;
+}
+
+uint8_t UART_RxOverruns(void) {
+    return rx_overruns;
+}
+
+void UART_SetRxHook(UART_RxHook hook) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        rx_hook = hook;
+    }
+}
+
+uint8_t UART_TxFree(void) {
+    return (uint8_t)(TX_MASK - ((tx_head - tx_tail) & TX_MASK));
+}
+
+uint8_t UART_Write(const uint8_t *data, uint8_t len) {
+    if (UART_TxFree() < len) return 0;
+
+    uint8_t head = tx_head;
+    for (uint8_t i = 0; i < len; i++) {
+        tx_buf[head] = data[i];
+        head = (head + 1) & TX_MASK;
+    }
+
+    // Publish the bytes, then (re)arm the ISR. UCSR0B is also touched by
+    // the ISR, so the read-modify-write has to be atomic.
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        tx_head = head;
+        UCSR0A = (UCSR0A & (1 << U2X0)) | (1 << TXC0); // Clear "transmit complete"
+        tx_started = 1;
+        UCSR0B |= (1 << UDRIE0);
+    }
+    return len;
+}
+
+uint8_t UART_TxIdle(void) {
+    if (tx_head != tx_tail) return 0;
+    if (!tx_started) return 1;
+    if (!(UCSR0A & (1 << TXC0))) return 0;
+    tx_started = 0;
+    return 1;
+}
+
 void UART_Tx(uint8_t data) {
-    // Wait for empty transmit buffer (UDRE0 flag)
-    while (!(UCSR0A & (1 << UDRE0)));
-    
-    // Put data into buffer, sending it
-    UDR0 = data;
-}
\ No newline at end of file
+    // Wait for room in the ring (only blocks if it is full)
+    while (!UART_Write(&data, 1));
+}
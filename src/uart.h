@@ -6,10 +6,40 @@
 
 // --- CONFIGURATION ---
 // Based on your calibration: 108 aligned perfectly with your 8MHz chip.
+// Only the fallback now: calib.c computes the divisor for each unit.
 #define UART_CALIBRATED_UBRR 108
 
+// TX ring buffer size (must be a power of 2, max 128). A host reply
+// packet (host.h) has to fit in one go.
+#define UART_TX_BUF_SIZE 64
+
+// RX ring buffer size (power of 2): room for one DFPlayer frame and change
+#define UART_RX_BUF_SIZE 16
+
 // --- API PROTOTYPES ---
-void UART_Init(void);
+void UART_Init(uint8_t ubrr); // Baud divisor (U2X), see calib_ubrr()
 void UART_Tx(uint8_t data);
 
-#endif
\ No newline at end of file
+// Non-blocking: queues 'len' bytes for the UDRE interrupt to send.
+// Returns 0 (and queues nothing) if the ring does not have room for all of them.
+uint8_t UART_Write(const uint8_t *data, uint8_t len);
+
+// Free space in the TX ring (bytes)
+uint8_t UART_TxFree(void);
+
+// 1 once every queued byte has completely left the shift register
+uint8_t UART_TxIdle(void);
+
+// Non-blocking: 1 and the oldest received byte in *data, or 0 if none
+uint8_t UART_Read(uint8_t *data);
+
+// Bytes lost because the RX ring was full
+uint8_t UART_RxOverruns(void);
+
+// Sees every received byte in the RX interrupt before the ring does;
+// returning 1 keeps the byte out of the ring (host.c takes its packets
+// out of the stream this way)
+typedef uint8_t (*UART_RxHook)(uint8_t data);
+void UART_SetRxHook(UART_RxHook hook);
+
+#endif
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""Pre-merge gate: every firmware image through the real avr-gcc, then
+the host simulator and its checks.
+
+    python3 tools/gate.py [--skip-sweep]
+
+Builds, in order, stopping at the first failure:
+
+    env:ATmega328P              the release firmware
+    env:size -t size_report     LTO image, fails over the footprint budget
+    env:bench, env:bench_pins   the probe builds (ISR bodies with GPIOR0 marks)
+    env:native                  the simulator
+
+then runs every sim mode, the 00:01..99:59 sweep and the host client
+selftest over a pty. The native build alone does not prove the firmware
+builds: sim/include stands in for <avr/io.h>, <avr/sleep.h> and
+<avr/pgmspace.h>, and host GCC accepts constant forms avr-gcc does not.
+"""
+import argparse
+import os
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+TARGET = (
+    ["-e", "ATmega328P"],
+    ["-e", "size", "-t", "size_report"],
+    ["-e", "bench"],
+    ["-e", "bench_pins"],
+    ["-e", "native"],
+)
+SIM_MODES = ("stopwatch", "channels", "presets", "recover", "trace", "glyphs",
+             "display", "host", "media")
+SIM = os.path.join(ROOT, ".pio", "build", "native", "program")
+
+
+def step(title, cmd):
+    print("== %s" % title, flush=True)
+    if subprocess.call(cmd, cwd=ROOT):
+        print("gate: FAILED at %s" % title)
+        sys.exit(1)
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--pio", default="pio")
+    ap.add_argument("--skip-sweep", action="store_true", help="leave out the ~1 min sweep")
+    args = ap.parse_args()
+
+    for env in TARGET:
+        step("pio run %s" % " ".join(env), [args.pio, "run"] + env)
+    for mode in SIM_MODES + (() if args.skip_sweep else ("sweep",)):
+        step("sim %s" % mode, [SIM, mode])
+    step("host client selftest",
+         [sys.executable, os.path.join(ROOT, "tools", "host_client.py"), "--sim", SIM, "--selftest"])
+    print("gate: OK")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
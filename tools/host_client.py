@@ -0,0 +1,287 @@
+#!/usr/bin/env python3
+"""Host control client (src/host.h): program and drive the timers over
+the UART, several commands batched into one packet.
+
+Against the host simulator, through a pty (Linux):
+
+    pio run -e native
+    python3 tools/host_client.py --sim .pio/build/native/program \\
+        set 0 0:0:30 set 1 0:5:0 start 0 start 1 state
+
+or a real unit on a USB serial adapter (9600 8N1, wiring in host.h):
+
+    python3 tools/host_client.py --port /dev/ttyUSB0 state counters
+
+Commands (channels and slots count from 0, times are H:M:S):
+
+    set CH TIME     start CH     pause CH     stop CH     select CH
+    fav-set SLOT TIME     fav-load CH SLOT     state     counters
+    power TAG       (awake/asleep time per UI state, TAG = its number)
+    display         (TM1637 bus traffic: bytes asked for vs. sent)
+
+--selftest runs a scripted check against --sim: batches, a repeated
+sequence number, a bad CRC, an alarm stopped from the host, the power
+accounting and the display traffic. Exits 1 on the first mismatch.
+"""
+import argparse
+import os
+import random
+import select
+import subprocess
+import sys
+import termios
+import time
+import tty
+
+START = 0xA5
+DF_START, DF_FRAME = 0x7E, 10
+MAX_PAYLOAD = 32
+
+OPS = {  # name: (op, argument count, reply bytes)
+    "set": (0x01, 2, 0),
+    "start": (0x02, 1, 0),
+    "pause": (0x03, 1, 0),
+    "stop": (0x04, 1, 0),
+    "select": (0x05, 1, 0),
+    "fav-set": (0x06, 2, 0),
+    "fav-load": (0x07, 2, 0),
+    "state": (0x08, 0, None),  # 3 + 5 per channel
+    "counters": (0x09, 0, 19),
+    "power": (0x0A, 1, 14),
+    "display": (0x0B, 0, 18),
+}
+OP_NAMES = {v[0]: k for k, v in OPS.items()}
+STATUS = ["ok", "bad argument", "not now", "unknown op", "cut off", "reply full", "busy"]
+STATES = ["IDLE", "SET_HR", "SET_MIN", "SET_SEC", "RUNNING", "PAUSED", "ALARM", "STOPWATCH", "SW_RUNNING"]
+CHANNEL = ["idle", "paused", "running", "expired"]
+COUNTERS = ["packets", "errors", "dropped", "repeats", "timeouts", "uart_overruns",
+            "df_failed", "df_timeouts", "df_rx_bad", "df_queue_high", "df_queue_dropped"]
+POWER = ["awake", "asleep", "powerdown_s", "sleeps"]  # Awake/asleep in 1.024 ms units
+DISPLAY = ["bytes_requested", "bytes_sent", "frames_skipped", "frames_replaced", "ack_failures"]
+
+
+def crc16(data, crc=0xFFFF):
+    """CRC-16/CCITT-FALSE, as _crc_xmodem_update() from 0xFFFF."""
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def packet(seq, payload):
+    body = bytes([len(payload), seq]) + payload
+    crc = crc16(body)
+    return bytes([START]) + body + bytes([crc & 0xFF, crc >> 8])
+
+
+def parse_time(text):
+    parts = [int(p) for p in text.split(":")]
+    while len(parts) < 3:
+        parts.insert(0, 0)
+    return parts
+
+
+def encode(words):
+    """Command words -> payload bytes and the list of ops sent."""
+    payload, ops = bytearray(), []
+    i = 0
+    while i < len(words):
+        name = words[i]
+        if name not in OPS:
+            raise SystemExit("unknown command: %s" % name)
+        op, nargs, _ = OPS[name]
+        args = words[i + 1:i + 1 + nargs]
+        if len(args) != nargs:
+            raise SystemExit("%s needs %d argument(s)" % (name, nargs))
+        payload.append(op)
+        if name in ("set", "fav-set"):
+            payload.append(int(args[0]))
+            payload += bytes(parse_time(args[1]))
+        else:
+            payload += bytes(int(a) for a in args)
+        ops.append(op)
+        i += 1 + nargs
+    if len(payload) > MAX_PAYLOAD:
+        raise SystemExit("batch is %d bytes, at most %d fit a packet" % (len(payload), MAX_PAYLOAD))
+    return bytes(payload), ops
+
+
+def decode(payload):
+    """Reply payload -> [(op name, status, data dict or None)]"""
+    out, i = [], 0
+    while i + 2 <= len(payload):
+        op, status = payload[i], payload[i + 1]
+        i += 2
+        data = None
+        if status == 0 and op == OPS["state"][0]:
+            n = payload[i + 2]
+            chans = []
+            for c in range(n):
+                b = payload[i + 3 + 5 * c:i + 8 + 5 * c]
+                chans.append((CHANNEL[b[0]], int.from_bytes(b[1:5], "little")))
+            data = {"state": STATES[payload[i]], "selected": payload[i + 1], "channels": chans}
+            i += 3 + 5 * n
+        elif status == 0 and op == OPS["counters"][0]:
+            b = payload[i:i + 19]
+            vals = [int.from_bytes(b[k:k + 2], "little") for k in range(0, 10, 2)]
+            vals.append(b[10])
+            vals += [int.from_bytes(b[k:k + 2], "little") for k in range(11, 17, 2)]
+            vals += [b[17], b[18]]
+            data = dict(zip(COUNTERS, vals))
+            i += 19
+        elif status == 0 and op == OPS["power"][0]:
+            b = payload[i:i + 14]
+            vals = [int.from_bytes(b[k:k + 4], "little") for k in range(0, 12, 4)]
+            vals.append(int.from_bytes(b[12:14], "little"))
+            data = dict(zip(POWER, vals))
+            i += 14
+        elif status == 0 and op == OPS["display"][0]:
+            b = payload[i:i + 18]
+            vals = [int.from_bytes(b[k:k + 4], "little") for k in range(0, 16, 4)]
+            vals.append(int.from_bytes(b[16:18], "little"))
+            data = dict(zip(DISPLAY, vals))
+            i += 18
+        out.append((OP_NAMES.get(op, "0x%02X" % op), STATUS[status] if status < len(STATUS) else status, data))
+    return out
+
+
+class Link:
+    def __init__(self, fd, baud=None):
+        self.fd = fd
+        tty.setraw(fd)
+        if baud:
+            attrs = termios.tcgetattr(fd)
+            speed = getattr(termios, "B%d" % baud)
+            attrs[4] = attrs[5] = speed
+            termios.tcsetattr(fd, termios.TCSANOW, attrs)
+        self.seq = random.randrange(256)  # A restarted client must not look like a repeat
+        self.buf = bytearray()
+
+    def _read(self, timeout):
+        r, _, _ = select.select([self.fd], [], [], timeout)
+        if r:
+            self.buf += os.read(self.fd, 256)
+
+    def _reply(self, seq, deadline):
+        """Next reply packet for 'seq'; DFPlayer frames and noise are skipped."""
+        while True:
+            while self.buf and self.buf[0] != START:
+                n = DF_FRAME if self.buf[0] == DF_START else 1
+                if len(self.buf) < n:
+                    break
+                del self.buf[:n]
+            if len(self.buf) >= 2 and self.buf[0] == START and len(self.buf) >= self.buf[1] + 5:
+                n = self.buf[1] + 5
+                pkt, self.buf = bytes(self.buf[:n]), self.buf[n:]
+                crc = crc16(pkt[1:-2])
+                if pkt[-2:] == bytes([crc & 0xFF, crc >> 8]) and pkt[2] == seq:
+                    return pkt[3:-2]
+                continue
+            left = deadline - time.monotonic()
+            if left <= 0:
+                return None
+            self._read(left)
+
+    def send_raw(self, data):
+        os.write(self.fd, data)
+
+    def batch(self, payload, retries=3, timeout=0.5):
+        """Send one batch; the same seq goes out again if no reply comes."""
+        self.seq = (self.seq + 1) & 0xFF
+        for _ in range(retries):
+            os.write(self.fd, packet(self.seq, payload))
+            reply = self._reply(self.seq, time.monotonic() + timeout)
+            if reply is not None:
+                return reply
+        raise TimeoutError("no reply to seq %d" % self.seq)
+
+    def run(self, words):
+        payload, _ = encode(words)
+        return decode(self.batch(payload))
+
+
+def open_sim(program):
+    proc = subprocess.Popen([program, "serve"], stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+    line = proc.stdout.readline().decode().split()
+    if len(line) != 2 or line[0] != "PTY":
+        raise SystemExit("%s serve did not report a pty" % program)
+    return proc, os.open(line[1], os.O_RDWR | os.O_NOCTTY)
+
+
+def expect(cond, what):
+    if not cond:
+        print("FAIL", what)
+        sys.exit(1)
+
+
+def selftest(link):
+    r = link.run(["set", "0", "0:0:2", "set", "1", "0:1:5", "start", "0", "start", "1", "state"])
+    expect(all(s == "ok" for _, s, _ in r), "setup batch: %s" % r)
+    st = r[-1][2]
+    expect(st["state"] == "RUNNING" and st["selected"] == 0, "UI not on channel 0: %s" % st)
+    expect([c[0] for c in st["channels"][:3]] == ["running", "running", "idle"], "channels: %s" % st)
+
+    # Same seq again: answered, not run again
+    link.seq = (link.seq - 1) & 0xFF
+    again = link.run(["set", "0", "0:0:2", "set", "1", "0:1:5", "start", "0", "start", "1", "state"])
+    expect([x[:2] for x in again] == [x[:2] for x in r], "repeat answered differently")
+
+    r = link.run(["pause", "1", "start", "2", "state"])
+    expect([s for _, s, _ in r] == ["ok", "not now", "ok"], "mixed batch: %s" % r)
+    expect(r[2][2]["channels"][1][0] == "paused", "channel 1 not paused")
+
+    link.send_raw(packet(0x42, bytes([0x08]))[:-1] + b"\x00")  # Bad CRC: ignored
+    time.sleep(0.1)
+
+    time.sleep(2.2)  # Channel 0 rings
+    r = link.run(["state"])
+    expect(r[0][2]["state"] == "ALARM", "no alarm: %s" % r)
+    r = link.run(["stop", "0", "state", "counters"])
+    expect(r[1][2]["state"] == "IDLE", "alarm not stopped: %s" % r)
+    c = r[2][2]
+    expect(c["errors"] == 1 and c["repeats"] == 1 and c["df_rx_bad"] == 0 and c["df_queue_dropped"] == 0, "counters: %s" % c)
+
+    # Channel 0 ran ~2 s, nearly all of it asleep
+    r = link.run(["power", str(STATES.index("RUNNING")), "power", "99", "display"])
+    p = r[0][2]
+    expect(p["sleeps"] > 0 and p["asleep"] > p["awake"], "power: %s" % p)
+    expect(r[1][1] == "bad argument", "power tag out of range: %s" % r)
+
+    # Display diffing: SS.cc frames change one or two digits at a time
+    d = r[2][2]
+    expect(0 < d["bytes_sent"] < d["bytes_requested"] and d["ack_failures"] == 0, "display: %s" % d)
+    print("selftest: OK, %s, running %s, display %s" % (c, p, d))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    where = ap.add_mutually_exclusive_group(required=True)
+    where.add_argument("--port", help="serial device or pty")
+    where.add_argument("--sim", help="native build of the firmware (runs 'PROGRAM serve')")
+    ap.add_argument("--baud", type=int, default=9600)
+    ap.add_argument("--selftest", action="store_true")
+    ap.add_argument("commands", nargs="*")
+    args = ap.parse_args()
+
+    proc = None
+    if args.sim:
+        proc, fd = open_sim(args.sim)
+        link = Link(fd)
+    else:
+        link = Link(os.open(args.port, os.O_RDWR | os.O_NOCTTY), args.baud)
+    try:
+        if args.selftest:
+            selftest(link)
+        if args.commands:
+            for name, status, data in link.run(args.commands):
+                print("%-9s %s%s" % (name, status, "  %s" % data if data else ""))
+    finally:
+        if proc:
+            proc.stdin.close()
+            proc.wait()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,10 @@
+# PlatformIO pre script for env:size: link-time optimisation with unused
+# functions and data dropped. -flto has to reach the link line as well,
+# which build_flags alone don't do. Fat objects keep real code in each .o
+# for the per-file numbers of size_report.py.
+Import("env")  # noqa: F821 (SCons)
+
+env.Append(
+    CCFLAGS=["-flto", "-ffat-lto-objects", "-ffunction-sections", "-fdata-sections"],
+    LINKFLAGS=["-flto", "-fuse-linker-plugin", "-Wl,--gc-sections"],
+)
@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+"""Flash / SRAM footprint per source file, with a budget.
+
+    pio run -e size -t size_report
+
+or by hand, on any build:
+
+    python3 tools/size_report.py --elf .pio/build/size/firmware.elf \\
+        --objects .pio/build/size/src --flash 30720 --sram 1600 \\
+        [--baseline size.json] [--json size.json] [--size avr-size]
+
+Per file it lists .text (code and PROGMEM tables), .data (initialised
+SRAM, which also costs its initialiser in flash) and .bss (zeroed SRAM,
+.noinit included) from the object files; the totals come from the linked
+image. With LTO the objects are built fat (-ffat-lto-objects), so the
+per-file numbers are the non-LTO code and the totals are what ships.
+
+Exits 1 if the image needs more flash or static SRAM than the budget
+(whatever SRAM is left over is the stack). --baseline prints the change
+per file against an earlier --json, to see what a feature costs before
+it lands.
+"""
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+FLASH_PREFIXES = (".text", ".progmem", ".vectors", ".init", ".fini", ".trampolines", ".jumptables")
+DATA_PREFIXES = (".data", ".rodata")
+BSS_PREFIXES = (".bss", ".noinit")
+
+
+def sections(size_tool, path):
+    out = subprocess.run([size_tool, "-A", path], check=True, capture_output=True, text=True).stdout
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) >= 2 and parts[0].startswith(".") and parts[1].isdigit():
+            yield parts[0], int(parts[1])
+
+
+def classify(secs):
+    text = data = bss = 0
+    for name, size in secs:
+        if name.startswith(FLASH_PREFIXES):
+            text += size
+        elif name.startswith(DATA_PREFIXES):
+            data += size
+        elif name.startswith(BSS_PREFIXES):
+            bss += size
+    return {"text": text, "data": data, "bss": bss}
+
+
+def per_file(size_tool, obj_dir):
+    files = {}
+    for root, _, names in os.walk(obj_dir):
+        for n in sorted(names):
+            if not n.endswith(".o"):
+                continue
+            path = os.path.join(root, n)
+            name = os.path.relpath(path, obj_dir)[:-2]  # foo.c.o -> foo.c
+            files[name] = classify(sections(size_tool, path))
+    return files
+
+
+def fmt_delta(now, was):
+    if was is None:
+        return "   (new)"
+    d = now - was
+    return "%+8d" % d if d else "        "
+
+
+def report(args):
+    files = per_file(args.size, args.objects) if args.objects else {}
+    total = classify(sections(args.size, args.elf))
+    flash = total["text"] + total["data"]
+    sram = total["data"] + total["bss"]
+
+    base = {}
+    if args.baseline:
+        with open(args.baseline) as f:
+            base = json.load(f)
+    base_files = base.get("files", {})
+
+    print("%-16s %8s %8s %8s   %8s" % ("file", ".text", ".data", ".bss", "flash"))
+    for name, s in sorted(files.items(), key=lambda kv: -(kv[1]["text"] + kv[1]["data"])):
+        f = s["text"] + s["data"]
+        b = base_files.get(name)
+        was = b["text"] + b["data"] if b else None
+        print("%-16s %8d %8d %8d   %8d%s" % (name, s["text"], s["data"], s["bss"], f,
+                                            fmt_delta(f, was) if base else ""))
+    for name in sorted(set(base_files) - set(files)):
+        print("%-16s %37s" % (name, "(gone)"))
+
+    print("%-16s %8d %8d %8d" % ("image", total["text"], total["data"], total["bss"]))
+    failed = 0
+    for what, used, limit, key in (("flash", flash, args.flash, "flash"), ("sram", sram, args.sram, "sram")):
+        line = "%-5s %6d bytes" % (what, used)
+        if base:
+            line += "  %s" % (fmt_delta(used, base.get(key)).strip() or "+0")
+        if limit:
+            line += "  budget %d, %d left" % (limit, limit - used)
+            if used > limit:
+                line += "  OVER BUDGET"
+                failed = 1
+        print(line)
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump({"files": files, "image": total, "flash": flash, "sram": sram}, f, indent=2)
+    return failed
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--elf", required=True)
+    ap.add_argument("--objects", help="directory with the object files")
+    ap.add_argument("--size", default="avr-size")
+    ap.add_argument("--flash", type=int, default=0, help="flash budget (bytes)")
+    ap.add_argument("--sram", type=int, default=0, help="static SRAM budget (bytes)")
+    ap.add_argument("--baseline", help="earlier --json report to diff against")
+    ap.add_argument("--json", help="write the report here")
+    return report(ap.parse_args())
+
+
+# As a PlatformIO extra script: adds the size_report target, budget from
+# custom_size_flash / custom_size_sram in platformio.ini
+try:
+    Import("env")  # noqa: F821 (SCons)
+except NameError:
+    env = None
+
+if env is not None:
+    def budget(option):
+        return env.GetProjectOption(option, "0")
+
+    env.AddCustomTarget(
+        name="size_report",
+        dependencies="$BUILD_DIR/${PROGNAME}.elf",
+        actions=['"$PYTHONEXE" "%s" --elf "$BUILD_DIR/${PROGNAME}.elf" --objects "$BUILD_DIR/src" '
+                 '--size "$SIZETOOL" --flash %s --sram %s --json "$BUILD_DIR/size.json"'
+                 % (os.path.join("$PROJECT_DIR", "tools", "size_report.py"),
+                    budget("custom_size_flash"), budget("custom_size_sram"))],
+        title="Size report",
+        description="Flash/SRAM per source file, fails over budget")
+elif __name__ == "__main__":
+    sys.exit(main())